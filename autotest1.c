@@ -4,12 +4,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <locale.h>
+#include <errno.h>
 
 #include <sys/types.h>
 #include <fcntl.h>
 #if defined(_WIN32)
 #include <io.h>
+#include <Windows.h>
+#define GET_PID() ((unsigned long)GetCurrentProcessId())
+#else
+#include <unistd.h>
+#define GET_PID() ((unsigned long)getpid())
 #endif
 
 #if defined(_DEBUG) && defined(USE_STB_LEAKCHECK)
@@ -18,6 +25,27 @@
 #endif
 
 bool TestScheme(const wchar_t *scheme_name, size_t *passed, size_t *missed);
+bool TestOverlay(const wchar_t *scheme_name);
+bool TestCallerScheme(void);
+bool TestCase(void);
+bool TestSchemeDir(const wchar_t *dir_name, size_t nof_schemes);
+bool TestSchemeSlot(const wchar_t *scheme_name, const wchar_t *new_scheme_name);
+bool TestSchemeSlotWatch(const char *scheme_name);
+bool TestSharedSchemes(const wchar_t *dir_name);
+bool TestComposition(const wchar_t *scheme_name, const wchar_t *smiles_name);
+bool TestInverseScheme(const wchar_t *scheme_name);
+bool TestInverseEndings(const wchar_t *scheme_name);
+bool TestParallel(const wchar_t *scheme_name);
+bool TestColumn(const wchar_t *scheme_name);
+bool TestAsync(const wchar_t *scheme_name);
+bool TestStream(const wchar_t *scheme_name);
+bool TestStreamInvalid(const wchar_t *scheme_name);
+bool TestStreamSplits(const wchar_t *scheme_name);
+bool StreamInParts(iuliia_stream_t *stream, const char *data, size_t len, size_t split1, size_t split2, char *out, size_t max_out, size_t *out_len);
+void StoreTranslation(void *user_data, uint32_t *new_s);
+char *WtoU8(const wchar_t *s);
+wchar_t *DecomposeString(const wchar_t *s);
+bool TestTranslateTwice(const wchar_t *s, const iuliia_scheme_t *first, const iuliia_scheme_t *second, const iuliia_scheme_t *composed);
 
 const wchar_t *scheme_names[] = {
 		L"../forks/iuliia/ala_lc.json",
@@ -50,9 +78,35 @@ const wchar_t *scheme_names[] = {
 		L"../forks/iuliia/yandex_money.json"
 	};
 
+// Schemes with kinds of rules, which schemes of iuliia haven't
+const wchar_t *my_scheme_names[] = {
+		L"../my_schemes/exceptions.json",
+		L"../my_schemes/repeated_keys.json"
+	};
+
+#define NOF_SCHEME_VARIANTS 7
+#define NOF_COMPILED_VARIANTS 3
+
+const wchar_t *scheme_variant_names[NOF_SCHEME_VARIANTS] = {
+		L"",
+		L" (lean scheme)",
+		L" (built scheme)",
+		L" (overlay scheme)",
+		L" (compiled scheme)",
+		L" (compiled scheme, native code)",
+		L" (compiled scheme, tables)"
+	};
+
+// Transducer is made for every scheme of iuliia, so other engines are tested by flags, which don't allow it
+const unsigned int compile_flags[NOF_COMPILED_VARIANTS] = {
+		0,
+		IULIIA_COMPILE_NO_FST,
+		IULIIA_COMPILE_NO_JIT | IULIIA_COMPILE_NO_FST
+	};
+
 int main(void)
 {
-	size_t failed_schemes = 0, passed_tests = 0, missed_tests = 0, i;
+	size_t failed_schemes = 0, failed_tests = 0, passed_tests = 0, missed_tests = 0, i;
 	setlocale(LC_ALL, "");
 
 #ifdef _MSC_VER
@@ -70,7 +124,52 @@ int main(void)
 		missed_tests += current_missed;
 	}
 
+	for(i = 0; i < sizeof(my_scheme_names)/sizeof(wchar_t *); i++) {
+		size_t current_passed = 0, current_missed = 0;
+
+		if(!TestScheme(my_scheme_names[i], &current_passed, &current_missed)) failed_schemes++;
+
+		passed_tests += current_passed;
+		missed_tests += current_missed;
+	}
+
+	for(i = 0; i < sizeof(scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestComposition(scheme_names[i], L"../my_schemes/smiles.json")) failed_tests++;
+
+	if(!TestOverlay(L"../forks/iuliia/wikipedia.json")) failed_tests++;
+	if(!TestCallerScheme()) failed_tests++;
+	if(!TestCase()) failed_tests++;
+	if(!TestSchemeDir(L"../forks/iuliia", sizeof(scheme_names)/sizeof(wchar_t *))) failed_tests++;
+	if(!TestSchemeSlot(scheme_names[0], scheme_names[1])) failed_tests++;
+	if(!TestSchemeSlotWatch("../forks/iuliia/wikipedia.json")) failed_tests++;
+	if(!TestSharedSchemes(L"../forks/iuliia")) failed_tests++;
+	// GOST 7.79 system A has one replacement for every letter, so it can be translated back
+	if(!TestInverseScheme(L"../forks/iuliia/gost_779.json")) failed_tests++;
+	if(!TestInverseEndings(L"../forks/iuliia/wikipedia.json")) failed_tests++;
+
+	for(i = 0; i < sizeof(scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestParallel(scheme_names[i])) failed_tests++;
+	for(i = 0; i < sizeof(my_scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestParallel(my_scheme_names[i])) failed_tests++;
+
+	for(i = 0; i < sizeof(scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestColumn(scheme_names[i])) failed_tests++;
+	for(i = 0; i < sizeof(my_scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestColumn(my_scheme_names[i])) failed_tests++;
+
+	if(!TestAsync(L"../forks/iuliia/wikipedia.json")) failed_tests++;
+
+	for(i = 0; i < sizeof(scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestStream(scheme_names[i])) failed_tests++;
+	for(i = 0; i < sizeof(my_scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestStream(my_scheme_names[i])) failed_tests++;
+	for(i = 0; i < sizeof(scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestStreamInvalid(scheme_names[i])) failed_tests++;
+	for(i = 0; i < sizeof(scheme_names)/sizeof(wchar_t *); i++)
+		if(!TestStreamSplits(scheme_names[i])) failed_tests++;
+
 	wprintf(L"Total failed to open schemes: %u\n", (unsigned int)failed_schemes);
+	wprintf(L"Total failed tests of library functions: %u\n", (unsigned int)failed_tests);
 	wprintf(L"Total passed tests: %u\n", (unsigned int)passed_tests);
 	wprintf(L"Total missed tests: %u\n", (unsigned int)missed_tests);
 
@@ -84,7 +183,7 @@ int main(void)
 	stb_leakcheck_dumpmem();
 #endif
 
-	if(failed_schemes || missed_tests)
+	if(failed_schemes || failed_tests || missed_tests)
 		return EXIT_FAILURE;
 	else
 		return EXIT_SUCCESS;
@@ -92,39 +191,1098 @@ int main(void)
 
 bool TestScheme(const wchar_t *scheme_name, size_t *passed, size_t *missed)
 {
-	size_t current_passed = 0, current_missed = 0, i;
-	iuliia_scheme_t *scheme;
+	size_t current_passed = 0, current_missed = 0, i, j;
+	iuliia_scheme_t *schemes[NOF_SCHEME_VARIANTS-NOF_COMPILED_VARIANTS] = { 0 };
+	const iuliia_scheme_t *variants[NOF_SCHEME_VARIANTS] = { 0 };
+	iuliia_compiled_scheme_t *compiled[NOF_COMPILED_VARIANTS] = { 0 };
+	iuliia_builder_t *builder;
+	bool is_loaded;
 
 	*passed = 0;
 	*missed = 0;
 
-	scheme = iuliiaLoadSchemeW(scheme_name);
-	if(!scheme) return false;
+	schemes[0] = iuliiaLoadSchemeW(scheme_name);
 
-	for(i = 0; i < scheme->nof_samples; i++) {
-		wchar_t *new_s;
+	// Scheme without samples and metadata, parsed by json.h, should translate the same way
+	schemes[1] = iuliiaLoadSchemeExW(scheme_name, IULIIA_LOAD_SKIP_SAMPLES | IULIIA_LOAD_SKIP_METADATA | IULIIA_LOAD_JSON_DOM);
 
-		new_s = iuliiaTranslateW(scheme->samples[i].in, scheme);
-		if(new_s) {
-			if(!wcscmp(new_s, scheme->samples[i].out))
-				current_passed += 1;
-			else {
-				current_missed += 1;
-				wprintf(L"Scheme: %ls\n", scheme_name);
-				wprintf(L"Sample %u\n", (unsigned int)i);
-				wprintf(L"Before: %ls\n", scheme->samples[i].in);
+	// So should scheme made from loaded one by builder
+	builder = iuliiaCreateBuilder();
+	if(builder && schemes[0] && iuliiaBuilderAddScheme(builder, schemes[0]))
+		schemes[2] = iuliiaBuilderMakeScheme(builder);
+
+	// And overlay, which repeats some rules of its base
+	if(builder && schemes[0]) {
+		iuliiaResetBuilder(builder);
+		for(i = 0; i < schemes[0]->nof_mapping; i += 2)
+			iuliiaBuilderAddRule(builder, IULIIA_TABLE_MAPPING, schemes[0]->mapping[i].c, 0, schemes[0]->mapping[i].repl);
+		for(i = 0; i < schemes[0]->nof_prev_mapping; i++)
+			iuliiaBuilderAddRule(builder, IULIIA_TABLE_PREV, schemes[0]->prev_mapping[i].c, schemes[0]->prev_mapping[i].cor_c, schemes[0]->prev_mapping[i].repl);
+		schemes[3] = iuliiaBuilderMakeOverlay(builder, schemes[0]);
+	}
+	iuliiaFreeBuilder(builder);
+
+	// Compiled scheme keeps samples and metadata of its source
+	for(j = 0; schemes[0] && j < NOF_COMPILED_VARIANTS; j++) compiled[j] = iuliiaCompileSchemeEx(schemes[0], compile_flags[j]);
+
+	is_loaded = true;
+	for(j = 0; j < NOF_SCHEME_VARIANTS-NOF_COMPILED_VARIANTS; j++) {
+		variants[j] = schemes[j];
+		if(!schemes[j]) is_loaded = false;
+	}
+	for(j = 0; j < NOF_COMPILED_VARIANTS; j++) {
+		if(compiled[j])
+			variants[NOF_SCHEME_VARIANTS-NOF_COMPILED_VARIANTS+j] = iuliiaCompiledSchemeGet(compiled[j]);
+		else
+			is_loaded = false;
+	}
+
+	is_loaded = is_loaded && !schemes[1]->samples && !schemes[1]->name
+		&& variants[4]->nof_samples == schemes[0]->nof_samples && !wcscmp(variants[4]->name, schemes[0]->name);
+
+	for(i = 0; is_loaded && i < schemes[0]->nof_samples; i++) {
+		bool is_passed = true;
+
+		for(j = 0; j < NOF_SCHEME_VARIANTS; j++) {
+			wchar_t *new_s;
+
+			new_s = iuliiaTranslateW(schemes[0]->samples[i].in, variants[j]);
+			if(new_s && !wcscmp(new_s, schemes[0]->samples[i].out)) {
+				iuliiaFreeString(new_s);
+
+				continue;
+			}
+
+			is_passed = false;
+			wprintf(L"Scheme: %ls%ls\n", scheme_name, scheme_variant_names[j]);
+			wprintf(L"Sample %u\n", (unsigned int)i);
+			wprintf(L"Before: %ls\n", schemes[0]->samples[i].in);
+			if(new_s)
 				wprintf(L"After: %ls\n", new_s);
-				wprintf(L"Should be: %ls\n", scheme->samples[i].out);
+			else
+				wprintf(L"Error translating\n");
+			wprintf(L"Should be: %ls\n", schemes[0]->samples[i].out);
+			iuliiaFreeString(new_s);
+		}
+
+		// Input with letters made of base letters and combining marks
+		{
+			wchar_t *decomposed, *new_s = 0;
+
+			decomposed = DecomposeString(schemes[0]->samples[i].in);
+			if(decomposed) new_s = iuliiaTranslateExW(decomposed, schemes[0], IULIIA_TRANSLATE_NFC);
+			if(!new_s || wcscmp(new_s, schemes[0]->samples[i].out)) {
+				is_passed = false;
+				wprintf(L"Scheme: %ls (decomposed input)\n", scheme_name);
+				wprintf(L"Sample %u\n", (unsigned int)i);
 			}
 			iuliiaFreeString(new_s);
-		} else
+			free(decomposed);
+		}
+
+		if(is_passed)
+			current_passed++;
+		else
 			current_missed++;
 	}
 
-	iuliiaFreeScheme(scheme);
+	for(j = 0; j < NOF_COMPILED_VARIANTS; j++) iuliiaReleaseScheme(compiled[j]);
+	for(j = NOF_SCHEME_VARIANTS-NOF_COMPILED_VARIANTS; j > 0; j--) iuliiaFreeScheme(schemes[j-1]);
 
 	*passed = current_passed;
 	*missed = current_missed;
 
+	return is_loaded;
+}
+
+// Overlay replaces rules of base, adds rules, which base lacks, and leaves base as it is.
+// Text is "Хохлома і ель": "х" and "е" at word start are replaced, "і" is added
+bool TestOverlay(const wchar_t *scheme_name)
+{
+	const wchar_t *text = L"\x0425\x043e\x0445\x043b\x043e\x043c\x0430 \x0456 \x0435\x043b\x044c";
+	iuliia_scheme_t *base, *overlay = 0;
+	iuliia_builder_t *builder;
+	wchar_t *base_s = 0, *overlay_s = 0;
+	bool is_ok = false;
+
+	base = iuliiaLoadSchemeW(scheme_name);
+	builder = iuliiaCreateBuilder();
+	if(!base || !builder) goto END;
+
+	if(!iuliiaBuilderAddRuleU8(builder, IULIIA_TABLE_MAPPING, 0x445, 0, "h")
+		|| !iuliiaBuilderAddRuleU8(builder, IULIIA_TABLE_PREV, 0x435, 0, "e")
+		|| !iuliiaBuilderAddRuleU8(builder, IULIIA_TABLE_MAPPING, 0x456, 0, "i")) goto END;
+	overlay = iuliiaBuilderMakeOverlay(builder, base);
+	if(!overlay) goto END;
+
+	overlay_s = iuliiaTranslateW(text, overlay);
+	base_s = iuliiaTranslateW(text, base);
+	is_ok = overlay_s && base_s && !wcscmp(overlay_s, L"Hohloma i el") && !wcscmp(base_s, L"Khokhloma \x0456 yel");
+
+END:
+	if(!is_ok) wprintf(L"Overlay of %ls failed\n", scheme_name);
+
+	iuliiaFreeString(overlay_s);
+	iuliiaFreeString(base_s);
+	iuliiaFreeScheme(overlay);
+	iuliiaFreeBuilder(builder);
+	iuliiaFreeScheme(base);
+
+	return is_ok;
+}
+
+// Scheme filled by caller is cleared by iuliiaInitScheme. Rule of word start added after iuliiaPrepareScheme
+// is used, because engine chosen for scheme without such rules isn't used any more
+bool TestCallerScheme(void)
+{
+	iuliia_scheme_t *scheme;
+	wchar_t *new_s[2] = { 0 };
+	bool is_ok = false;
+
+	scheme = malloc(sizeof(iuliia_scheme_t));
+	if(!scheme) goto END;
+
+	iuliiaInitScheme(scheme);
+	scheme->mapping = malloc(sizeof(iuliia_mapping_1char_t));
+	if(!scheme->mapping) goto END;
+	scheme->nof_mapping = 1;
+	scheme->mapping[0].c = 0x435;
+	scheme->mapping[0].repl = iuliiaWtoU32(L"e");
+	if(!scheme->mapping[0].repl) goto END;
+	iuliiaPrepareScheme(scheme);
+	new_s[0] = iuliiaTranslateW(L"\x0435\x0435", scheme);
+
+	scheme->prev_mapping = malloc(sizeof(iuliia_mapping_2char_t));
+	if(!scheme->prev_mapping) goto END;
+	scheme->nof_prev_mapping = 1;
+	scheme->prev_mapping[0].c = 0x435;
+	scheme->prev_mapping[0].cor_c = 0;
+	scheme->prev_mapping[0].repl = iuliiaWtoU32(L"ye");
+	if(!scheme->prev_mapping[0].repl) goto END;
+	new_s[1] = iuliiaTranslateW(L"\x0435\x0435", scheme);
+
+	is_ok = new_s[0] && new_s[1] && !wcscmp(new_s[0], L"ee") && !wcscmp(new_s[1], L"yee");
+
+END:
+	if(!is_ok) wprintf(L"Scheme filled by caller failed\n");
+
+	iuliiaFreeString(new_s[0]);
+	iuliiaFreeString(new_s[1]);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+bool TestCase(void)
+{
+	// Upper and lower case pairs: Ё, Ǵ, Ǻ, Ґ, Ա
+	static const uint32_t pairs[][2] = { {0x401, 0x451}, {0x1F4, 0x1F5}, {0x1FA, 0x1FB}, {0x490, 0x491}, {0x531, 0x561} };
+	// Letters without pairs: ǰ, ǲ, Ƿ
+	static const uint32_t singles[] = { 0x1F0, 0x1F2, 0x1F7 };
+	bool is_ok = true;
+	size_t i;
+
+	for(i = 0; i < sizeof(pairs)/sizeof(pairs[0]); i++) {
+		if(iuliiaU32ToLower(pairs[i][0]) != pairs[i][1] || iuliiaU32ToUpper(pairs[i][1]) != pairs[i][0] ||
+			!iuliiaU32IsUpper(pairs[i][0]) || iuliiaU32IsUpper(pairs[i][1]) ||
+			!iuliiaU32IsAlpha(pairs[i][0]) || !iuliiaU32IsAlpha(pairs[i][1])) {
+			wprintf(L"Case of U+%04X failed\n", (unsigned int)pairs[i][0]);
+			is_ok = false;
+		}
+	}
+	for(i = 0; i < sizeof(singles)/sizeof(singles[0]); i++) {
+		if(iuliiaU32ToLower(singles[i]) != singles[i] || iuliiaU32ToUpper(singles[i]) != singles[i] || !iuliiaU32IsAlpha(singles[i])) {
+			wprintf(L"Case of U+%04X failed\n", (unsigned int)singles[i]);
+			is_ok = false;
+		}
+	}
+
+	return is_ok;
+}
+
+bool TestSchemeDir(const wchar_t *dir_name, size_t nof_schemes)
+{
+	iuliia_scheme_dir_t *dir;
+	bool is_ok = true;
+	size_t i;
+
+	dir = iuliiaLoadSchemeDirW(dir_name, 0, 4);
+	if(!dir) return false;
+
+	if(dir->nof_entries != nof_schemes) {
+		wprintf(L"Found %u schemes in \"%ls\"\n", (unsigned int)dir->nof_entries, dir_name);
+		is_ok = false;
+	}
+
+	for(i = 0; i < dir->nof_entries; i++) {
+		if(!dir->entries[i].scheme) {
+			wprintf(L"Scheme \"%ls\" not loaded, error %d\n", dir->entries[i].filename, dir->entries[i].error);
+			is_ok = false;
+		}
+	}
+
+	iuliiaFreeSchemeDir(dir);
+
+	return is_ok;
+}
+
+bool TestSchemeSlot(const wchar_t *scheme_name, const wchar_t *new_scheme_name)
+{
+	iuliia_scheme_slot_t *slot;
+	iuliia_scheme_t *new_scheme;
+	iuliia_compiled_scheme_t *old_compiled = 0, *new_compiled = 0, *compiled = 0;
+	bool is_ok = false;
+
+	slot = iuliiaCreateSchemeSlotW(scheme_name, 0, 0);
+	new_scheme = iuliiaLoadSchemeW(new_scheme_name);
+	if(!slot || !new_scheme) goto END;
+
+	new_compiled = iuliiaCompileScheme(new_scheme);
+	old_compiled = iuliiaSchemeSlotAcquire(slot);
+	if(!new_compiled) goto END;
+
+	// Scheme acquired before publishing should stay valid
+	iuliiaSchemeSlotPublish(slot, new_compiled);
+	compiled = iuliiaSchemeSlotAcquire(slot);
+
+	is_ok = compiled == new_compiled && old_compiled != new_compiled
+		&& wcscmp(iuliiaCompiledSchemeGet(old_compiled)->name, new_scheme->name)
+		&& !wcscmp(iuliiaCompiledSchemeGet(compiled)->name, new_scheme->name);
+
+END:
+	if(!is_ok) wprintf(L"Scheme slot failed\n");
+
+	iuliiaReleaseScheme(compiled);
+	iuliiaReleaseScheme(old_compiled);
+	iuliiaReleaseScheme(new_compiled);
+	iuliiaFreeSchemeSlot(slot);
+	iuliiaFreeScheme(new_scheme);
+
+	return is_ok;
+}
+
+// File rewritten with the same size within the same second should be loaded again by check of slot,
+// which isn't watched by thread, and unchanged file shouldn't
+bool TestSchemeSlotWatch(const char *scheme_name)
+{
+	const char *watched_name = "iuliia-autotest1-slot.json", *name_key = "\"name\": \"";
+	iuliia_scheme_slot_t *slot = 0;
+	iuliia_compiled_scheme_t *compiled = 0;
+	char *json = 0, *name;
+	FILE *f;
+	long size = 0;
+	bool is_ok = false;
+	int i;
+
+	f = fopen(scheme_name, "rb");
+	if(!f) goto END;
+	if(!fseek(f, 0, SEEK_END) && (size = ftell(f)) > 0 && !fseek(f, 0, SEEK_SET)) {
+		json = malloc((size_t)size+1);
+		if(json && fread(json, 1, (size_t)size, f) == (size_t)size)
+			json[size] = 0;
+		else {
+			free(json);
+			json = 0;
+		}
+	}
+	fclose(f);
+	if(!json) goto END;
+
+	name = strstr(json, name_key);
+	if(!name) goto END;
+	name += strlen(name_key);
+
+	for(i = 0; i < 2; i++) {
+		f = fopen(watched_name, "wb");
+		if(!f) goto END;
+		if(fwrite(json, 1, (size_t)size, f) != (size_t)size) {
+			fclose(f);
+			goto END;
+		}
+		if(fclose(f)) goto END;
+
+		if(i) break;
+		slot = iuliiaCreateSchemeSlotA(watched_name, 0, 0);
+		if(!slot || iuliiaSchemeSlotCheck(slot)) goto END;
+		// Name changes, size doesn't
+		name[0] = name[0] == 'x' ? 'y' : 'x';
+	}
+
+	if(!iuliiaSchemeSlotCheck(slot) || iuliiaSchemeSlotCheck(slot)) goto END;
+	compiled = iuliiaSchemeSlotAcquire(slot);
+	is_ok = iuliiaCompiledSchemeGet(compiled)->name[0] == (wchar_t)name[0];
+	iuliiaReleaseScheme(compiled);
+
+END:
+	if(!is_ok) wprintf(L"Scheme slot didn't load changed file\n");
+
+	iuliiaFreeSchemeSlot(slot);
+	free(json);
+	remove(watched_name);
+
+	return is_ok;
+}
+
+bool TestSharedSchemes(const wchar_t *dir_name)
+{
+	char shared_name[64];
+	iuliia_scheme_dir_t *dir;
+	const iuliia_scheme_t **schemes = 0;
+	iuliia_shared_schemes_t *created = 0, *opened = 0;
+	bool is_ok = false;
+	size_t i, j;
+
+	// Concurrent runs use different memory
+	sprintf(shared_name, "/iuliia-autotest1-%lu", GET_PID());
+
+	dir = iuliiaLoadSchemeDirW(dir_name, 0, 0);
+	if(!dir) goto END;
+
+	schemes = malloc(dir->nof_entries*sizeof(iuliia_scheme_t *));
+	if(!schemes) goto END;
+	for(i = 0; i < dir->nof_entries; i++) {
+		if(!dir->entries[i].scheme) goto END;
+		schemes[i] = dir->entries[i].scheme;
+	}
+
+	// Memory can be left by crashed run
+	iuliiaRemoveSharedSchemes(shared_name);
+
+	created = iuliiaCreateSharedSchemes(shared_name, schemes, dir->nof_entries);
+	if(!created) goto END;
+
+	// Creator's address is busy in this process, so schemes are relocated
+	opened = iuliiaOpenSharedSchemes(shared_name);
+	if(!opened || iuliiaSharedSchemesCount(opened) != dir->nof_entries) goto END;
+
+	is_ok = true;
+	for(i = 0; i < dir->nof_entries; i++) {
+		const iuliia_scheme_t *scheme;
+
+		scheme = iuliiaSharedSchemesGet(opened, i);
+		if(!scheme || wcscmp(scheme->name, schemes[i]->name) || scheme->nof_samples != schemes[i]->nof_samples) {
+			is_ok = false;
+
+			continue;
+		}
+
+		for(j = 0; j < scheme->nof_samples; j++) {
+			wchar_t *new_s;
+
+			new_s = iuliiaTranslateW(scheme->samples[j].in, scheme);
+			if(!new_s || wcscmp(new_s, schemes[i]->samples[j].out)) is_ok = false;
+			iuliiaFreeString(new_s);
+		}
+	}
+
+END:
+	if(!is_ok) wprintf(L"Shared schemes failed\n");
+
+	iuliiaCloseSharedSchemes(opened);
+	iuliiaCloseSharedSchemes(created);
+	if(created) iuliiaRemoveSharedSchemes(shared_name);
+	free(schemes);
+	iuliiaFreeSchemeDir(dir);
+
+	return is_ok;
+}
+
+// Checks composed scheme and chain against translation by schemes one after another
+bool TestTranslateTwice(const wchar_t *s, const iuliia_scheme_t *first, const iuliia_scheme_t *second, const iuliia_scheme_t *composed)
+{
+	const iuliia_scheme_t *chain[2];
+	uint32_t *su32, *tmp = 0, *expected = 0, *result = 0;
+	bool is_ok = false;
+
+	chain[0] = first;
+	chain[1] = second;
+
+	su32 = iuliiaWtoU32(s);
+	if(su32) tmp = iuliiaTranslateU32(su32, first);
+	if(tmp) expected = iuliiaTranslateU32(tmp, second);
+	if(expected) result = iuliiaTranslateChainU32(su32, chain, 2);
+
+	is_ok = result && !memcmp(result, expected, (iuliiaU32len(expected)+1)*sizeof(uint32_t));
+	if(is_ok && composed) {
+		iuliiaFreeString(result);
+		result = iuliiaTranslateU32(su32, composed);
+		is_ok = result && !memcmp(result, expected, (iuliiaU32len(expected)+1)*sizeof(uint32_t));
+	}
+
+	if(!is_ok) wprintf(L"Composition of %ls and %ls failed for \"%ls\"\n", first->name, second->name, s);
+
+	iuliiaFreeString(su32);
+	iuliiaFreeString(tmp);
+	iuliiaFreeString(expected);
+	iuliiaFreeString(result);
+
+	return is_ok;
+}
+
+bool TestComposition(const wchar_t *scheme_name, const wchar_t *smiles_name)
+{
+	iuliia_scheme_t *scheme, *smiles, *symbols = 0;
+	iuliia_compiled_scheme_t *composed = 0, *composed_back = 0, *composed_symbols = 0;
+	iuliia_builder_t *builder;
+	bool is_ok = false;
+	size_t i, j;
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	smiles = iuliiaLoadSchemeW(smiles_name);
+	if(!scheme || !smiles) goto END;
+
+	// Smiles are context free, so they can be applied to replacements of any scheme
+	composed = iuliiaComposeSchemes(scheme, smiles);
+	if(!composed) goto END;
+
+	// Replacements with letters can't be put before scheme with contexts
+	composed_back = iuliiaComposeSchemes(smiles, scheme);
+
+	// Replacements without letters can
+	builder = iuliiaCreateBuilder();
+	if(builder) {
+		iuliiaBuilderAddRuleU8(builder, IULIIA_TABLE_MAPPING, 0x263a, 0, ":-)");
+		symbols = iuliiaBuilderMakeScheme(builder);
+		iuliiaFreeBuilder(builder);
+	}
+	if(!symbols) goto END;
+	composed_symbols = iuliiaComposeSchemes(symbols, scheme);
+	if(!composed_symbols) goto END;
+
+	is_ok = true;
+	for(i = 0; i < 2; i++) {
+		const iuliia_scheme_t *samples_scheme;
+
+		samples_scheme = i ? smiles : scheme;
+		for(j = 0; j < samples_scheme->nof_samples; j++) {
+			const wchar_t *in;
+
+			in = samples_scheme->samples[j].in;
+			if(!TestTranslateTwice(in, scheme, smiles, iuliiaCompiledSchemeGet(composed))) is_ok = false;
+			if(!TestTranslateTwice(in, smiles, scheme, composed_back ? iuliiaCompiledSchemeGet(composed_back) : 0)) is_ok = false;
+			if(!TestTranslateTwice(in, symbols, scheme, iuliiaCompiledSchemeGet(composed_symbols))) is_ok = false;
+		}
+	}
+
+END:
+	if(!is_ok) wprintf(L"Composition of %ls failed\n", scheme_name);
+
+	iuliiaReleaseScheme(composed);
+	iuliiaReleaseScheme(composed_back);
+	iuliiaReleaseScheme(composed_symbols);
+	iuliiaFreeScheme(symbols);
+	iuliiaFreeScheme(scheme);
+	iuliiaFreeScheme(smiles);
+
+	return is_ok;
+}
+
+bool TestInverseScheme(const wchar_t *scheme_name)
+{
+	iuliia_scheme_t *scheme, *inverse = 0;
+	bool is_ok = false;
+	size_t i;
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(scheme) inverse = iuliiaMakeInverseScheme(scheme);
+	if(!inverse) goto END;
+
+	is_ok = true;
+	for(i = 0; i < scheme->nof_samples; i++) {
+		uint32_t *out, **candidates = 0;
+		wchar_t *in = 0;
+
+		out = iuliiaWtoU32(scheme->samples[i].out);
+		if(out) candidates = iuliiaTranslateCandidatesU32(out, inverse, 16);
+		if(candidates) in = iuliiaU32toW(candidates[0]);
+
+		if(!in || wcscmp(in, scheme->samples[i].in)) {
+			is_ok = false;
+			wprintf(L"Scheme: %ls (inverse)\n", scheme_name);
+			wprintf(L"Sample %u\n", (unsigned int)i);
+			if(in) wprintf(L"Translated back: %ls\n", in);
+		}
+
+		iuliiaFreeString(in);
+		iuliiaFreeCandidates(candidates);
+		iuliiaFreeString(out);
+	}
+
+END:
+	if(!is_ok) wprintf(L"Inverse scheme of %ls failed\n", scheme_name);
+
+	iuliiaFreeScheme(inverse);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Ending "ий" or "ый" is translated back after consonant, but not after vowel, where "й" is translated
+// by itself. The first candidate is word, "ы" isn't told from "и" and soft sign is lost, so they are in candidates.
+// Words are Толстой, Чайковский, Горький, Новый, Мой, Край
+bool TestInverseEndings(const wchar_t *scheme_name)
+{
+	const wchar_t *words[] = { L"\x0422\x043e\x043b\x0441\x0442\x043e\x0439", L"\x0427\x0430\x0439\x043a\x043e\x0432\x0441\x043a\x0438\x0439", L"\x0413\x043e\x0440\x044c\x043a\x0438\x0439", L"\x041d\x043e\x0432\x044b\x0439", L"\x041c\x043e\x0439", L"\x041a\x0440\x0430\x0439" };
+	const wchar_t *first[] = { L"\x0422\x043e\x043b\x0441\x0442\x043e\x0439", L"\x0427\x0430\x0439\x043a\x043e\x0432\x0441\x043a\x0438\x0439", L"\x0413\x043e\x0440\x043a\x0438\x0439", L"\x041d\x043e\x0432\x0438\x0439", L"\x041c\x043e\x0439", L"\x041a\x0440\x0430\x0439" };
+	const wchar_t *other[] = { 0, 0, L"\x0413\x043e\x0440\x043a\x044b\x0439", L"\x041d\x043e\x0432\x044b\x0439", 0, 0 };
+	iuliia_scheme_t *scheme, *inverse = 0;
+	bool is_ok = false;
+	size_t i, j;
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(scheme) inverse = iuliiaMakeInverseScheme(scheme);
+	if(!inverse) goto END;
+
+	is_ok = true;
+	for(i = 0; i < sizeof(words)/sizeof(wchar_t *); i++) {
+		wchar_t *out;
+		uint32_t *out32 = 0, **candidates = 0;
+		bool has_first = false, has_other = !other[i];
+
+		out = iuliiaTranslateW(words[i], scheme);
+		if(out) out32 = iuliiaWtoU32(out);
+		if(out32) candidates = iuliiaTranslateCandidatesU32(out32, inverse, 16);
+
+		for(j = 0; candidates && candidates[j]; j++) {
+			wchar_t *in;
+
+			in = iuliiaU32toW(candidates[j]);
+			if(in && !j && !wcscmp(in, first[i])) has_first = true;
+			if(in && other[i] && !wcscmp(in, other[i])) has_other = true;
+			iuliiaFreeString(in);
+		}
+
+		if(!has_first || !has_other) {
+			is_ok = false;
+			wprintf(L"Scheme: %ls (inverse)\n", scheme_name);
+			wprintf(L"Word %ls\n", words[i]);
+		}
+
+		iuliiaFreeCandidates(candidates);
+		iuliiaFreeString(out32);
+		iuliiaFreeString(out);
+	}
+
+END:
+	if(!is_ok) wprintf(L"Inverse endings of %ls failed\n", scheme_name);
+
+	iuliiaFreeScheme(inverse);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Text of repeated samples, translated by several threads, should be the same as translated by one.
+// So should be parts of short text split at safe offsets
+bool TestParallel(const wchar_t *scheme_name)
+{
+	iuliia_scheme_t *scheme;
+	uint32_t *text = 0, *parallel_s = 0, *single_s = 0, *short_s = 0;
+	size_t text_len = 0, max_len = 1000000, short_len, i, j;
+	bool is_ok = false;
+	const char *u8 = "\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb5\xd1\x89\xd1\x91, \xd0\x99\xd0\xbe\xd0\xb3\xd0\xb8 \xd0\xb8\xd0\xb9!";
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(!scheme || !scheme->nof_samples) goto END;
+
+	text = malloc((max_len+1)*sizeof(uint32_t));
+	if(!text) goto END;
+
+	for(i = 0; ; i++) {
+		const wchar_t *in;
+
+		in = scheme->samples[i % scheme->nof_samples].in;
+		if(text_len + wcslen(in) + 1 > max_len) break;
+
+		while(*in) text[text_len++] = (uint32_t)(*(in++));
+		text[text_len++] = i % 7 ? ' ' : '\n';
+	}
+	text[text_len] = 0;
+
+	parallel_s = iuliiaTranslateParallelU32(text, scheme, 0, 4);
+	single_s = iuliiaTranslateU32(text, scheme);
+	is_ok = parallel_s && single_s && iuliiaU32len(parallel_s) == iuliiaU32len(single_s)
+		&& !memcmp(parallel_s, single_s, iuliiaU32len(single_s)*sizeof(uint32_t));
+
+	iuliiaFreeString(text);
+	text = iuliiaU8toU32((const uint8_t *)u8);
+	if(text) short_s = iuliiaTranslateU32(text, scheme);
+	if(!short_s) is_ok = false;
+	short_len = short_s ? iuliiaU32len(short_s) : 0;
+
+	for(i = 0; is_ok && i <= strlen(u8); i++) {
+		char parts[2][64];
+		uint32_t *part_s[2] = { 0 };
+		size_t split, part_len = 0;
+
+		split = iuliiaFindSafeSplit((const uint8_t *)u8, strlen(u8), i, scheme);
+		memcpy(parts[0], u8, split);
+		parts[0][split] = 0;
+		strcpy(parts[1], u8+split);
+
+		for(j = 0; j < 2; j++) {
+			uint32_t *part;
+
+			part = iuliiaU8toU32((const uint8_t *)parts[j]);
+			if(part) part_s[j] = iuliiaTranslateU32(part, scheme);
+			iuliiaFreeString(part);
+
+			if(!part_s[j] || part_len + iuliiaU32len(part_s[j]) > short_len
+				|| memcmp(short_s+part_len, part_s[j], iuliiaU32len(part_s[j])*sizeof(uint32_t)))
+				is_ok = false;
+			else
+				part_len += iuliiaU32len(part_s[j]);
+		}
+		if(part_len != short_len) is_ok = false;
+
+		iuliiaFreeString(part_s[0]);
+		iuliiaFreeString(part_s[1]);
+	}
+
+END:
+	if(!is_ok) wprintf(L"Parallel translation by %ls failed\n", scheme_name);
+
+	iuliiaFreeString(parallel_s);
+	iuliiaFreeString(single_s);
+	iuliiaFreeString(short_s);
+	iuliiaFreeString(text);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Column of samples, where every sample is twice, should be translated as samples with and without
+// translation of the same strings once
+bool TestColumn(const wchar_t *scheme_name)
+{
+	iuliia_scheme_t *scheme;
+	iuliia_column_t new_column = { 0 };
+	uint8_t *data = 0;
+	size_t *offsets = 0, nof_strings, data_len = 0, i, j;
+	bool is_ok = false;
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(!scheme) goto END;
+
+	nof_strings = 2*scheme->nof_samples;
+	offsets = malloc((nof_strings+1)*sizeof(size_t));
+	if(!offsets) goto END;
+
+	offsets[0] = 0;
+	for(i = 0; i < nof_strings; i++) {
+		char *u8;
+		uint8_t *new_data;
+
+		u8 = WtoU8(scheme->samples[i/2].in);
+		if(!u8) goto END;
+		new_data = realloc(data, data_len+strlen(u8)+1);
+		if(!new_data) {
+			free(u8);
+			goto END;
+		}
+		data = new_data;
+		memcpy(data+data_len, u8, strlen(u8));
+		data_len += strlen(u8);
+		offsets[i+1] = data_len;
+		free(u8);
+	}
+
+	is_ok = true;
+	for(j = 0; is_ok && j < 2; j++) {
+		if(!iuliiaTranslateColumnU8(data, offsets, nof_strings, scheme, j ? IULIIA_TRANSLATE_DEDUP : 0, &new_column)) {
+			is_ok = false;
+			break;
+		}
+
+		for(i = 0; is_ok && i < nof_strings; i++) {
+			char *out;
+			size_t len;
+
+			out = WtoU8(scheme->samples[i/2].out);
+			len = new_column.offsets[i+1] - new_column.offsets[i];
+			if(!out || strlen(out) != len || memcmp(out, new_column.data + new_column.offsets[i], len)) {
+				is_ok = false;
+				wprintf(L"Scheme: %ls (column)\n", scheme_name);
+				wprintf(L"Sample %u\n", (unsigned int)(i/2));
+			}
+			free(out);
+		}
+
+		iuliiaFreeColumn(&new_column);
+	}
+
+END:
+	if(!is_ok) wprintf(L"Column translation by %ls failed\n", scheme_name);
+
+	free(data);
+	free(offsets);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Samples are translated by pool with short queue one by one and by batches
+bool TestAsync(const wchar_t *scheme_name)
+{
+	iuliia_scheme_t *scheme;
+	iuliia_pool_t *pool = 0;
+	uint32_t **in = 0, **out = 0;
+	void **user_data = 0;
+	size_t nof_strings = 0, max_queue = 4, i, j;
+	bool is_ok = false;
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(scheme) pool = iuliiaCreatePool(3, max_queue);
+	if(!pool) goto END;
+
+	nof_strings = 2*scheme->nof_samples;
+	in = calloc(nof_strings, sizeof(uint32_t *));
+	out = calloc(nof_strings, sizeof(uint32_t *));
+	if(!in || !out) goto END;
+	for(i = 0; i < nof_strings; i++) {
+		in[i] = iuliiaWtoU32(scheme->samples[i % scheme->nof_samples].in);
+		if(!in[i]) goto END;
+	}
+
+	// Queue is drained, when it is full
+	for(i = 0; i < nof_strings/2; i++) {
+		while(!iuliiaTranslateAsync(pool, in[i], scheme, 0, StoreTranslation, out+i)) {
+			if(errno != EAGAIN) goto END;
+			iuliiaDrainPool(pool);
+		}
+	}
+
+	// Batch larger than queue is never queued, so it is queued by parts
+	user_data = malloc((nof_strings-i)*sizeof(void *));
+	if(!user_data || nof_strings-i <= max_queue) goto END;
+	for(j = i; j < nof_strings; j++) user_data[j-i] = out+j;
+	if(iuliiaTranslateAsyncBatch(pool, (const uint32_t *const *)(in+i), nof_strings-i, scheme, 0, StoreTranslation, user_data) || errno != E2BIG) goto END;
+
+	for(j = i; j < nof_strings; j += max_queue) {
+		size_t n;
+
+		n = nof_strings-j < max_queue ? nof_strings-j : max_queue;
+		while(!iuliiaTranslateAsyncBatch(pool, (const uint32_t *const *)(in+j), n, scheme, 0, StoreTranslation, user_data+j-i)) {
+			if(errno != EAGAIN) goto END;
+			iuliiaDrainPool(pool);
+		}
+	}
+	iuliiaDrainPool(pool);
+
+	is_ok = true;
+	for(i = 0; i < nof_strings; i++) {
+		wchar_t *new_s;
+
+		new_s = out[i] ? iuliiaU32toW(out[i]) : 0;
+		if(!new_s || wcscmp(new_s, scheme->samples[i % scheme->nof_samples].out)) is_ok = false;
+		iuliiaFreeString(new_s);
+	}
+
+END:
+	if(!is_ok) wprintf(L"Async translation by %ls failed\n", scheme_name);
+
+	iuliiaFreePool(pool);
+	for(i = 0; i < nof_strings; i++) {
+		if(in) iuliiaFreeString(in[i]);
+		if(out) iuliiaFreeString(out[i]);
+	}
+	free(in);
+	free(out);
+	free(user_data);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Samples joined in one text and decomposed text are given to stream by parts of different length
+// and should be translated as whole text
+bool TestStream(const wchar_t *scheme_name)
+{
+	iuliia_scheme_t *scheme;
+	iuliia_stream_t *stream = 0;
+	wchar_t *text = 0, *texts[2] = { 0 }, *new_s;
+	char *in = 0, *out = 0, *streamed = 0;
+	size_t text_len = 0, part_lens[4] = { 1, 2, 7, 1000 }, i, j, k;
+	bool is_ok = false;
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(!scheme || !scheme->nof_samples) goto END;
+
+	for(i = 0; i < scheme->nof_samples; i++) text_len += wcslen(scheme->samples[i].in)+1;
+	text = malloc((text_len+1)*sizeof(wchar_t));
+	if(!text) goto END;
+	text[0] = 0;
+	for(i = 0; i < scheme->nof_samples; i++) {
+		wcscat(text, scheme->samples[i].in);
+		wcscat(text, i % 3 ? L" " : L"\n");
+	}
+	texts[0] = text;
+	texts[1] = DecomposeString(text);
+	if(!texts[1]) goto END;
+
+	is_ok = true;
+	for(i = 0; is_ok && i < 2; i++) {
+		unsigned int flags;
+
+		flags = i ? IULIIA_TRANSLATE_NFC : 0;
+		stream = iuliiaCreateStream(scheme, flags);
+		in = WtoU8(texts[i]);
+		new_s = iuliiaTranslateExW(texts[i], scheme, flags);
+		if(new_s) out = WtoU8(new_s);
+		iuliiaFreeString(new_s);
+		streamed = in ? malloc(4*strlen(in)+4) : 0;
+		if(!stream || !in || !out || !streamed) {
+			is_ok = false;
+			break;
+		}
+
+		for(j = 0; is_ok && j < sizeof(part_lens)/sizeof(size_t); j++) {
+			size_t in_len, streamed_len = 0;
+
+			in_len = strlen(in);
+			for(k = 0; ; k += part_lens[j]) {
+				const uint8_t *new_data;
+				size_t part_len, new_len;
+				int is_last;
+
+				part_len = in_len-k < part_lens[j] ? in_len-k : part_lens[j];
+				is_last = k + part_len == in_len;
+				if(!iuliiaStreamTranslateU8(stream, (const uint8_t *)in+k, part_len, is_last, &new_data, &new_len)
+					|| streamed_len + new_len > 4*in_len+3) {
+					is_ok = false;
+					break;
+				}
+				memcpy(streamed+streamed_len, new_data, new_len);
+				streamed_len += new_len;
+				if(is_last) break;
+			}
+
+			if(is_ok && (streamed_len != strlen(out) || memcmp(streamed, out, streamed_len))) {
+				is_ok = false;
+				wprintf(L"Scheme: %ls (stream by %u bytes%ls)\n", scheme_name, (unsigned int)part_lens[j], i ? L", decomposed" : L"");
+			}
+		}
+
+		iuliiaFreeStream(stream);
+		stream = 0;
+		free(in);
+		free(out);
+		free(streamed);
+		in = out = streamed = 0;
+	}
+
+END:
+	if(!is_ok) wprintf(L"Stream translation by %ls failed\n", scheme_name);
+
+	iuliiaFreeStream(stream);
+	free(in);
+	free(out);
+	free(streamed);
+	free(texts[1]);
+	free(text);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Every byte of invalid UTF-8 becomes U+FFFD and NUL separates texts, so stream translates them like translation of parts
+bool TestStreamInvalid(const wchar_t *scheme_name)
+{
+	const char in[] = "\xd0\x81\xd0\xbb\xd0\xba\xd0\xb0\0\xd0\xb5\xd0\xbb\xd1\x8c\xd0 \xd1\x8a\xff\xe2\x82";
+	iuliia_scheme_t *scheme;
+	iuliia_stream_t *stream = 0;
+	wchar_t *new_s[2] = { 0 };
+	char *out[2] = { 0 }, *expected = 0, streamed[256];
+	size_t in_len, expected_len = 0, part_lens[2] = { 1, sizeof(in) }, i, j;
+	bool is_ok = false;
+
+	in_len = sizeof(in)-1;
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(!scheme) goto END;
+
+	new_s[0] = iuliiaTranslateW(L"\x0401\x043b\x043a\x0430", scheme);
+	new_s[1] = iuliiaTranslateW(L"\x0435\x043b\x044c\xfffd \x044a\xfffd\xfffd\xfffd", scheme);
+	if(!new_s[0] || !new_s[1]) goto END;
+	out[0] = WtoU8(new_s[0]);
+	out[1] = WtoU8(new_s[1]);
+	if(!out[0] || !out[1]) goto END;
+
+	expected_len = strlen(out[0])+1+strlen(out[1]);
+	expected = malloc(expected_len);
+	stream = iuliiaCreateStream(scheme, 0);
+	if(!expected || !stream || expected_len > sizeof(streamed)) goto END;
+	memcpy(expected, out[0], strlen(out[0])+1);
+	memcpy(expected+strlen(out[0])+1, out[1], strlen(out[1]));
+
+	is_ok = true;
+	for(i = 0; is_ok && i < sizeof(part_lens)/sizeof(size_t); i++) {
+		size_t streamed_len = 0;
+
+		for(j = 0; ; j += part_lens[i]) {
+			const uint8_t *new_data;
+			size_t part_len, new_len;
+			int is_last;
+
+			part_len = in_len-j < part_lens[i] ? in_len-j : part_lens[i];
+			is_last = j + part_len == in_len;
+			if(!iuliiaStreamTranslateU8(stream, (const uint8_t *)in+j, part_len, is_last, &new_data, &new_len)
+				|| streamed_len + new_len > sizeof(streamed)) {
+				is_ok = false;
+				break;
+			}
+			memcpy(streamed+streamed_len, new_data, new_len);
+			streamed_len += new_len;
+			if(is_last) break;
+		}
+
+		if(is_ok && (streamed_len != expected_len || memcmp(streamed, expected, expected_len))) is_ok = false;
+	}
+
+END:
+	if(!is_ok) wprintf(L"Stream translation of invalid UTF-8 by %ls failed\n", scheme_name);
+
+	iuliiaFreeStream(stream);
+	free(expected);
+	free(out[0]);
+	free(out[1]);
+	iuliiaFreeString(new_s[0]);
+	iuliiaFreeString(new_s[1]);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Output of invalid UTF-8 doesn't depend on points, where stream gets it split
+bool TestStreamSplits(const wchar_t *scheme_name)
+{
+	const char *in[] = {
+		"x\xe0\x80" "ab",
+		"x\xe0\x80\x80y",
+		"\xf0\x9f\x98",
+		"\xd0\xd0\x91\xc0\xaf\x80",
+		"\xf4\x90\x80\x80z\xed\xa0\x80",
+		"\xd0\x81\0\xe2\x82\0\xe2\x82\xac"
+	};
+	const size_t in_lens[] = { 4, 5, 3, 6, 8, 9 };
+	iuliia_scheme_t *scheme;
+	iuliia_stream_t *stream = 0;
+	char whole[256], parts[256];
+	size_t whole_len, parts_len, i, j, k;
+	bool is_ok = false;
+
+	scheme = iuliiaLoadSchemeW(scheme_name);
+	if(!scheme) goto END;
+	stream = iuliiaCreateStream(scheme, 0);
+	if(!stream) goto END;
+
+	is_ok = true;
+	for(i = 0; is_ok && i < sizeof(in)/sizeof(char *); i++) {
+		if(!StreamInParts(stream, in[i], in_lens[i], in_lens[i], in_lens[i], whole, sizeof(whole), &whole_len)) {
+			is_ok = false;
+			break;
+		}
+
+		for(j = 0; is_ok && j <= in_lens[i]; j++)
+			for(k = j; is_ok && k <= in_lens[i]; k++)
+				if(!StreamInParts(stream, in[i], in_lens[i], j, k, parts, sizeof(parts), &parts_len)
+					|| parts_len != whole_len || memcmp(parts, whole, whole_len))
+					is_ok = false;
+	}
+
+END:
+	if(!is_ok) wprintf(L"Stream translation of split invalid UTF-8 by %ls failed\n", scheme_name);
+
+	iuliiaFreeStream(stream);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok;
+}
+
+// Translates data by stream in parts, which end at split1 and split2
+bool StreamInParts(iuliia_stream_t *stream, const char *data, size_t len, size_t split1, size_t split2, char *out, size_t max_out, size_t *out_len)
+{
+	size_t starts[3], ends[3], i;
+
+	starts[0] = 0;
+	ends[0] = starts[1] = split1;
+	ends[1] = starts[2] = split2;
+	ends[2] = len;
+
+	*out_len = 0;
+	for(i = 0; i < 3; i++) {
+		const uint8_t *new_data;
+		size_t new_len;
+
+		if(!iuliiaStreamTranslateU8(stream, (const uint8_t *)data+starts[i], ends[i]-starts[i], i == 2, &new_data, &new_len)) return false;
+		if(*out_len + new_len > max_out) return false;
+		memcpy(out + *out_len, new_data, new_len);
+		*out_len += new_len;
+	}
+
 	return true;
 }
+
+void StoreTranslation(void *user_data, uint32_t *new_s)
+{
+	*(uint32_t **)user_data = new_s;
+}
+
+// Writes string as UTF-8
+char *WtoU8(const wchar_t *s)
+{
+	uint32_t *s32, *p;
+	char *u8;
+	size_t len = 0;
+
+	s32 = iuliiaWtoU32(s);
+	if(!s32) return 0;
+
+	u8 = malloc(4*iuliiaU32len(s32)+1);
+	if(u8) {
+		for(p = s32; *p; p++) {
+			if(*p < 0x80)
+				u8[len++] = (char)*p;
+			else if(*p < 0x800) {
+				u8[len++] = (char)(0xc0 | (*p >> 6));
+				u8[len++] = (char)(0x80 | (*p & 0x3f));
+			} else if(*p < 0x10000) {
+				u8[len++] = (char)(0xe0 | (*p >> 12));
+				u8[len++] = (char)(0x80 | ((*p >> 6) & 0x3f));
+				u8[len++] = (char)(0x80 | (*p & 0x3f));
+			} else {
+				u8[len++] = (char)(0xf0 | (*p >> 18));
+				u8[len++] = (char)(0x80 | ((*p >> 12) & 0x3f));
+				u8[len++] = (char)(0x80 | ((*p >> 6) & 0x3f));
+				u8[len++] = (char)(0x80 | (*p & 0x3f));
+			}
+		}
+		u8[len] = 0;
+	}
+
+	iuliiaFreeString(s32);
+
+	return u8;
+}
+
+// Writes letters ё and й as base letter and combining mark
+wchar_t *DecomposeString(const wchar_t *s)
+{
+	wchar_t *new_s, *p;
+
+	new_s = malloc((2*wcslen(s)+1)*sizeof(wchar_t));
+	if(!new_s) return 0;
+
+	for(p = new_s; *s; s++) {
+		if(*s == 0x451 || *s == 0x401) {
+			*(p++) = *s == 0x451 ? 0x435 : 0x415;
+			*(p++) = 0x308;
+		} else if(*s == 0x439 || *s == 0x419) {
+			*(p++) = *s == 0x439 ? 0x438 : 0x418;
+			*(p++) = 0x306;
+		} else
+			*(p++) = *s;
+	}
+	*p = 0;
+
+	return new_s;
+}
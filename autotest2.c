@@ -50,15 +50,21 @@ int main(void)
 	_setmode(_fileno(stderr), _O_U16TEXT);
 #endif
 
-	for(i = 0; i < sizeof(scheme_names)/sizeof(wchar_t *); i++) {
+	for(i = 0; i < 2*sizeof(scheme_names)/sizeof(wchar_t *); i++) {
 		iuliia_scheme_t *scheme = 0;
+		const wchar_t *scheme_name;
+		unsigned int flags;
 
-		scheme = iuliiaLoadSchemeW(scheme_names[i]);
+		// Check both streaming and json.h parsers
+		scheme_name = scheme_names[i/2];
+		flags = (i % 2) ? IULIIA_LOAD_JSON_DOM : 0;
+
+		scheme = iuliiaLoadSchemeExW(scheme_name, flags);
 		if(!scheme) {
 			failed_schemes++;
 			passed_tests++;
 		} else {
-			wprintf(L"Unintentionally opened \"%ls\"\n", scheme_names[i]);
+			wprintf(L"Unintentionally opened \"%ls\" (flags %u)\n", scheme_name, flags);
 
 			iuliiaFreeScheme(scheme);
 			missed_tests++;
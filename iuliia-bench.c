@@ -0,0 +1,264 @@
+/*
+MIT License
+
+Copyright (c) 2023 Mikhail Morozov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Checks translator, generated by iuliia-gen, against library and compares speed of generated translator
+// and library with every kind of compiled scheme
+
+#include "iuliia.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <locale.h>
+#include <time.h>
+
+#define NOF_RUNS 15
+#define MIN_TEXT_LENGTH 1000000
+#define NOF_VARIANTS 3
+
+extern uint32_t *iuliiaGeneratedTranslateU32(const uint32_t *s);
+extern const uint32_t *const iuliiaGeneratedSamples[][2];
+extern const size_t iuliiaGeneratedNofSamples;
+
+bool U32Equal(const uint32_t *a, const uint32_t *b);
+bool TestSamples(const iuliia_scheme_t *const *schemes, size_t *passed);
+uint32_t *MakeText(void);
+double BenchLibrary(const uint32_t *text, const iuliia_scheme_t *scheme);
+double BenchGenerated(const uint32_t *text);
+
+const char *variant_names[NOF_VARIANTS] = {
+		"tables",
+		"JIT",
+		"transducer"
+	};
+
+const unsigned int variant_flags[NOF_VARIANTS] = {
+		IULIIA_COMPILE_NO_JIT | IULIIA_COMPILE_NO_FST,
+		IULIIA_COMPILE_NO_FST,
+		IULIIA_COMPILE_NO_JIT
+	};
+
+int main(int argc, char **argv)
+{
+	iuliia_scheme_t *scheme;
+	iuliia_compiled_scheme_t *compiled[NOF_VARIANTS] = { 0 };
+	const iuliia_scheme_t *schemes[NOF_VARIANTS];
+	uint32_t *text = 0;
+	size_t passed = 0, i;
+	double tables_time = 0, generated_time;
+	bool is_ok = false;
+
+	if(argc < 2) {
+		printf("iuliia-bench scheme_filename\n");
+
+		return EXIT_SUCCESS;
+	}
+
+	setlocale(LC_ALL, "");
+
+	scheme = iuliiaLoadSchemeA(argv[1]);
+	if(!scheme) {
+		fprintf(stderr, "Scheme not loaded\n");
+
+		return EXIT_FAILURE;
+	}
+
+	for(i = 0; i < NOF_VARIANTS; i++) {
+		compiled[i] = iuliiaCompileSchemeEx(scheme, variant_flags[i]);
+		if(!compiled[i]) {
+			fprintf(stderr, "Scheme not compiled\n");
+			goto END;
+		}
+		schemes[i] = iuliiaCompiledSchemeGet(compiled[i]);
+	}
+
+	is_ok = TestSamples(schemes, &passed);
+	printf("Samples: %u passed, %u failed\n", (unsigned int)passed, (unsigned int)(iuliiaGeneratedNofSamples-passed));
+	if(!is_ok) goto END;
+
+	text = MakeText();
+	if(!text) {
+		is_ok = false;
+		goto END;
+	}
+
+	printf("Text: %u characters\n", (unsigned int)iuliiaU32len(text));
+
+	// First variant is baseline
+	for(i = 0; i < NOF_VARIANTS; i++) {
+		double t;
+
+		if((i == 1 && !schemes[i]->jit) || (i == 2 && !schemes[i]->fst)) {
+			printf("Library (%s): not supported\n", variant_names[i]);
+			continue;
+		}
+
+		t = BenchLibrary(text, schemes[i]);
+		if(t <= 0) {
+			is_ok = false;
+			goto END;
+		}
+
+		if(i)
+			printf("Library (%s): %.2f ms, %.2fx faster than tables\n", variant_names[i], t*1000, tables_time/t);
+		else {
+			printf("Library (%s): %.2f ms\n", variant_names[i], t*1000);
+			tables_time = t;
+		}
+	}
+
+	generated_time = BenchGenerated(text);
+	if(generated_time <= 0) {
+		is_ok = false;
+		goto END;
+	}
+	printf("Generated: %.2f ms, %.2fx faster than tables\n", generated_time*1000, tables_time/generated_time);
+
+END:
+
+	free(text);
+	for(i = 0; i < NOF_VARIANTS; i++) iuliiaReleaseScheme(compiled[i]);
+	iuliiaFreeScheme(scheme);
+
+	return is_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool U32Equal(const uint32_t *a, const uint32_t *b)
+{
+	while(*a && *a == *b) {
+		a++;
+		b++;
+	}
+
+	return *a == *b;
+}
+
+// Generated translator should give sample output and the same output as library with every kind of scheme
+bool TestSamples(const iuliia_scheme_t *const *schemes, size_t *passed)
+{
+	size_t i, j;
+	bool is_ok = true;
+
+	for(i = 0; i < iuliiaGeneratedNofSamples; i++) {
+		uint32_t *generated;
+		bool is_passed;
+
+		generated = iuliiaGeneratedTranslateU32(iuliiaGeneratedSamples[i][0]);
+		is_passed = generated && U32Equal(generated, iuliiaGeneratedSamples[i][1]);
+
+		for(j = 0; j < NOF_VARIANTS && is_passed; j++) {
+			uint32_t *library;
+
+			library = iuliiaTranslateU32(iuliiaGeneratedSamples[i][0], schemes[j]);
+			if(!library || !U32Equal(generated, library)) is_passed = false;
+			iuliiaFreeString(library);
+		}
+
+		if(is_passed)
+			(*passed)++;
+		else {
+			printf("Sample %u failed\n", (unsigned int)i);
+			is_ok = false;
+		}
+
+		free(generated);
+	}
+
+	return is_ok;
+}
+
+// Text for benchmark is samples, repeated until it is long enough
+uint32_t *MakeText(void)
+{
+	uint32_t *text;
+	size_t len = 0, samples_len = 0, i;
+
+	for(i = 0; i < iuliiaGeneratedNofSamples; i++)
+		samples_len += iuliiaU32len(iuliiaGeneratedSamples[i][0])+1;
+	if(!samples_len) return 0;
+
+	text = malloc((MIN_TEXT_LENGTH+samples_len+1)*sizeof(uint32_t));
+	if(!text) return 0;
+
+	while(len < MIN_TEXT_LENGTH) {
+		for(i = 0; i < iuliiaGeneratedNofSamples; i++) {
+			size_t sample_len;
+
+			sample_len = iuliiaU32len(iuliiaGeneratedSamples[i][0]);
+			memcpy(text+len, iuliiaGeneratedSamples[i][0], sample_len*sizeof(uint32_t));
+			len += sample_len;
+			text[len++] = ' ';
+		}
+	}
+	text[len] = 0;
+
+	return text;
+}
+
+// Both benchmarks return best time of NOF_RUNS in seconds or -1 on error
+double BenchLibrary(const uint32_t *text, const iuliia_scheme_t *scheme)
+{
+	double best = -1;
+	int i;
+
+	for(i = 0; i < NOF_RUNS; i++) {
+		clock_t start;
+		uint32_t *s;
+		double t;
+
+		start = clock();
+		s = iuliiaTranslateU32(text, scheme);
+		t = (double)(clock()-start)/CLOCKS_PER_SEC;
+		if(!s) return -1;
+		iuliiaFreeString(s);
+
+		if(best < 0 || t < best) best = t;
+	}
+
+	return best;
+}
+
+double BenchGenerated(const uint32_t *text)
+{
+	double best = -1;
+	int i;
+
+	for(i = 0; i < NOF_RUNS; i++) {
+		clock_t start;
+		uint32_t *s;
+		double t;
+
+		start = clock();
+		s = iuliiaGeneratedTranslateU32(text);
+		t = (double)(clock()-start)/CLOCKS_PER_SEC;
+		if(!s) return -1;
+		free(s);
+
+		if(best < 0 || t < best) best = t;
+	}
+
+	return best;
+}
@@ -32,9 +32,15 @@ SOFTWARE.
 #include <limits.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #if defined(_WIN32)
 #include <io.h>
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
 #endif
 
 #if defined(_DEBUG) && defined(USE_STB_LEAKCHECK)
@@ -43,29 +49,913 @@ SOFTWARE.
 #endif
 
 #if defined(_WIN32)
-#define IULIIALOADSCHEME(f) iuliiaLoadSchemeW(f)
-#define IULIIATRANSLATE(t, s) iuliiaTranslateW(t, s)
+#define IULIIALOADSCHEME(f) iuliiaLoadSchemeExW(f, IULIIA_LOAD_SKIP_SAMPLES | IULIIA_LOAD_SKIP_METADATA)
 #define PRINTF(t) wprintf(L##t);
 #define STDERR_PRINTF(t) fwprintf(stderr, L##t)
-#define FPUTS(t, f) fputws(t, f)
+#define STDERR_PRINTF_NAME(t, name) fwprintf(stderr, L##t L"%ls\n", name)
 #define FGETS(t, cnt, f) fgetws(t, cnt, f)
 #define FOPEN(f, a) _wfopen(f, L##a L", ccs=UTF-8")
 #define STRLEN(s) wcslen(s)
+#define STRCMP(s, t) wcscmp(s, L##t)
+#define FILENAME_CMP(s, t) _wcsicmp(s, t)
+#define STRTOUL(s) wcstoul(s, 0, 10)
+#define FOPEN_BINARY(f, a) _wfopen(f, L##a)
+#define FPRINTF_SHARD(f, offset, len) fwprintf(f, L"%lld %lld\n", offset, len)
+#define DIR_SEPARATOR L'\\'
+#define IS_DIR_SEPARATOR(c) ((c) == L'\\' || (c) == L'/')
+#define TMP_SUFFIX L".tmp"
+#define RENAME(from, to) (MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING) != 0)
+#define REMOVE(f) _wremove(f)
+#define THREAD HANDLE
+#define THREAD_PROC(name) static DWORD WINAPI name(LPVOID arg)
+#define THREAD_CREATE(t, proc, arg) ((*(t) = CreateThread(0, 0, proc, arg, 0, 0)) != 0)
+#define THREAD_JOIN(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#define MUTEX CRITICAL_SECTION
+#define MUTEX_INIT(m) InitializeCriticalSection(m)
+#define MUTEX_DESTROY(m) DeleteCriticalSection(m)
+#define MUTEX_LOCK(m) EnterCriticalSection(m)
+#define MUTEX_UNLOCK(m) LeaveCriticalSection(m)
+#define COND CONDITION_VARIABLE
+#define COND_INIT(c) InitializeConditionVariable(c)
+#define COND_DESTROY(c) ((void)(c))
+#define COND_WAIT(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define COND_SIGNAL(c) WakeConditionVariable(c)
+#define COND_BROADCAST(c) WakeAllConditionVariable(c)
+#define OPEN_INPUT(f) _wopen(f, _O_RDONLY | _O_BINARY)
+#define OPEN_OUTPUT(f) _wopen(f, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE)
+#define READ(fd, buf, n) _read(fd, buf, (unsigned int)(n))
+#define WRITE(fd, buf, n) _write(fd, buf, (unsigned int)(n))
+#define CLOSE(fd) _close(fd)
 #define CHAR wchar_t
 #else
-#define IULIIALOADSCHEME(f) iuliiaLoadSchemeA(f)
-#define IULIIATRANSLATE(t, s) iuliiaTranslateA(t, s)
+#define IULIIALOADSCHEME(f) iuliiaLoadSchemeExA(f, IULIIA_LOAD_SKIP_SAMPLES | IULIIA_LOAD_SKIP_METADATA)
 #define PRINTF(t) printf(t)
 #define STDERR_PRINTF(t) fprintf(stderr, t)
-#define FPUTS(t, f) fputs(t, f)
+#define STDERR_PRINTF_NAME(t, name) fprintf(stderr, t "%s\n", name)
 #define FGETS(t, cnt, f) fgets(t, cnt, f)
 #define FOPEN(f, a) fopen(f, a)
 #define STRLEN(s) strlen(s)
+#define STRCMP(s, t) strcmp(s, t)
+#define FILENAME_CMP(s, t) strcmp(s, t)
+#define STRTOUL(s) strtoul(s, 0, 10)
+#define FOPEN_BINARY(f, a) fopen(f, a)
+#define FPRINTF_SHARD(f, offset, len) fprintf(f, "%lld %lld\n", offset, len)
+#define DIR_SEPARATOR '/'
+#define IS_DIR_SEPARATOR(c) ((c) == '/')
+#define TMP_SUFFIX ".tmp"
+#define RENAME(from, to) (rename(from, to) == 0)
+#define REMOVE(f) remove(f)
+#define THREAD pthread_t
+#define THREAD_PROC(name) static void *name(void *arg)
+#define THREAD_CREATE(t, proc, arg) (pthread_create(t, 0, proc, arg) == 0)
+#define THREAD_JOIN(t) pthread_join(t, 0)
+#define MUTEX pthread_mutex_t
+#define MUTEX_INIT(m) pthread_mutex_init(m, 0)
+#define MUTEX_DESTROY(m) pthread_mutex_destroy(m)
+#define MUTEX_LOCK(m) pthread_mutex_lock(m)
+#define MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
+#define COND pthread_cond_t
+#define COND_INIT(c) pthread_cond_init(c, 0)
+#define COND_DESTROY(c) pthread_cond_destroy(c)
+#define COND_WAIT(c, m) pthread_cond_wait(c, m)
+#define COND_SIGNAL(c) pthread_cond_signal(c)
+#define COND_BROADCAST(c) pthread_cond_broadcast(c)
+#define OPEN_INPUT(f) open(f, O_RDONLY)
+#define OPEN_OUTPUT(f) open(f, O_WRONLY | O_CREAT | O_TRUNC, 0666)
+#define READ(fd, buf, n) read(fd, buf, n)
+#define WRITE(fd, buf, n) write(fd, buf, n)
+#define CLOSE(fd) close(fd)
 #define CHAR char
-#define _ftelli64 ftello64
+#define _ftelli64 ftello
+#define _fseeki64 fseeko
 #endif
 
-#define DEFAULT_BUFFER_CNT 1024
+// Text is read by blocks of this size, so memory doesn't depend on length of lines
+#define BLOCK_SIZE (1024*1024)
+// Bytes read around every target offset to find split in them
+#define SPLIT_WINDOW 65536
+// Longest path in list of files and name of file in directory
+#define MAX_PATH_LEN 4096
+
+// Returns the first offset in file at target or after it, where text can be split, or -1 on error.
+// Window starts with last character before target, if there is no split in it, next window is read
+static long long FindFileSplit(FILE *f, const iuliia_scheme_t *scheme, long long target, long long file_size, uint8_t *window)
+{
+	long long window_start;
+	size_t target_in_window;
+
+	if(target >= file_size) return file_size;
+
+	window_start = target > 4 ? target-4 : 0;
+	target_in_window = (size_t)(target-window_start);
+	while(1) {
+		size_t got, offset;
+
+		if(_fseeki64(f, window_start, SEEK_SET)) return -1;
+		got = fread(window, 1, SPLIT_WINDOW, f);
+		if(ferror(f)) return -1;
+
+		offset = iuliiaFindSafeSplit(window, got, target_in_window, scheme);
+		if(offset < got || got < SPLIT_WINDOW) return window_start + (long long)offset;
+
+		window_start += (long long)got-4;
+		target_in_window = 4;
+	}
+}
+
+// Output is written to file with TMP_SUFFIX, which replaces output file, so readers never see part of it
+static CHAR *MakeTmpFilename(const CHAR *filename)
+{
+	CHAR *tmp_filename;
+	size_t len;
+
+	len = STRLEN(filename);
+	tmp_filename = malloc((len+5)*sizeof(CHAR));
+	if(!tmp_filename) return 0;
+	memcpy(tmp_filename, filename, len*sizeof(CHAR));
+	memcpy(tmp_filename+len, TMP_SUFFIX, 5*sizeof(CHAR));
+
+	return tmp_filename;
+}
+
+static long long GetFileSize(FILE *f)
+{
+	if(_fseeki64(f, 0, SEEK_END)) return -1;
+
+	return (long long)_ftelli64(f);
+}
+
+// Writes offset and length of every shard of input file to manifest. Shards start near equal parts of file,
+// where scheme allows to split text, so translated shards make the same text as translated file
+static int WriteSplitManifest(const iuliia_scheme_t *scheme, unsigned long nof_shards, FILE *f_input, FILE *f_manifest)
+{
+	uint8_t *window;
+	long long file_size, prev_split = 0;
+	unsigned long i;
+
+	file_size = GetFileSize(f_input);
+	if(file_size < 0) return 0;
+
+	window = malloc(SPLIT_WINDOW);
+	if(!window) return 0;
+
+	for(i = 1; i <= nof_shards; i++) {
+		long long target, split;
+
+		target = i == nof_shards ? file_size : (long long)((double)file_size*i/nof_shards);
+		split = FindFileSplit(f_input, scheme, target, file_size, window);
+		if(split < 0) {
+			free(window);
+
+			return 0;
+		}
+
+		if(split < prev_split) split = prev_split;
+		FPRINTF_SHARD(f_manifest, prev_split, split-prev_split);
+		prev_split = split;
+	}
+
+	free(window);
+
+	return !ferror(f_manifest);
+}
+
+// Batch mode translates many files by pool of threads. Every thread has its own deque of tasks, takes
+// the newest task from it and steals the oldest one from other threads, when it is empty. Task of file
+// finds pieces of it, which can be translated separately, and pushes tasks of first pieces. Pieces are
+// read by tasks, which translate them, and written in order, then next pieces are pushed, so at most
+// BATCH_PIECES_IN_FLIGHT pieces of file are in memory
+#define BATCH_PIECE_SIZE (1024*1024)
+#define BATCH_PIECES_IN_FLIGHT 4
+
+typedef struct {
+	uint8_t *data;
+	size_t len;
+	int is_ready;
+} batch_piece_t;
+
+typedef struct {
+	CHAR *input_filename;
+	CHAR *output_filename;
+	CHAR *tmp_filename;
+	FILE *f_output;
+	long long *splits; // nof_pieces+1 offsets of pieces
+	size_t nof_pieces;
+	batch_piece_t *pieces; // Translated pieces, which aren't written yet
+	size_t next_push;
+	size_t next_write;
+	size_t nof_running; // Pushed pieces, which aren't translated yet
+	int is_writing;
+	int is_failed;
+	int is_finished;
+} batch_file_t;
+
+typedef struct {
+	batch_file_t *file;
+	size_t piece; // SIZE_MAX - task of starting file
+} batch_task_t;
+
+typedef struct {
+	MUTEX lock;
+	batch_task_t *tasks; // Oldest task is tasks[first]
+	size_t first;
+	size_t end;
+	size_t max_tasks;
+} batch_deque_t;
+
+typedef struct {
+	const iuliia_scheme_t *scheme;
+	batch_deque_t *deques;
+	unsigned int nof_threads;
+	MUTEX lock; // Guards counters of batch and state of files
+	COND has_work; // Signaled, when task is pushed or the last task is done
+	size_t nof_queued;
+	size_t nof_pending;
+	size_t nof_failed;
+} batch_t;
+
+typedef struct {
+	batch_t *batch;
+	unsigned int index;
+} batch_worker_t;
+
+static int BatchPush(batch_t *batch, batch_deque_t *deque, batch_file_t *file, size_t piece)
+{
+	MUTEX_LOCK(&(deque->lock));
+
+	if(deque->end == deque->max_tasks) {
+		if(deque->first) {
+			memmove(deque->tasks, deque->tasks + deque->first, (deque->end - deque->first)*sizeof(batch_task_t));
+			deque->end -= deque->first;
+			deque->first = 0;
+		} else {
+			batch_task_t *tasks = 0;
+			size_t max_tasks;
+
+			max_tasks = deque->max_tasks ? deque->max_tasks*2 : 64;
+			if(SIZE_MAX/sizeof(batch_task_t) >= max_tasks) tasks = realloc(deque->tasks, max_tasks*sizeof(batch_task_t));
+			if(!tasks) {
+				MUTEX_UNLOCK(&(deque->lock));
+
+				return 0;
+			}
+			deque->tasks = tasks;
+			deque->max_tasks = max_tasks;
+		}
+	}
+
+	deque->tasks[deque->end].file = file;
+	deque->tasks[deque->end].piece = piece;
+	deque->end++;
+
+	MUTEX_UNLOCK(&(deque->lock));
+
+	MUTEX_LOCK(&(batch->lock));
+	batch->nof_queued++;
+	COND_SIGNAL(&(batch->has_work));
+	MUTEX_UNLOCK(&(batch->lock));
+
+	return 1;
+}
+
+static int BatchPop(batch_t *batch, batch_deque_t *deque, batch_task_t *task, int is_oldest)
+{
+	int is_found = 0;
+
+	MUTEX_LOCK(&(deque->lock));
+	if(deque->first < deque->end) {
+		if(is_oldest)
+			*task = deque->tasks[deque->first++];
+		else
+			*task = deque->tasks[--(deque->end)];
+		is_found = 1;
+	}
+	MUTEX_UNLOCK(&(deque->lock));
+
+	if(is_found) {
+		MUTEX_LOCK(&(batch->lock));
+		batch->nof_queued--;
+		MUTEX_UNLOCK(&(batch->lock));
+	}
+
+	return is_found;
+}
+
+static void BatchTaskDone(batch_t *batch)
+{
+	MUTEX_LOCK(&(batch->lock));
+	batch->nof_pending--;
+	// Waiting threads exit, when nothing is left
+	if(!batch->nof_pending)
+		COND_BROADCAST(&(batch->has_work));
+	else
+		COND_SIGNAL(&(batch->has_work));
+	MUTEX_UNLOCK(&(batch->lock));
+}
+
+static void BatchFreeFileData(batch_file_t *file)
+{
+	size_t i;
+
+	if(file->pieces)
+		for(i = 0; i < file->nof_pieces; i++) free(file->pieces[i].data);
+	free(file->pieces);
+	free(file->splits);
+	free(file->tmp_filename);
+	file->pieces = 0;
+	file->splits = 0;
+	file->tmp_filename = 0;
+}
+
+static void BatchFinishFile(batch_t *batch, batch_file_t *file)
+{
+	int is_written;
+
+	is_written = !file->is_failed;
+	if(file->f_output && fclose(file->f_output)) is_written = 0;
+	file->f_output = 0;
+
+	if(is_written) is_written = RENAME(file->tmp_filename, file->output_filename);
+	if(!is_written) {
+		if(file->tmp_filename) REMOVE(file->tmp_filename);
+		file->is_failed = 1;
+
+		MUTEX_LOCK(&(batch->lock));
+		batch->nof_failed++;
+		MUTEX_UNLOCK(&(batch->lock));
+	}
+
+	BatchFreeFileData(file);
+}
+
+// Writes translated pieces in order and pushes next pieces instead of them. Called with locked batch, unlocks it
+static void BatchWritePieces(batch_t *batch, batch_deque_t *deque, batch_file_t *file)
+{
+	int is_finished;
+
+	while(!file->is_writing && !file->is_failed && file->next_write < file->next_push && file->pieces[file->next_write].is_ready) {
+		batch_piece_t piece;
+		size_t next_piece = SIZE_MAX;
+		int is_written;
+
+		// Other threads store their pieces while this one writes
+		file->is_writing = 1;
+		piece = file->pieces[file->next_write];
+		memset(file->pieces + file->next_write, 0, sizeof(batch_piece_t));
+		MUTEX_UNLOCK(&(batch->lock));
+
+		is_written = fwrite(piece.data, 1, piece.len, file->f_output) == piece.len;
+		free(piece.data);
+
+		MUTEX_LOCK(&(batch->lock));
+		file->is_writing = 0;
+		if(!is_written)
+			file->is_failed = 1;
+		else {
+			file->next_write++;
+			if(file->next_push < file->nof_pieces) {
+				next_piece = file->next_push++;
+				file->nof_running++;
+				batch->nof_pending++;
+			}
+		}
+
+		if(next_piece != SIZE_MAX) {
+			MUTEX_UNLOCK(&(batch->lock));
+			is_written = BatchPush(batch, deque, file, next_piece);
+			MUTEX_LOCK(&(batch->lock));
+
+			if(!is_written) {
+				file->is_failed = 1;
+				file->nof_running--;
+				batch->nof_pending--;
+			}
+		}
+	}
+
+	// The last thread, which leaves file, finishes it
+	is_finished = !file->is_finished && !file->is_writing && !file->nof_running && (file->is_failed || file->next_write == file->nof_pieces);
+	if(is_finished) file->is_finished = 1;
+	MUTEX_UNLOCK(&(batch->lock));
+
+	if(is_finished) BatchFinishFile(batch, file);
+}
+
+// Reads piece of file and translates it as whole text by stream, so invalid UTF-8 and NUL are translated
+// the same way as without batch
+static int BatchTranslatePiece(batch_t *batch, batch_file_t *file, size_t piece, batch_piece_t *new_piece)
+{
+	FILE *f;
+	iuliia_stream_t *stream;
+	uint8_t *data;
+	const uint8_t *new_data;
+	size_t len, new_len;
+	int is_translated = 0;
+
+	len = (size_t)(file->splits[piece+1] - file->splits[piece]);
+
+	f = FOPEN_BINARY(file->input_filename, "rb");
+	if(!f) return 0;
+
+	stream = iuliiaCreateStream(batch->scheme, 0);
+	data = malloc(len ? len : 1);
+	if(stream && data && !_fseeki64(f, file->splits[piece], SEEK_SET) && fread(data, 1, len, f) == len
+		&& iuliiaStreamTranslateU8(stream, data, len, 1, &new_data, &new_len)) {
+		new_piece->data = malloc(new_len ? new_len : 1);
+		if(new_piece->data) {
+			if(new_len) memcpy(new_piece->data, new_data, new_len);
+			new_piece->len = new_len;
+			new_piece->is_ready = 1;
+			is_translated = 1;
+		}
+	}
+
+	iuliiaFreeStream(stream);
+	free(data);
+	fclose(f);
+
+	return is_translated;
+}
+
+// Finds pieces of file, which can be translated separately, opens temporary output and pushes first pieces
+static int BatchStartFile(batch_t *batch, batch_deque_t *deque, batch_file_t *file)
+{
+	FILE *f;
+	uint8_t *window;
+	long long file_size;
+	size_t nof_pushed, i;
+
+	f = FOPEN_BINARY(file->input_filename, "rb");
+	if(!f) return 0;
+
+	file_size = GetFileSize(f);
+	window = malloc(SPLIT_WINDOW);
+	file->nof_pieces = file_size > 0 ? (size_t)(file_size/BATCH_PIECE_SIZE) + 1 : 1;
+	file->splits = malloc((file->nof_pieces+1)*sizeof(long long));
+	file->pieces = calloc(file->nof_pieces, sizeof(batch_piece_t));
+	if(file_size < 0 || !window || !file->splits || !file->pieces) {
+		free(window);
+		fclose(f);
+
+		return 0;
+	}
+
+	file->splits[0] = 0;
+	for(i = 1; i <= file->nof_pieces; i++) {
+		long long split;
+
+		split = FindFileSplit(f, batch->scheme, (long long)i*BATCH_PIECE_SIZE, file_size, window);
+		if(split < 0) {
+			free(window);
+			fclose(f);
+
+			return 0;
+		}
+		file->splits[i] = split < file->splits[i-1] ? file->splits[i-1] : split;
+	}
+
+	free(window);
+	fclose(f);
+
+	file->tmp_filename = MakeTmpFilename(file->output_filename);
+	if(!file->tmp_filename) return 0;
+
+	file->f_output = FOPEN_BINARY(file->tmp_filename, "wb");
+	if(!file->f_output) {
+		free(file->tmp_filename);
+		file->tmp_filename = 0;
+
+		return 0;
+	}
+
+	nof_pushed = file->nof_pieces < BATCH_PIECES_IN_FLIGHT ? file->nof_pieces : BATCH_PIECES_IN_FLIGHT;
+	MUTEX_LOCK(&(batch->lock));
+	file->next_push = nof_pushed;
+	file->nof_running = nof_pushed;
+	batch->nof_pending += nof_pushed;
+	MUTEX_UNLOCK(&(batch->lock));
+
+	// Pieces are pushed from the last one, so this thread takes the first one and others steal the next ones
+	for(i = nof_pushed; i > 0; i--) {
+		if(BatchPush(batch, deque, file, i-1)) continue;
+
+		MUTEX_LOCK(&(batch->lock));
+		file->is_failed = 1;
+		file->nof_running--;
+		batch->nof_pending--;
+		MUTEX_UNLOCK(&(batch->lock));
+	}
+
+	// File may be finished here, if all pieces failed
+	MUTEX_LOCK(&(batch->lock));
+	BatchWritePieces(batch, deque, file);
+
+	return 1;
+}
+
+static void BatchRunTask(batch_t *batch, batch_deque_t *deque, batch_task_t *task)
+{
+	batch_file_t *file;
+
+	file = task->file;
+
+	if(task->piece == SIZE_MAX) {
+		if(!BatchStartFile(batch, deque, file)) {
+			file->is_failed = 1;
+			BatchFinishFile(batch, file);
+		}
+	} else {
+		batch_piece_t new_piece;
+		int is_failed;
+
+		MUTEX_LOCK(&(batch->lock));
+		is_failed = file->is_failed;
+		MUTEX_UNLOCK(&(batch->lock));
+
+		// Pieces of failed file are skipped
+		memset(&new_piece, 0, sizeof(batch_piece_t));
+		if(!is_failed) is_failed = !BatchTranslatePiece(batch, file, task->piece, &new_piece);
+
+		MUTEX_LOCK(&(batch->lock));
+		file->nof_running--;
+		if(is_failed) {
+			file->is_failed = 1;
+			free(new_piece.data);
+		} else
+			file->pieces[task->piece] = new_piece;
+		BatchWritePieces(batch, deque, file);
+	}
+
+	BatchTaskDone(batch);
+}
+
+THREAD_PROC(BatchThread)
+{
+	batch_worker_t *worker;
+	batch_t *batch;
+	batch_deque_t *deque;
+
+	worker = (batch_worker_t *)arg;
+	batch = worker->batch;
+	deque = batch->deques + worker->index;
+
+	while(1) {
+		batch_task_t task;
+		unsigned int i;
+		int is_found, is_done;
+
+		is_found = BatchPop(batch, deque, &task, 0);
+		for(i = 1; !is_found && i < batch->nof_threads; i++)
+			is_found = BatchPop(batch, batch->deques + (worker->index+i) % batch->nof_threads, &task, 1);
+
+		if(is_found) {
+			BatchRunTask(batch, deque, &task);
+
+			continue;
+		}
+
+		// Other threads may still push pieces of files they translate
+		MUTEX_LOCK(&(batch->lock));
+		while(batch->nof_pending && !batch->nof_queued) COND_WAIT(&(batch->has_work), &(batch->lock));
+		is_done = !batch->nof_pending;
+		MUTEX_UNLOCK(&(batch->lock));
+		if(is_done) break;
+	}
+
+	return 0;
+}
+
+static int BatchAddFile(batch_file_t **files, size_t *nof_files, size_t *max_files, const CHAR *input_filename, const CHAR *output_dir)
+{
+	batch_file_t *file;
+	const CHAR *name;
+	size_t input_len, dir_len, name_len;
+
+	if(*nof_files == *max_files) {
+		batch_file_t *new_files = 0;
+		size_t new_max_files;
+
+		new_max_files = *max_files ? *max_files*2 : 64;
+		if(SIZE_MAX/sizeof(batch_file_t) >= new_max_files) new_files = realloc(*files, new_max_files*sizeof(batch_file_t));
+		if(!new_files) return 0;
+		*files = new_files;
+		*max_files = new_max_files;
+	}
+
+	// Output file has name of input file in output directory
+	input_len = STRLEN(input_filename);
+	name = input_filename + input_len;
+	while(name > input_filename && !IS_DIR_SEPARATOR(name[-1])) name--;
+	name_len = input_len - (size_t)(name - input_filename);
+	dir_len = STRLEN(output_dir);
+
+	file = *files + *nof_files;
+	memset(file, 0, sizeof(batch_file_t));
+	file->input_filename = malloc((input_len+1)*sizeof(CHAR));
+	file->output_filename = malloc((dir_len+name_len+2)*sizeof(CHAR));
+	if(!file->input_filename || !file->output_filename) {
+		free(file->input_filename);
+		free(file->output_filename);
+
+		return 0;
+	}
+	memcpy(file->input_filename, input_filename, (input_len+1)*sizeof(CHAR));
+	memcpy(file->output_filename, output_dir, dir_len*sizeof(CHAR));
+	file->output_filename[dir_len] = DIR_SEPARATOR;
+	memcpy(file->output_filename+dir_len+1, name, (name_len+1)*sizeof(CHAR));
+
+	(*nof_files)++;
+
+	return 1;
+}
+
+// Adds regular files of directory without subdirectories
+static int BatchAddDir(batch_file_t **files, size_t *nof_files, size_t *max_files, const CHAR *dir, const CHAR *output_dir)
+{
+	CHAR *path;
+	size_t dir_len;
+	int is_added = 1;
+#if defined(_WIN32)
+	HANDLE find;
+	WIN32_FIND_DATAW find_data;
+#else
+	DIR *d;
+	struct dirent *de;
+#endif
+
+	dir_len = STRLEN(dir);
+	path = malloc((dir_len+MAX_PATH_LEN+2)*sizeof(CHAR));
+	if(!path) return 0;
+	memcpy(path, dir, dir_len*sizeof(CHAR));
+	path[dir_len] = DIR_SEPARATOR;
+
+#if defined(_WIN32)
+	memcpy(path+dir_len+1, L"*", 2*sizeof(wchar_t));
+	find = FindFirstFileW(path, &find_data);
+	if(find == INVALID_HANDLE_VALUE) {
+		free(path);
+
+		return 0;
+	}
+
+	do {
+		if(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+		if(wcslen(find_data.cFileName) > MAX_PATH_LEN) continue;
+
+		wcscpy(path+dir_len+1, find_data.cFileName);
+		if(!BatchAddFile(files, nof_files, max_files, path, output_dir)) is_added = 0;
+	} while(is_added && FindNextFileW(find, &find_data));
+
+	FindClose(find);
+#else
+	d = opendir(dir);
+	if(!d) {
+		free(path);
+
+		return 0;
+	}
+
+	while(is_added && (de = readdir(d)) != 0) {
+		struct stat st;
+
+		if(strlen(de->d_name) > MAX_PATH_LEN) continue;
+
+		strcpy(path+dir_len+1, de->d_name);
+		if(stat(path, &st) || !S_ISREG(st.st_mode)) continue;
+
+		if(!BatchAddFile(files, nof_files, max_files, path, output_dir)) is_added = 0;
+	}
+
+	closedir(d);
+#endif
+
+	free(path);
+
+	return is_added;
+}
+
+// Adds files, which names are lines of list file
+static int BatchAddList(batch_file_t **files, size_t *nof_files, size_t *max_files, const CHAR *list_filename, const CHAR *output_dir)
+{
+	CHAR line[MAX_PATH_LEN+2];
+	FILE *f;
+	int is_added = 1;
+
+	f = FOPEN(list_filename, "r");
+	if(!f) return 0;
+
+	while(is_added && FGETS(line, MAX_PATH_LEN+2, f)) {
+		size_t len;
+
+		len = STRLEN(line);
+		while(len && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = 0;
+		if(!len) continue;
+
+		if(!BatchAddFile(files, nof_files, max_files, line, output_dir)) is_added = 0;
+	}
+
+	fclose(f);
+
+	return is_added;
+}
+
+static int BatchCompareOutputs(const void *a, const void *b)
+{
+	return FILENAME_CMP((*(const batch_file_t * const *)a)->output_filename, (*(const batch_file_t * const *)b)->output_filename);
+}
+
+// Files with the same output name would write the same temporary file, so all of them are failed
+static int BatchFailSameOutputs(batch_file_t *files, size_t nof_files)
+{
+	batch_file_t **sorted;
+	size_t i;
+
+	if(nof_files < 2) return 1;
+
+	sorted = malloc(nof_files*sizeof(batch_file_t *));
+	if(!sorted) return 0;
+	for(i = 0; i < nof_files; i++) sorted[i] = files + i;
+
+	qsort(sorted, nof_files, sizeof(batch_file_t *), BatchCompareOutputs);
+	for(i = 1; i < nof_files; i++)
+		if(!BatchCompareOutputs(sorted + i-1, sorted + i)) sorted[i-1]->is_failed = sorted[i]->is_failed = 1;
+
+	free(sorted);
+
+	return 1;
+}
+
+static int IsDir(const CHAR *path)
+{
+#if defined(_WIN32)
+	DWORD attributes;
+
+	attributes = GetFileAttributesW(path);
+
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st;
+
+	return !stat(path, &st) && S_ISDIR(st.st_mode);
+#endif
+}
+
+static unsigned int CpuCount(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+
+	return info.dwNumberOfProcessors ? (unsigned int)info.dwNumberOfProcessors : 1;
+#else
+	long count;
+
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return count > 0 ? (unsigned int)count : 1;
+#endif
+}
+
+// Inputs are files, directories or @list_filename. Returns number of files, which weren't translated
+static size_t RunBatch(const iuliia_scheme_t *scheme, unsigned int nof_threads, const CHAR *output_dir, CHAR **inputs, int nof_inputs)
+{
+	batch_t batch;
+	batch_file_t *files = 0;
+	batch_worker_t *workers = 0;
+	THREAD *threads = 0;
+	size_t nof_files = 0, max_files = 0, nof_failed = 0, i;
+	unsigned int nof_started = 0, j;
+	int k;
+
+	for(k = 0; k < nof_inputs; k++) {
+		int is_added;
+
+		if(inputs[k][0] == '@')
+			is_added = BatchAddList(&files, &nof_files, &max_files, inputs[k]+1, output_dir);
+		else if(IsDir(inputs[k]))
+			is_added = BatchAddDir(&files, &nof_files, &max_files, inputs[k], output_dir);
+		else
+			is_added = BatchAddFile(&files, &nof_files, &max_files, inputs[k], output_dir);
+
+		if(!is_added) {
+			STDERR_PRINTF_NAME("Not translated: ", inputs[k]);
+			nof_failed++;
+		}
+	}
+
+	if(!nof_threads) nof_threads = CpuCount();
+
+	memset(&batch, 0, sizeof(batch_t));
+	if(!BatchFailSameOutputs(files, nof_files))
+		for(i = 0; i < nof_files; i++) files[i].is_failed = 1;
+	batch.scheme = scheme;
+	batch.nof_threads = nof_threads;
+	batch.nof_pending = nof_files;
+	MUTEX_INIT(&(batch.lock));
+	COND_INIT(&(batch.has_work));
+
+	batch.deques = calloc(nof_threads, sizeof(batch_deque_t));
+	workers = malloc(nof_threads*sizeof(batch_worker_t));
+	threads = malloc(nof_threads*sizeof(THREAD));
+	if(!batch.deques || !workers || !threads) {
+		for(i = 0; i < nof_files; i++) files[i].is_failed = 1;
+		nof_failed += nof_files;
+		goto END;
+	}
+	for(j = 0; j < nof_threads; j++) {
+		MUTEX_INIT(&(batch.deques[j].lock));
+		workers[j].batch = &batch;
+		workers[j].index = j;
+	}
+
+	// Files are dealt to threads in turn, pieces of file go to thread, which started it
+	for(i = 0; i < nof_files; i++) {
+		if(!files[i].is_failed && BatchPush(&batch, batch.deques + i % nof_threads, files + i, SIZE_MAX)) continue;
+
+		batch.nof_pending--;
+		batch.nof_failed++;
+	}
+
+	// Calling thread is the first worker
+	for(j = 1; j < nof_threads; j++) {
+		if(!THREAD_CREATE(threads+j, BatchThread, workers+j)) break;
+		nof_started++;
+	}
+	BatchThread(workers);
+	for(j = 1; j <= nof_started; j++) THREAD_JOIN(threads[j]);
+
+	nof_failed += batch.nof_failed;
+
+	for(j = 0; j < nof_threads; j++) {
+		free(batch.deques[j].tasks);
+		MUTEX_DESTROY(&(batch.deques[j].lock));
+	}
+
+END:
+	MUTEX_DESTROY(&(batch.lock));
+	COND_DESTROY(&(batch.has_work));
+	free(batch.deques);
+	free(workers);
+	free(threads);
+	for(i = 0; i < nof_files; i++) {
+		if(files[i].is_failed) STDERR_PRINTF_NAME("Not translated: ", files[i].input_filename);
+		free(files[i].input_filename);
+		free(files[i].output_filename);
+	}
+	free(files);
+
+	return nof_failed;
+}
+
+static int WriteAll(int fd, const uint8_t *data, size_t len)
+{
+	while(len) {
+		long written;
+
+		written = (long)WRITE(fd, data, len < BLOCK_SIZE ? len : BLOCK_SIZE);
+		if(written <= 0) return 0;
+
+		data += written;
+		len -= (size_t)written;
+	}
+
+	return 1;
+}
+
+// Translates UTF-8 text by blocks. Stream keeps characters at end of block, which rules may look at with next block
+static int TranslateBlocks(const iuliia_scheme_t *scheme, int fd_input, int fd_output)
+{
+	iuliia_stream_t *stream;
+	uint8_t *block;
+	int is_ok = 0;
+
+	stream = iuliiaCreateStream(scheme, 0);
+	block = malloc(BLOCK_SIZE);
+	if(!stream || !block) goto END;
+
+	while(1) {
+		const uint8_t *new_data;
+		size_t new_len;
+		long got;
+
+		got = (long)READ(fd_input, block, BLOCK_SIZE);
+		if(got < 0) goto END;
+
+		if(!iuliiaStreamTranslateU8(stream, block, (size_t)got, got == 0, &new_data, &new_len)) goto END;
+		if(!WriteAll(fd_output, new_data, new_len)) goto END;
+
+		if(!got) break;
+	}
+
+	is_ok = 1;
+
+END:
+	iuliiaFreeStream(stream);
+	free(block);
+
+	return is_ok;
+}
 
 #if defined(_WIN32)
 int wmain(int argc, wchar_t **argv)
@@ -73,14 +963,35 @@ int wmain(int argc, wchar_t **argv)
 int main(int argc, char **argv)
 #endif
 {
-	CHAR *scheme_filename = 0, *input_filename = 0, *output_filename = 0;
-	CHAR *original_text, *original_text_cursor, *translated_text = 0;
-	int buffer_cnt = DEFAULT_BUFFER_CNT, buffer_cnt_left;
+	CHAR *scheme_filename = 0, *input_filename = 0, *output_filename = 0, *tmp_filename = 0;
+	int arg = 1, fd_input = 0, fd_output = 1, is_translated;
 	iuliia_scheme_t *scheme = 0;
 	FILE *f_input = 0, *f_output = 0;
+	int is_inverse = 0;
+	unsigned long nof_shards = 0;
+	int is_batch = 0;
+	unsigned int nof_threads = 0;
 
-	if(argc < 2) {
-		PRINTF("iuliia-c scheme_filename [input_filename] [output_filename]\n");
+	if(argc > 1 && !STRCMP(argv[1], "--inverse")) {
+		is_inverse = 1;
+		arg++;
+	} else if(argc > 2 && !STRCMP(argv[1], "--split")) {
+		nof_shards = STRTOUL(argv[2]);
+		arg += 2;
+	} else if(argc > 2 && !STRCMP(argv[1], "--batch")) {
+		is_batch = 1;
+		nof_threads = (unsigned int)STRTOUL(argv[2]);
+		arg += 2;
+	}
+
+	if(argc < arg+1 || (nof_shards && argc < arg+2) || (is_batch && argc < arg+3) || (arg > 1 && !is_inverse && !nof_shards && !is_batch)) {
+		PRINTF("iuliia-c [--inverse] scheme_filename [input_filename] [output_filename]\n");
+		PRINTF("iuliia-c --split N scheme_filename input_filename [manifest_filename]\n");
+		PRINTF("iuliia-c --batch N scheme_filename output_dir input ...\n");
+		PRINTF("  --inverse  translate text made by scheme back\n");
+		PRINTF("  --split N  write offset and length in bytes of N shards of input, which can be translated separately\n");
+		PRINTF("  --batch N  translate UTF-8 files by N threads (0 - one per cpu) to files with the same names in output_dir.\n");
+		PRINTF("             Input is file, directory or @file with list of files\n");
 
 		return EXIT_SUCCESS;
 	}
@@ -88,14 +999,14 @@ int main(int argc, char **argv)
 	setlocale(LC_ALL, "");
 
 #ifdef _MSC_VER
-	_setmode(_fileno(stdin), _O_U16TEXT);
-	_setmode(_fileno(stdout), _O_U16TEXT);
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
 	_setmode(_fileno(stderr), _O_U16TEXT);
 #endif
 
-	scheme_filename = argv[1];
-	if(argc > 2) input_filename = argv[2];
-	if(argc > 3) output_filename = argv[3];
+	scheme_filename = argv[arg];
+	if(argc > arg+1) input_filename = argv[arg+1];
+	if(argc > arg+2) output_filename = argv[arg+2];
 
 	scheme = IULIIALOADSCHEME(scheme_filename);
 	if(!scheme) {
@@ -104,82 +1015,84 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
-	if(input_filename) {
-		f_input = FOPEN(input_filename, "r");
+	if(is_inverse) {
+		iuliia_scheme_t *inverse;
 
-		if(!f_input) {
-			iuliiaFreeScheme(scheme);
+		inverse = iuliiaMakeInverseScheme(scheme);
+		iuliiaFreeScheme(scheme);
+		if(!inverse) {
+			STDERR_PRINTF("Inverse scheme not made\n");
 
 			return EXIT_FAILURE;
 		}
-	} else
-		f_input = stdin;
+		scheme = inverse;
+	}
 
-	if(output_filename) {
-		f_output = FOPEN(output_filename, "w");
+	if(is_batch) {
+		size_t nof_failed;
+
+		nof_failed = RunBatch(scheme, nof_threads, argv[arg+1], argv+arg+2, argc-arg-2);
+		iuliiaFreeScheme(scheme);
+		if(nof_failed) STDERR_PRINTF("Some files not translated\n");
+
+		return nof_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
 
-		if(!f_output) {
+	if(nof_shards) {
+		int is_written;
+
+		f_input = FOPEN_BINARY(input_filename, "rb");
+		if(!f_input) {
 			iuliiaFreeScheme(scheme);
-			if(input_filename) fclose(f_input);
 
 			return EXIT_FAILURE;
 		}
-	} else
-		f_output = stdout;
 
-	original_text = malloc(sizeof(CHAR)*buffer_cnt);
-	if(!original_text) {
+		f_output = output_filename ? FOPEN_BINARY(output_filename, "w") : stdout;
+		is_written = f_output && WriteSplitManifest(scheme, nof_shards, f_input, f_output);
+
 		iuliiaFreeScheme(scheme);
-		if(input_filename) fclose(f_input);
-		if(output_filename) fclose(f_output);
+		fclose(f_input);
+		if(output_filename && f_output) fclose(f_output);
 
-		return EXIT_FAILURE;
+		return is_written ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 
-	original_text_cursor = original_text;
-	buffer_cnt_left = buffer_cnt;
+	if(input_filename) {
+		fd_input = OPEN_INPUT(input_filename);
 
-	while(!feof(f_input)) {
-		if(!FGETS(original_text_cursor, buffer_cnt_left, f_input)) {
-			if(feof(f_input)) { 
-				*original_text_cursor = 0;
-				if(STRLEN(original_text) == 0) break;
-			} else 
-				break;
-		}
-		if(STRLEN(original_text) == buffer_cnt-1) {
-			CHAR *_original_text = 0;
-			if((INT_MAX/sizeof(CHAR))/2 <= buffer_cnt) break;
-
-			_original_text = realloc(original_text, sizeof(CHAR)*buffer_cnt*2);
-			if(!_original_text) break;
-			original_text = _original_text;
-			original_text_cursor = original_text + buffer_cnt - 1;
-			buffer_cnt *= 2;
-			buffer_cnt_left = buffer_cnt/2+1;
-			continue;
-		} else {
-			original_text_cursor = original_text;
-			buffer_cnt_left = buffer_cnt;
+		if(fd_input < 0) {
+			iuliiaFreeScheme(scheme);
+
+			return EXIT_FAILURE;
 		}
+	}
+
+	if(output_filename) {
+		tmp_filename = MakeTmpFilename(output_filename);
+		fd_output = tmp_filename ? OPEN_OUTPUT(tmp_filename) : -1;
 
-		translated_text = IULIIATRANSLATE(original_text, scheme);
-		if(!translated_text) {
+		if(fd_output < 0) {
 			iuliiaFreeScheme(scheme);
-			if(input_filename) fclose(f_input);
-			if(output_filename) fclose(f_output);
+			free(tmp_filename);
+			if(input_filename) CLOSE(fd_input);
 
 			return EXIT_FAILURE;
 		}
-	
-		FPUTS(translated_text, f_output);
-		iuliiaFreeString(translated_text);
 	}
 
+	is_translated = TranslateBlocks(scheme, fd_input, fd_output);
+
 	iuliiaFreeScheme(scheme);
-	if(input_filename) fclose(f_input);
-	if(output_filename) fclose(f_output);
-	if(original_text) free(original_text);
+	if(input_filename) CLOSE(fd_input);
+	if(output_filename) {
+		if(CLOSE(fd_output)) is_translated = 0;
+		if(is_translated) is_translated = RENAME(tmp_filename, output_filename);
+		if(!is_translated) REMOVE(tmp_filename);
+		free(tmp_filename);
+	}
+
+	if(!is_translated) STDERR_PRINTF("Text not translated\n");
 
 #if defined(_DEBUG) && defined(USE_STB_LEAKCHECK)
 #ifdef _MSC_VER
@@ -190,5 +1103,5 @@ int main(int argc, char **argv)
 	stb_leakcheck_dumpmem();
 #endif
 
-	return EXIT_SUCCESS;
+	return is_translated ? EXIT_SUCCESS : EXIT_FAILURE;
 }
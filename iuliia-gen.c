@@ -0,0 +1,359 @@
+/*
+MIT License
+
+Copyright (c) 2023 Mikhail Morozov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Generates C source with translator for one scheme. Rules are compiled into switches
+
+#include "iuliia.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <locale.h>
+
+#if defined(_DEBUG) && defined(USE_STB_LEAKCHECK)
+#define STB_LEAKCHECK_IMPLEMENTATION
+#include "forks/stb/stb_leakcheck.h"
+#endif
+
+#define DEFAULT_PREFIX "iuliiaGenerated"
+
+// Replacements are written once, rules refer to them by number
+typedef struct {
+	const uint32_t **strings;
+	size_t nof_strings;
+	size_t max_strings;
+} string_table_t;
+
+size_t FindString(const string_table_t *table, const uint32_t *s);
+bool AddString(string_table_t *table, const uint32_t *s, size_t *index);
+bool AddSchemeStrings(string_table_t *table, const iuliia_scheme_t *scheme);
+void WriteString(FILE *f, const char *name, size_t index, const uint32_t *s);
+void WriteFind1char(FILE *f, const char *prefix, const string_table_t *table, const iuliia_scheme_t *scheme);
+void WriteFind2char(FILE *f, const char *prefix, const char *table_name, const string_table_t *table, const iuliia_mapping_2char_t *mapping, size_t nof_mapping);
+void WriteTranslator(FILE *f, const char *prefix, const iuliia_scheme_t *scheme);
+bool WriteSamples(FILE *f, const char *prefix, const iuliia_scheme_t *scheme);
+
+int main(int argc, char **argv)
+{
+	const char *scheme_filename, *output_filename, *prefix = DEFAULT_PREFIX;
+	iuliia_scheme_t *scheme;
+	string_table_t table = { 0 };
+	FILE *f;
+	size_t i;
+	bool is_ok;
+
+	if(argc < 3) {
+		printf("iuliia-gen scheme_filename output_filename [prefix]\n");
+
+		return EXIT_SUCCESS;
+	}
+
+	setlocale(LC_ALL, "");
+
+	scheme_filename = argv[1];
+	output_filename = argv[2];
+	if(argc > 3) prefix = argv[3];
+
+	scheme = iuliiaLoadSchemeA(scheme_filename);
+	if(!scheme) {
+		fprintf(stderr, "Scheme not loaded\n");
+
+		return EXIT_FAILURE;
+	}
+
+	if(scheme->nof_pattern_mapping) {
+		fprintf(stderr, "Schemes with patterns are not supported\n");
+		iuliiaFreeScheme(scheme);
+
+		return EXIT_FAILURE;
+	}
+
+	if(!AddSchemeStrings(&table, scheme)) {
+		fprintf(stderr, "Not enough memory\n");
+		iuliiaFreeScheme(scheme);
+
+		return EXIT_FAILURE;
+	}
+
+	f = fopen(output_filename, "w");
+	if(!f) {
+		fprintf(stderr, "Output file not opened\n");
+		free((void *)table.strings);
+		iuliiaFreeScheme(scheme);
+
+		return EXIT_FAILURE;
+	}
+
+	fprintf(f, "// Generated by iuliia-gen from %s, don't edit\n\n", scheme_filename);
+	fprintf(f, "#include \"iuliia.h\"\n\n#include <stdlib.h>\n#include <stdbool.h>\n\n");
+
+	for(i = 0; i < table.nof_strings; i++) WriteString(f, "repl", i, table.strings[i]);
+	fprintf(f, "\n");
+
+	WriteFind1char(f, prefix, &table, scheme);
+	WriteFind2char(f, prefix, "Prev", &table, scheme->prev_mapping, scheme->nof_prev_mapping);
+	WriteFind2char(f, prefix, "Next", &table, scheme->next_mapping, scheme->nof_next_mapping);
+	WriteFind2char(f, prefix, "Ending", &table, scheme->ending_mapping, scheme->nof_ending_mapping);
+	WriteTranslator(f, prefix, scheme);
+	is_ok = WriteSamples(f, prefix, scheme);
+
+	if(fclose(f)) is_ok = false;
+
+	free((void *)table.strings);
+	iuliiaFreeScheme(scheme);
+
+	if(!is_ok) {
+		fprintf(stderr, "Output file not written\n");
+		remove(output_filename);
+
+		return EXIT_FAILURE;
+	}
+
+#if defined(_DEBUG) && defined(USE_STB_LEAKCHECK)
+	stb_leakcheck_dumpmem();
+#endif
+
+	return EXIT_SUCCESS;
+}
+
+// Returns nof_strings, if table doesn't have string
+size_t FindString(const string_table_t *table, const uint32_t *s)
+{
+	size_t i;
+
+	for(i = 0; i < table->nof_strings; i++) {
+		const uint32_t *p, *q;
+
+		p = table->strings[i];
+		q = s;
+		while(*p && *p == *q) {
+			p++;
+			q++;
+		}
+		if(*p == *q) return i;
+	}
+
+	return table->nof_strings;
+}
+
+bool AddString(string_table_t *table, const uint32_t *s, size_t *index)
+{
+	*index = FindString(table, s);
+	if(*index < table->nof_strings) return true;
+
+	if(table->nof_strings == table->max_strings) {
+		const uint32_t **new_strings;
+		size_t new_max_strings;
+
+		new_max_strings = table->max_strings ? table->max_strings*2 : 64;
+		new_strings = realloc((void *)table->strings, new_max_strings*sizeof(uint32_t *));
+		if(!new_strings) return false;
+
+		table->strings = new_strings;
+		table->max_strings = new_max_strings;
+	}
+
+	table->strings[table->nof_strings] = s;
+	*index = table->nof_strings++;
+
+	return true;
+}
+
+bool AddSchemeStrings(string_table_t *table, const iuliia_scheme_t *scheme)
+{
+	size_t i, index;
+
+	for(i = 0; i < scheme->nof_mapping; i++)
+		if(!AddString(table, scheme->mapping[i].repl, &index)) return false;
+	for(i = 0; i < scheme->nof_prev_mapping; i++)
+		if(!AddString(table, scheme->prev_mapping[i].repl, &index)) return false;
+	for(i = 0; i < scheme->nof_next_mapping; i++)
+		if(!AddString(table, scheme->next_mapping[i].repl, &index)) return false;
+	for(i = 0; i < scheme->nof_ending_mapping; i++)
+		if(!AddString(table, scheme->ending_mapping[i].repl, &index)) return false;
+
+	return true;
+}
+
+void WriteString(FILE *f, const char *name, size_t index, const uint32_t *s)
+{
+	fprintf(f, "static const uint32_t %s%u[] = { ", name, (unsigned int)index);
+	for(; *s; s++) fprintf(f, "0x%lx, ", (unsigned long)*s);
+	fprintf(f, "0 };\n");
+}
+
+void WriteFind1char(FILE *f, const char *prefix, const string_table_t *table, const iuliia_scheme_t *scheme)
+{
+	size_t i;
+
+	fprintf(f, "static const uint32_t *%sFindMapping(uint32_t c)\n{\n\tswitch(c) {\n", prefix);
+	for(i = 0; i < scheme->nof_mapping; i++) {
+		fprintf(f, "\t\tcase 0x%lx: return repl%u;\n", (unsigned long)scheme->mapping[i].c, (unsigned int)FindString(table, scheme->mapping[i].repl));
+	}
+	fprintf(f, "\t}\n\n\treturn 0;\n}\n\n");
+}
+
+// Rules are sorted by character and corresponding character, so every character makes one case
+void WriteFind2char(FILE *f, const char *prefix, const char *table_name, const string_table_t *table, const iuliia_mapping_2char_t *mapping, size_t nof_mapping)
+{
+	size_t i;
+
+	if(!nof_mapping) return;
+
+	fprintf(f, "static const uint32_t *%sFind%s(uint32_t c, uint32_t cor_c)\n{\n\tswitch(c) {\n", prefix, table_name);
+	for(i = 0; i < nof_mapping; i++) {
+		if(!i || mapping[i].c != mapping[i-1].c)
+			fprintf(f, "\t\tcase 0x%lx:\n\t\t\tswitch(cor_c) {\n", (unsigned long)mapping[i].c);
+
+		fprintf(f, "\t\t\t\tcase 0x%lx: return repl%u;\n", (unsigned long)mapping[i].cor_c, (unsigned int)FindString(table, mapping[i].repl));
+
+		if(i+1 == nof_mapping || mapping[i].c != mapping[i+1].c)
+			fprintf(f, "\t\t\t}\n\t\t\tbreak;\n");
+	}
+	fprintf(f, "\t}\n\n\treturn 0;\n}\n\n");
+}
+
+// Translation loop is the same as in library, but it has only checks for rules, which scheme has
+void WriteTranslator(FILE *f, const char *prefix, const iuliia_scheme_t *scheme)
+{
+	fprintf(f,
+		"static bool %sPut(uint32_t **s, size_t *len, size_t *max_len, uint32_t c)\n"
+		"{\n"
+		"\tif(*len == *max_len) {\n"
+		"\t\tuint32_t *new_s;\n"
+		"\n"
+		"\t\tif(SIZE_MAX/sizeof(uint32_t)/2 <= *max_len) return false;\n"
+		"\t\tnew_s = realloc(*s, *max_len*2*sizeof(uint32_t));\n"
+		"\t\tif(!new_s) return false;\n"
+		"\n"
+		"\t\t*s = new_s;\n"
+		"\t\t*max_len *= 2;\n"
+		"\t}\n"
+		"\n"
+		"\t(*s)[(*len)++] = c;\n"
+		"\n"
+		"\treturn true;\n"
+		"}\n\n", prefix);
+
+	fprintf(f,
+		"uint32_t *%sTranslateU32(const uint32_t *s)\n"
+		"{\n"
+		"\tuint32_t *new_s, cur_s, next_s;\n"
+		"\tsize_t new_len = 0, max_new_len;\n", prefix);
+	if(scheme->nof_prev_mapping)
+		fprintf(f, "\tuint32_t prev_s = 0;\n");
+
+	fprintf(f,
+		"\n"
+		"\tmax_new_len = iuliiaU32len(s);\n"
+		"\tif(SIZE_MAX/sizeof(uint32_t)/2 <= max_new_len) return 0;\n"
+		"\tmax_new_len = max_new_len + max_new_len/2 + 16;\n"
+		"\tnew_s = malloc(max_new_len*sizeof(uint32_t));\n"
+		"\tif(!new_s) return 0;\n"
+		"\n"
+		"\tnext_s = iuliiaU32ToLower(*s);\n"
+		"\twhile(*s) {\n"
+		"\t\tconst uint32_t *repl = 0;\n"
+		"\n"
+		"\t\tcur_s = next_s;\n"
+		"\t\tnext_s = iuliiaU32ToLower(s[1]);\n");
+
+	if(scheme->nof_ending_mapping)
+		fprintf(f,
+			"\n"
+			"\t\tif(next_s != 0 && iuliiaU32IsAlpha(s[0]) && iuliiaU32IsAlpha(next_s) && (s[2] == 0 || !iuliiaU32IsAlpha(s[2]))) {\n"
+			"\t\t\trepl = %sFindEnding(cur_s, next_s);\n"
+			"\t\t\tif(repl) {\n"
+			"\t\t\t\tnext_s = iuliiaU32ToLower(s[2]);\n"
+			"\t\t\t\ts++;\n"
+			"\t\t\t}\n"
+			"\t\t}\n", prefix);
+	if(scheme->nof_prev_mapping)
+		fprintf(f, "\t\tif(!repl) repl = %sFindPrev(cur_s, prev_s);\n", prefix);
+	if(scheme->nof_next_mapping)
+		fprintf(f, "\t\tif(!repl) repl = %sFindNext(cur_s, next_s);\n", prefix);
+
+	fprintf(f,
+		"\t\tif(!repl) repl = %sFindMapping(cur_s);\n"
+		"\n"
+		"\t\tif(repl) {\n"
+		"\t\t\tif(*repl) {\n"
+		"\t\t\t\tif(!%sPut(&new_s, &new_len, &max_new_len, iuliiaU32IsUpper(*s) ? iuliiaU32ToUpper(*repl) : *repl)) goto IULIIA_ERROR;\n"
+		"\t\t\t\trepl++;\n"
+		"\t\t\t}\n"
+		"\t\t\tfor(; *repl; repl++)\n"
+		"\t\t\t\tif(!%sPut(&new_s, &new_len, &max_new_len, *repl)) goto IULIIA_ERROR;\n"
+		"\t\t} else if(!%sPut(&new_s, &new_len, &max_new_len, *s)) goto IULIIA_ERROR;\n"
+		"\n", prefix, prefix, prefix, prefix);
+	if(scheme->nof_prev_mapping)
+		fprintf(f, "\t\tprev_s = iuliiaU32IsAlpha(cur_s) ? cur_s : 0;\n");
+
+	fprintf(f,
+		"\t\ts++;\n"
+		"\t}\n"
+		"\tif(!%sPut(&new_s, &new_len, &max_new_len, 0)) goto IULIIA_ERROR;\n"
+		"\n"
+		"\treturn new_s;\n"
+		"\n"
+		"IULIIA_ERROR:\n"
+		"\n"
+		"\tfree(new_s);\n"
+		"\n"
+		"\treturn 0;\n"
+		"}\n\n", prefix);
+}
+
+// Samples are written as UTF-32 arrays, so they don't depend on encoding of compiler
+bool WriteSamples(FILE *f, const char *prefix, const iuliia_scheme_t *scheme)
+{
+	size_t i;
+
+	for(i = 0; i < scheme->nof_samples; i++) {
+		uint32_t *in, *out;
+
+		in = iuliiaWtoU32(scheme->samples[i].in);
+		out = iuliiaWtoU32(scheme->samples[i].out);
+		if(!in || !out) {
+			iuliiaFreeString(in);
+			iuliiaFreeString(out);
+
+			return false;
+		}
+
+		WriteString(f, "sample_in", i, in);
+		WriteString(f, "sample_out", i, out);
+
+		iuliiaFreeString(in);
+		iuliiaFreeString(out);
+	}
+
+	fprintf(f, "\nconst uint32_t *const %sSamples[][2] = {\n", prefix);
+	for(i = 0; i < scheme->nof_samples; i++)
+		fprintf(f, "\t{ sample_in%u, sample_out%u },\n", (unsigned int)i, (unsigned int)i);
+	fprintf(f, "\t{ 0, 0 }\n};\n\n");
+	fprintf(f, "const size_t %sNofSamples = %u;\n", prefix, (unsigned int)scheme->nof_samples);
+
+	return !ferror(f);
+}
@@ -39,890 +39,7316 @@ SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <wctype.h>
 
 #include <errno.h>
 
-static bool iuliiaIntJsonLoadStringW(struct json_value_s *value, wchar_t **str)
-{
-	struct json_string_s *val;
-
-	val = json_value_as_string(value);
-	if(!val) return false;
+// Characters are classified by SSE2 instructions. Define IULIIA_NO_SIMD to turn it off
+#if !defined(IULIIA_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define IULIIA_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
 
-	if(SIZE_MAX/sizeof(wchar_t) <= val->string_size) return false;
-	
-	*str = malloc((val->string_size + 1) * sizeof(wchar_t));
-	if(!(*str)) return false;
-	(*str)[val->string_size] = 0;
+#if defined(_WIN32)
+#include <io.h>
+#include <time.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#endif
 
 #if defined(_WIN32)
-	if(!MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, val->string, (int)(val->string_size+1), *str, (int)(val->string_size+1))) 
+typedef HANDLE iuliia_thread_t;
+typedef LPTHREAD_START_ROUTINE iuliia_thread_proc_t;
+typedef volatile LONG iuliia_atomic_t;
+#define IULIIA_THREAD_PROC(name) static DWORD WINAPI name(LPVOID arg)
+#define iuliiaIntAtomicAdd(p, v) (InterlockedExchangeAdd((p), (v)) + (v))
+#define iuliiaIntAtomicLoad(p) (*(p)) // Volatile read has acquire semantics in MSVC
+#define iuliiaIntAtomicLoadPtr(p) InterlockedCompareExchangePointer((PVOID volatile *)(p), 0, 0)
+#define iuliiaIntAtomicExchangePtr(p, v) InterlockedExchangePointer((PVOID volatile *)(p), (v))
+typedef CRITICAL_SECTION iuliia_mutex_t;
+typedef CONDITION_VARIABLE iuliia_cond_t;
 #else
-	if(mbstowcs(*str, val->string, val->string_size) == -1)
+typedef pthread_t iuliia_thread_t;
+typedef void *(*iuliia_thread_proc_t)(void *);
+typedef volatile long iuliia_atomic_t;
+#define IULIIA_THREAD_PROC(name) static void *name(void *arg)
+#define iuliiaIntAtomicAdd(p, v) __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define iuliiaIntAtomicLoad(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define iuliiaIntAtomicLoadPtr(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define iuliiaIntAtomicExchangePtr(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+typedef pthread_mutex_t iuliia_mutex_t;
+typedef pthread_cond_t iuliia_cond_t;
 #endif
-	{
-		free(*str);
-		*str = 0;
 
-		return false;
-	}
+static bool iuliiaIntThreadCreate(iuliia_thread_t *thread, iuliia_thread_proc_t proc, void *arg)
+{
+#if defined(_WIN32)
+	*thread = CreateThread(0, 0, proc, arg, 0, 0);
 
-	return true;
+	return *thread != 0;
+#else
+	return pthread_create(thread, 0, proc, arg) == 0;
+#endif
 }
 
-static bool iuliiaIntJsonReadMapping1char(struct json_object_s *obj, iuliia_mapping_1char_t **map)
+static void iuliiaIntThreadJoin(iuliia_thread_t thread)
 {
-	size_t i;
-	struct json_object_element_s *el;
-	iuliia_mapping_1char_t *new_map;
+#if defined(_WIN32)
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, 0);
+#endif
+}
 
-	if(SIZE_MAX/sizeof(iuliia_mapping_1char_t) < obj->length) return false;
+static bool iuliiaIntMutexInit(iuliia_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	InitializeCriticalSection(mutex);
 
-	new_map = malloc(obj->length*sizeof(iuliia_mapping_1char_t));
-	if(!new_map) return false;
-	memset(new_map, 0, obj->length*sizeof(iuliia_mapping_1char_t));
+	return true;
+#else
+	return pthread_mutex_init(mutex, 0) == 0;
+#endif
+}
 
-	el = obj->start;
-	for(i = 0; i < obj->length; i++) {
-		const uint8_t *new_c;
-		struct json_string_s *str;
+static void iuliiaIntMutexDestroy(iuliia_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	DeleteCriticalSection(mutex);
+#else
+	pthread_mutex_destroy(mutex);
+#endif
+}
 
-		new_c = iuliiaCharU8toU32((const uint8_t *)el->name->string, &(new_map[i].c));
-		if(!new_c) goto IULIIA_ERROR;
+static void iuliiaIntMutexLock(iuliia_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	EnterCriticalSection(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
 
-		str = json_value_as_string(el->value);
-		if(!str) goto IULIIA_ERROR;
+static void iuliiaIntMutexUnlock(iuliia_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	LeaveCriticalSection(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
 
-		new_map[i].repl = iuliiaU8toU32((const uint8_t *)str->string);
-		if(!new_map[i].repl) goto IULIIA_ERROR;
+static bool iuliiaIntCondInit(iuliia_cond_t *cond)
+{
+#if defined(_WIN32)
+	InitializeConditionVariable(cond);
 
-		el = el->next;
-	}
+	return true;
+#else
+	return pthread_cond_init(cond, 0) == 0;
+#endif
+}
 
-	*map = new_map;
+static void iuliiaIntCondDestroy(iuliia_cond_t *cond)
+{
+#if defined(_WIN32)
+	(void)cond; // Windows condition variables have nothing to free
+#else
+	pthread_cond_destroy(cond);
+#endif
+}
 
-	return true;
+// Unlocks mutex, waits for signal and locks mutex again. Waiting may end without signal, so condition is checked in loop
+static void iuliiaIntCondWait(iuliia_cond_t *cond, iuliia_mutex_t *mutex)
+{
+#if defined(_WIN32)
+	SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+	pthread_cond_wait(cond, mutex);
+#endif
+}
 
-IULIIA_ERROR:
+static void iuliiaIntCondSignal(iuliia_cond_t *cond)
+{
+#if defined(_WIN32)
+	WakeConditionVariable(cond);
+#else
+	pthread_cond_signal(cond);
+#endif
+}
 
-	for(i = 0; i < obj->length; i++) {
-		if(new_map[i].repl) free(new_map[i].repl);
-	}
+static void iuliiaIntCondBroadcast(iuliia_cond_t *cond)
+{
+#if defined(_WIN32)
+	WakeAllConditionVariable(cond);
+#else
+	pthread_cond_broadcast(cond);
+#endif
+}
 
-	free(new_map);
+static void iuliiaIntThreadYield(void)
+{
+#if defined(_WIN32)
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
 
-	return false;
+static void iuliiaIntSleep(unsigned int ms)
+{
+#if defined(_WIN32)
+	Sleep(ms);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long)(ms % 1000) * 1000000;
+	nanosleep(&ts, 0);
+#endif
 }
 
-static bool iuliiaIntJsonReadMapping2char(struct json_object_s *obj, iuliia_mapping_2char_t **map, bool cor_first)
+static unsigned int iuliiaIntCpuCount(void)
 {
-	size_t i;
-	struct json_object_element_s *el;
-	iuliia_mapping_2char_t *new_map;
+#if defined(_WIN32)
+	SYSTEM_INFO info;
 
-	if(SIZE_MAX/sizeof(iuliia_mapping_2char_t) < obj->length) return false;
+	GetSystemInfo(&info);
 
-	new_map = malloc(obj->length*sizeof(iuliia_mapping_2char_t));
-	if(!new_map) return false;
-	memset(new_map, 0, obj->length*sizeof(iuliia_mapping_2char_t));
+	return info.dwNumberOfProcessors ? (unsigned int)info.dwNumberOfProcessors : 1;
+#else
+	long count;
 
-	el = obj->start;
-	for(i = 0; i < obj->length; i++) {
-		uint32_t *in_str;
-		size_t in_str_len;
-		struct json_string_s *str;
-
-		in_str = iuliiaU8toU32((const uint8_t *)el->name->string);
-		if(!in_str) goto IULIIA_ERROR;
-		in_str_len = iuliiaU32len(in_str);
-		if(in_str_len == 1)
-			new_map[i].c = in_str[0];
-		else if(in_str_len == 2) {
-			if(cor_first) {
-				new_map[i].cor_c = in_str[0];
-				new_map[i].c = in_str[1];
-			} else {
-				new_map[i].c = in_str[0];
-				new_map[i].cor_c = in_str[1];
-			}
-		} else {
-			free(in_str);
+	count = sysconf(_SC_NPROCESSORS_ONLN);
 
-			goto IULIIA_ERROR;
-		}
-		free(in_str);
+	return count > 0 ? (unsigned int)count : 1;
+#endif
+}
 
-		str = json_value_as_string(el->value);
-		if(!str) goto IULIIA_ERROR;
+#define IULIIA_ARENA_ALIGN 8
 
-		new_map[i].repl = iuliiaU8toU32((const uint8_t *)str->string);
-		if(!new_map[i].repl) goto IULIIA_ERROR;
+typedef struct {
+	uint8_t *base;
+	size_t size;
+	size_t offset;
+} iuliia_arena_t;
 
-		el = el->next;
+// Allocates memory from arena. Arena without memory (base == 0) only counts
+// requested size, so the same loading code is used to measure and to fill scheme
+static void *iuliiaIntArenaAlloc(iuliia_arena_t *arena, size_t size, bool *overflow)
+{
+	void *p;
+
+	if(SIZE_MAX-IULIIA_ARENA_ALIGN < size) {
+		*overflow = true;
+
+		return 0;
 	}
+	size = (size + IULIIA_ARENA_ALIGN - 1) & ~(size_t)(IULIIA_ARENA_ALIGN - 1);
 
-	*map = new_map;
+	if(!arena->base) {
+		if(SIZE_MAX-arena->offset < size) *overflow = true;
+		else arena->offset += size;
 
-	return true;
+		return 0;
+	}
 
-IULIIA_ERROR:
+	if(arena->size-arena->offset < size) {
+		*overflow = true;
 
-	for(i = 0; i < obj->length; i++) {
-		if(new_map[i].repl) free(new_map[i].repl);
+		return 0;
 	}
 
-	free(new_map);
+	p = arena->base + arena->offset;
+	arena->offset += size;
 
-	return false;
+	return p;
 }
 
-static bool iuliiaIntJsonReadSamples(struct json_array_s *arr, iuliia_samples_t **samples)
+// Allocator for json_parse_ex. json.h makes one allocation for the whole DOM, so it is placed
+// at the start of scratch arena and freed by resetting the arena. Thread of directory loader
+// keeps its scratch arena for all its files, other loads free it after one scheme
+static void *iuliiaIntJsonAlloc(void *user_data, size_t size)
 {
-	iuliia_samples_t *new_samples;
-	struct json_array_element_s *arr_el;
-	size_t i = 0;
+	iuliia_arena_t *arena;
+	bool overflow = false;
 
-	if(SIZE_MAX/sizeof(iuliia_samples_t) < arr->length) return false;
+	arena = (iuliia_arena_t *)user_data;
 
-	new_samples = malloc(arr->length*sizeof(iuliia_samples_t));
-	if(!new_samples) return false;
-	memset(new_samples, 0, arr->length*sizeof(iuliia_samples_t));
+	if(SIZE_MAX-IULIIA_ARENA_ALIGN < size) return 0;
 
-	arr_el = arr->start;
-	while(arr_el) {
-		struct json_array_s *sample;
-		struct json_array_element_s *sample_el;
-		
-		sample = json_value_as_array(arr_el->value);
-		if(!sample) goto IULIIA_ERROR;
+	if(arena->size-arena->offset < size+IULIIA_ARENA_ALIGN && !arena->offset) {
+		uint8_t *new_base;
 
-		if(sample->length != 2) goto IULIIA_ERROR;
+		new_base = malloc(size+IULIIA_ARENA_ALIGN);
+		if(!new_base) return 0;
 
-		sample_el = sample->start;
-		if(!iuliiaIntJsonLoadStringW(sample_el->value, &(new_samples[i].in))) goto IULIIA_ERROR;
-		sample_el = sample_el->next;
-		if(!iuliiaIntJsonLoadStringW(sample_el->value, &(new_samples[i].out))) goto IULIIA_ERROR;
+		free(arena->base);
+		arena->base = new_base;
+		arena->size = size+IULIIA_ARENA_ALIGN;
+	}
 
-		arr_el = arr_el->next;
-		i++;
+	return iuliiaIntArenaAlloc(arena, size, &overflow);
+}
+
+// Counts characters in UTF-8 string as UTF-32 and as wchar_t
+static bool iuliiaIntU8Count(const uint8_t *u8, size_t *u32_len, size_t *w_len)
+{
+	size_t new_u32_len = 0, new_w_len = 0;
+
+	while(*u8) {
+		uint32_t c;
+
+		u8 = iuliiaCharU8toU32(u8, &c);
+		if(!u8) return false;
+
+		new_u32_len++;
+		if(sizeof(wchar_t) < sizeof(uint32_t) && c >= 0x10000)
+			new_w_len += 2;
+		else
+			new_w_len++;
 	}
 
-	*samples = new_samples;
+	if(u32_len) *u32_len = new_u32_len;
+	if(w_len) *w_len = new_w_len;
 
 	return true;
+}
 
-IULIIA_ERROR:
+static bool iuliiaIntJsonLoadStringW(struct json_value_s *value, iuliia_arena_t *arena, wchar_t **str)
+{
+	struct json_string_s *val;
+	const uint8_t *u8;
+	wchar_t *new_str, *p;
+	size_t w_len;
+	bool overflow = false;
 
-	for(i = 0; i < arr->length; i++) {
-		if(new_samples[i].in) free(new_samples[i].in);
-		if(new_samples[i].out) free(new_samples[i].out);
+	val = json_value_as_string(value);
+	if(!val) return false;
+
+	if(!iuliiaIntU8Count((const uint8_t *)val->string, 0, &w_len)) return false;
+	if(SIZE_MAX/sizeof(wchar_t) <= w_len) return false;
+
+	new_str = iuliiaIntArenaAlloc(arena, (w_len+1)*sizeof(wchar_t), &overflow);
+	if(overflow) return false;
+	*str = new_str;
+	if(!new_str) return true;
+
+	u8 = (const uint8_t *)val->string;
+	p = new_str;
+	while(*u8) {
+		uint32_t c;
+
+		u8 = iuliiaCharU8toU32(u8, &c);
+		if(sizeof(wchar_t) < sizeof(uint32_t) && c >= 0x10000) {
+			*(p++) = (wchar_t)((c-0x10000) >> 10 | 0xd800);
+			*(p++) = (wchar_t)(((c-0x10000) & 0x3ff) | 0xdc00);
+		} else
+			*(p++) = (wchar_t)c;
 	}
+	*p = 0;
+
+	return true;
+}
+
+static bool iuliiaIntJsonLoadStringU32(struct json_value_s *value, iuliia_arena_t *arena, uint32_t **str)
+{
+	struct json_string_s *val;
+	const uint8_t *u8;
+	uint32_t *new_str, *p;
+	size_t u32_len;
+	bool overflow = false;
 
-	free(new_samples);
+	val = json_value_as_string(value);
+	if(!val) return false;
 
-	return false;
+	if(!iuliiaIntU8Count((const uint8_t *)val->string, &u32_len, 0)) return false;
+	if(SIZE_MAX/sizeof(uint32_t) <= u32_len) return false;
+
+	new_str = iuliiaIntArenaAlloc(arena, (u32_len+1)*sizeof(uint32_t), &overflow);
+	if(overflow) return false;
+	*str = new_str;
+	if(!new_str) return true;
+
+	u8 = (const uint8_t *)val->string;
+	p = new_str;
+	while(*u8) u8 = iuliiaCharU8toU32(u8, p++);
+	*p = 0;
+
+	return true;
 }
 
-iuliia_scheme_t *iuliiaLoadSchemeFromMemory(char *json, size_t json_length)
+static bool iuliiaIntJsonReadMapping1char(struct json_object_s *obj, iuliia_arena_t *arena, iuliia_mapping_1char_t **map)
 {
-	iuliia_scheme_t *scheme;
-	struct json_value_s *root = json_parse(json, json_length);
-	struct json_object_s *object;
+	size_t i;
 	struct json_object_element_s *el;
+	iuliia_mapping_1char_t *new_map;
+	bool overflow = false;
 
-	if(!root) return 0;
+	if(SIZE_MAX/sizeof(iuliia_mapping_1char_t) < obj->length) return false;
 
-	object = json_value_as_object(root);
-	if(!object) {
-		free(root);
+	new_map = iuliiaIntArenaAlloc(arena, obj->length*sizeof(iuliia_mapping_1char_t), &overflow);
+	if(overflow) return false;
 
-		return 0;
-	}
+	el = obj->start;
+	for(i = 0; i < obj->length; i++) {
+		uint32_t c, *repl;
 
-	scheme = malloc(sizeof(iuliia_scheme_t));
-	if(!scheme) {
-		free(root);
+		if(!iuliiaCharU8toU32((const uint8_t *)el->name->string, &c)) return false;
 
-		return 0;
+		if(!iuliiaIntJsonLoadStringU32(el->value, arena, &repl)) return false;
+
+		if(new_map) {
+			new_map[i].c = c;
+			new_map[i].repl = repl;
+		}
+
+		el = el->next;
 	}
-	memset(scheme, 0, sizeof(iuliia_scheme_t));
 
-	el = object->start;
-	while(el) {
-		if(!strncmp(el->name->string, "name", el->name->string_size)) {
-			if(!iuliiaIntJsonLoadStringW(el->value, &(scheme->name))) goto IULIIA_ERROR;
-		} else if(!strncmp(el->name->string, "description", el->name->string_size)) {
-			if(!iuliiaIntJsonLoadStringW(el->value, &(scheme->description))) goto IULIIA_ERROR;
-		} else if(!strncmp(el->name->string, "url", el->name->string_size)) {
-			if(!iuliiaIntJsonLoadStringW(el->value, &(scheme->url))) goto IULIIA_ERROR;
-		} else if(!strncmp(el->name->string, "mapping", el->name->string_size)) {
-			if(!json_value_is_null(el->value)) {
-				struct json_object_s *obj;
+	*map = new_map;
 
-				obj = json_value_as_object(el->value);
-				if(!obj) goto IULIIA_ERROR;
-				if(!iuliiaIntJsonReadMapping1char(obj, &(scheme->mapping))) goto IULIIA_ERROR;
-				scheme->nof_mapping = obj->length;
-			}
-		} else if(!strncmp(el->name->string, "prev_mapping", el->name->string_size)) {
-			if(!json_value_is_null(el->value)) {
-				struct json_object_s *obj;
+	return true;
+}
 
-				obj = json_value_as_object(el->value);
-				if(!obj) goto IULIIA_ERROR;
-				if(!iuliiaIntJsonReadMapping2char(obj, &(scheme->prev_mapping), true)) goto IULIIA_ERROR;
-				scheme->nof_prev_mapping = obj->length;
-			}
-		} else if(!strncmp(el->name->string, "next_mapping", el->name->string_size)) {
-			if(!json_value_is_null(el->value)) {
-				struct json_object_s *obj;
+static bool iuliiaIntJsonReadMapping2char(struct json_object_s *obj, iuliia_arena_t *arena, iuliia_mapping_2char_t **map, bool cor_first)
+{
+	size_t i;
+	struct json_object_element_s *el;
+	iuliia_mapping_2char_t *new_map;
+	bool overflow = false;
 
-				obj = json_value_as_object(el->value);
-				if(!obj) goto IULIIA_ERROR;
-				if(!iuliiaIntJsonReadMapping2char(obj, &(scheme->next_mapping), false)) goto IULIIA_ERROR;
-				scheme->nof_next_mapping = obj->length;
-			}
-		} else if(!strncmp(el->name->string, "ending_mapping", el->name->string_size)) {
-			if(!json_value_is_null(el->value)) {
-				struct json_object_s *obj;
+	if(SIZE_MAX/sizeof(iuliia_mapping_2char_t) < obj->length) return false;
 
-				obj = json_value_as_object(el->value);
-				if(!obj) goto IULIIA_ERROR;
-				if(!iuliiaIntJsonReadMapping2char(obj, &(scheme->ending_mapping), false)) goto IULIIA_ERROR;
-				scheme->nof_ending_mapping = obj->length;
-			}
-		} else if(!strncmp(el->name->string, "samples", el->name->string_size)) {
-			if(!json_value_is_null(el->value)) {
-				struct json_array_s *arr;
+	new_map = iuliiaIntArenaAlloc(arena, obj->length*sizeof(iuliia_mapping_2char_t), &overflow);
+	if(overflow) return false;
 
-				arr = json_value_as_array(el->value);
-				if(!arr) goto IULIIA_ERROR;
-				if(!iuliiaIntJsonReadSamples(arr, &(scheme->samples))) goto IULIIA_ERROR;
-				scheme->nof_samples = arr->length;
+	el = obj->start;
+	for(i = 0; i < obj->length; i++) {
+		const uint8_t *key;
+		uint32_t first_c, second_c = 0, *repl;
+
+		key = (const uint8_t *)el->name->string;
+		if(!(*key)) return false;
+		key = iuliiaCharU8toU32(key, &first_c);
+		if(!key) return false;
+		if(*key) {
+			key = iuliiaCharU8toU32(key, &second_c);
+			if(!key || *key) return false;
+		}
+
+		if(!iuliiaIntJsonLoadStringU32(el->value, arena, &repl)) return false;
+
+		if(new_map) {
+			if(!second_c) {
+				new_map[i].c = first_c;
+				new_map[i].cor_c = 0;
+			} else if(cor_first) {
+				new_map[i].cor_c = first_c;
+				new_map[i].c = second_c;
+			} else {
+				new_map[i].c = first_c;
+				new_map[i].cor_c = second_c;
 			}
+			new_map[i].repl = repl;
 		}
 
 		el = el->next;
 	}
 
-	if(!scheme->name || !scheme->description || !scheme->url || !scheme->mapping || !scheme->samples) goto IULIIA_ERROR;
+	*map = new_map;
 
-	free(root);
+	return true;
+}
 
-	iuliiaPrepareScheme(scheme);
+// Replacements are put to arena in order of keys in json, so the last one of repeated keys has the greatest address
+static int iuliiaIntCompareJson1char(const void *a, const void *b)
+{
+	const iuliia_mapping_1char_t *map_a, *map_b;
 
-	return scheme;
+	map_a = (const iuliia_mapping_1char_t *)a;
+	map_b = (const iuliia_mapping_1char_t *)b;
 
-IULIIA_ERROR:
+	if(map_a->c != map_b->c)
+		return map_a->c < map_b->c ? -1 : 1;
+	else if(map_a->repl != map_b->repl)
+		return (uintptr_t)map_a->repl < (uintptr_t)map_b->repl ? -1 : 1;
+	else
+		return 0;
+}
 
-	free(root);
+static int iuliiaIntCompareJson2char(const void *a, const void *b)
+{
+	const iuliia_mapping_2char_t *map_a, *map_b;
 
-	iuliiaFreeScheme(scheme);
+	map_a = (const iuliia_mapping_2char_t *)a;
+	map_b = (const iuliia_mapping_2char_t *)b;
 
-	return 0;
+	if(map_a->c != map_b->c)
+		return map_a->c < map_b->c ? -1 : 1;
+	else if(map_a->cor_c != map_b->cor_c)
+		return map_a->cor_c < map_b->cor_c ? -1 : 1;
+	else if(map_a->repl != map_b->repl)
+		return (uintptr_t)map_a->repl < (uintptr_t)map_b->repl ? -1 : 1;
+	else
+		return 0;
 }
 
-void iuliiaFreeScheme(iuliia_scheme_t *scheme)
+// Of repeated keys the last one wins, as in builder. Returns number of rules left
+static size_t iuliiaIntJsonUnique1char(iuliia_mapping_1char_t *map, size_t nof_map)
 {
-	if(!scheme) return;
-
-	if(scheme->name) free(scheme->name);
-	if(scheme->description) free(scheme->description);
-	if(scheme->url) free(scheme->url);
+	size_t i, k = 0;
 
-	if(scheme->nof_mapping) {
-		size_t i;
+	if(!map || nof_map < 2) return nof_map;
 
-		for(i = 0; i < scheme->nof_mapping; i++) {
-			if(scheme->mapping[i].repl) free(scheme->mapping[i].repl);
-		}
+	qsort(map, nof_map, sizeof(iuliia_mapping_1char_t), iuliiaIntCompareJson1char);
+	for(i = 0; i < nof_map; i++) {
+		if(i+1 < nof_map && map[i].c == map[i+1].c) continue;
 
-		free(scheme->mapping);
+		map[k++] = map[i];
 	}
 
-	if(scheme->nof_prev_mapping) {
-		size_t i;
+	return k;
+}
 
-		for(i = 0; i < scheme->nof_prev_mapping; i++) {
-			if(scheme->prev_mapping[i].repl) free(scheme->prev_mapping[i].repl);
-		}
+static size_t iuliiaIntJsonUnique2char(iuliia_mapping_2char_t *map, size_t nof_map)
+{
+	size_t i, k = 0;
 
-		free(scheme->prev_mapping);
-	}
+	if(!map || nof_map < 2) return nof_map;
 
-	if(scheme->nof_next_mapping) {
-		size_t i;
+	qsort(map, nof_map, sizeof(iuliia_mapping_2char_t), iuliiaIntCompareJson2char);
+	for(i = 0; i < nof_map; i++) {
+		if(i+1 < nof_map && map[i].c == map[i+1].c && map[i].cor_c == map[i+1].cor_c) continue;
 
-		for(i = 0; i < scheme->nof_next_mapping; i++) {
+		map[k++] = map[i];
+	}
+
+	return k;
+}
+
+// Strips flags of pattern key (^ at start, $ at end) and lowers its characters in place.
+// Pattern should have from 1 to IULIIA_MAX_PATTERN_LENGTH characters
+static bool iuliiaIntPatternFromKey(uint32_t *key, size_t *len, unsigned int *flags)
+{
+	size_t i, start = 0, end;
+
+	end = *len;
+	*flags = 0;
+	if(end > 0 && key[0] == '^') {
+		*flags |= IULIIA_PATTERN_WORD_START;
+		start = 1;
+	}
+	if(end > start && key[end-1] == '$') {
+		*flags |= IULIIA_PATTERN_WORD_END;
+		end--;
+	}
+	if(end == start || end-start > IULIIA_MAX_PATTERN_LENGTH) return false;
+
+	for(i = start; i < end; i++)
+		key[i-start] = iuliiaU32ToLower(key[i]);
+	key[end-start] = 0;
+	*len = end-start;
+
+	return true;
+}
+
+// Reads patterns and allocates place for their trie, which is built by iuliiaPrepareScheme
+static bool iuliiaIntJsonReadMappingPattern(struct json_object_s *obj, iuliia_arena_t *arena, iuliia_mapping_pattern_t **map, iuliia_pattern_node_t **trie)
+{
+	size_t i, nof_nodes = 1;
+	struct json_object_element_s *el;
+	iuliia_mapping_pattern_t *new_map;
+	iuliia_pattern_node_t *new_trie;
+	bool overflow = false;
+
+	if(SIZE_MAX/sizeof(iuliia_mapping_pattern_t) < obj->length) return false;
+
+	new_map = iuliiaIntArenaAlloc(arena, obj->length*sizeof(iuliia_mapping_pattern_t), &overflow);
+	if(overflow) return false;
+
+	el = obj->start;
+	for(i = 0; i < obj->length; i++) {
+		const uint8_t *key;
+		uint32_t key_s[IULIIA_MAX_PATTERN_LENGTH+3], *pattern, *repl;
+		size_t key_len = 0;
+		unsigned int flags;
+
+		key = (const uint8_t *)el->name->string;
+		while(*key) {
+			if(key_len == IULIIA_MAX_PATTERN_LENGTH+2) return false;
+			key = iuliiaCharU8toU32(key, key_s+key_len);
+			if(!key) return false;
+			key_len++;
+		}
+		if(!iuliiaIntPatternFromKey(key_s, &key_len, &flags)) return false;
+
+		pattern = iuliiaIntArenaAlloc(arena, (key_len+1)*sizeof(uint32_t), &overflow);
+		if(overflow) return false;
+		if(pattern) memcpy(pattern, key_s, (key_len+1)*sizeof(uint32_t));
+
+		if(!iuliiaIntJsonLoadStringU32(el->value, arena, &repl)) return false;
+
+		if(new_map) {
+			new_map[i].pattern = pattern;
+			new_map[i].repl = repl;
+			new_map[i].flags = flags;
+		}
+		nof_nodes += key_len;
+
+		el = el->next;
+	}
+
+	new_trie = iuliiaIntArenaAlloc(arena, nof_nodes*sizeof(iuliia_pattern_node_t), &overflow);
+	if(overflow) return false;
+
+	*map = new_map;
+	*trie = new_trie;
+
+	return true;
+}
+
+static bool iuliiaIntJsonReadSamples(struct json_array_s *arr, iuliia_arena_t *arena, iuliia_samples_t **samples)
+{
+	iuliia_samples_t *new_samples;
+	struct json_array_element_s *arr_el;
+	size_t i = 0;
+	bool overflow = false;
+
+	if(SIZE_MAX/sizeof(iuliia_samples_t) < arr->length) return false;
+
+	new_samples = iuliiaIntArenaAlloc(arena, arr->length*sizeof(iuliia_samples_t), &overflow);
+	if(overflow) return false;
+
+	arr_el = arr->start;
+	while(arr_el) {
+		struct json_array_s *sample;
+		struct json_array_element_s *sample_el;
+		wchar_t *in, *out;
+		
+		sample = json_value_as_array(arr_el->value);
+		if(!sample) return false;
+
+		if(sample->length != 2) return false;
+
+		sample_el = sample->start;
+		if(!iuliiaIntJsonLoadStringW(sample_el->value, arena, &in)) return false;
+		sample_el = sample_el->next;
+		if(!iuliiaIntJsonLoadStringW(sample_el->value, arena, &out)) return false;
+
+		if(new_samples) {
+			new_samples[i].in = in;
+			new_samples[i].out = out;
+		}
+
+		arr_el = arr_el->next;
+		i++;
+	}
+
+	*samples = new_samples;
+
+	return true;
+}
+
+static bool iuliiaIntJsonKeyIs(const struct json_string_s *name, const char *key)
+{
+	return name->string_size == strlen(key) && !memcmp(name->string, key, name->string_size);
+}
+
+// Loads scheme from json object to arena. Called twice: first time with empty
+// arena to measure scheme size, second time to fill scheme
+static bool iuliiaIntJsonReadScheme(struct json_object_s *object, iuliia_arena_t *arena, iuliia_scheme_t *scheme, unsigned int flags)
+{
+	struct json_object_element_s *el;
+
+	el = object->start;
+	while(el) {
+		if(iuliiaIntJsonKeyIs(el->name, "name")) {
+			if(!(flags & IULIIA_LOAD_SKIP_METADATA))
+				if(!iuliiaIntJsonLoadStringW(el->value, arena, &(scheme->name))) return false;
+		} else if(iuliiaIntJsonKeyIs(el->name, "description")) {
+			if(!(flags & IULIIA_LOAD_SKIP_METADATA))
+				if(!iuliiaIntJsonLoadStringW(el->value, arena, &(scheme->description))) return false;
+		} else if(iuliiaIntJsonKeyIs(el->name, "url")) {
+			if(!(flags & IULIIA_LOAD_SKIP_METADATA))
+				if(!iuliiaIntJsonLoadStringW(el->value, arena, &(scheme->url))) return false;
+		} else if(iuliiaIntJsonKeyIs(el->name, "mapping")) {
+			if(!json_value_is_null(el->value)) {
+				struct json_object_s *obj;
+
+				obj = json_value_as_object(el->value);
+				if(!obj) return false;
+				if(!iuliiaIntJsonReadMapping1char(obj, arena, &(scheme->mapping))) return false;
+				scheme->nof_mapping = iuliiaIntJsonUnique1char(scheme->mapping, obj->length);
+			}
+		} else if(iuliiaIntJsonKeyIs(el->name, "prev_mapping")) {
+			if(!json_value_is_null(el->value)) {
+				struct json_object_s *obj;
+
+				obj = json_value_as_object(el->value);
+				if(!obj) return false;
+				if(!iuliiaIntJsonReadMapping2char(obj, arena, &(scheme->prev_mapping), true)) return false;
+				scheme->nof_prev_mapping = iuliiaIntJsonUnique2char(scheme->prev_mapping, obj->length);
+			}
+		} else if(iuliiaIntJsonKeyIs(el->name, "next_mapping")) {
+			if(!json_value_is_null(el->value)) {
+				struct json_object_s *obj;
+
+				obj = json_value_as_object(el->value);
+				if(!obj) return false;
+				if(!iuliiaIntJsonReadMapping2char(obj, arena, &(scheme->next_mapping), false)) return false;
+				scheme->nof_next_mapping = iuliiaIntJsonUnique2char(scheme->next_mapping, obj->length);
+			}
+		} else if(iuliiaIntJsonKeyIs(el->name, "ending_mapping")) {
+			if(!json_value_is_null(el->value)) {
+				struct json_object_s *obj;
+
+				obj = json_value_as_object(el->value);
+				if(!obj) return false;
+				if(!iuliiaIntJsonReadMapping2char(obj, arena, &(scheme->ending_mapping), false)) return false;
+				scheme->nof_ending_mapping = iuliiaIntJsonUnique2char(scheme->ending_mapping, obj->length);
+			}
+		} else if(iuliiaIntJsonKeyIs(el->name, "pattern_mapping")) {
+			if(!json_value_is_null(el->value)) {
+				struct json_object_s *obj;
+
+				obj = json_value_as_object(el->value);
+				if(!obj) return false;
+				if(!iuliiaIntJsonReadMappingPattern(obj, arena, &(scheme->pattern_mapping), &(scheme->pattern_trie))) return false;
+				scheme->nof_pattern_mapping = obj->length;
+			}
+		} else if(iuliiaIntJsonKeyIs(el->name, "samples")) {
+			if(!json_value_is_null(el->value) && !(flags & IULIIA_LOAD_SKIP_SAMPLES)) {
+				struct json_array_s *arr;
+
+				arr = json_value_as_array(el->value);
+				if(!arr) return false;
+				if(!iuliiaIntJsonReadSamples(arr, arena, &(scheme->samples))) return false;
+				scheme->nof_samples = arr->length;
+			}
+		}
+
+		el = el->next;
+	}
+
+	return true;
+}
+
+#define IULIIA_NOF_TABLES 4
+
+#define IULIIA_NO_STRING SIZE_MAX
+
+typedef struct {
+	uint32_t c;
+	uint32_t cor_c;
+	size_t repl; // Offset of replacement in builder pool
+} iuliia_builder_rule_t;
+
+typedef struct {
+	iuliia_builder_rule_t *rules;
+	size_t nof_rules;
+	size_t max_rules;
+	bool present;
+} iuliia_builder_table_t;
+
+typedef struct {
+	size_t pattern; // Offset of pattern in builder pool
+	size_t repl;
+	unsigned int flags;
+} iuliia_builder_pattern_t;
+
+// Scheme under construction. Strings are kept as zero terminated UTF-32 in pool
+struct iuliia_builder_s {
+	iuliia_builder_table_t tables[IULIIA_NOF_TABLES];
+	iuliia_builder_pattern_t *patterns; // Repeats are kept, trie of scheme finds the last added one
+	size_t nof_patterns;
+	size_t max_patterns;
+	uint32_t *pool;
+	size_t pool_len;
+	size_t max_pool;
+	size_t name;
+	size_t description;
+	size_t url;
+	size_t *samples; // Pairs of in and out strings
+	size_t nof_samples;
+	size_t max_samples;
+	bool samples_present;
+};
+
+static void iuliiaIntBuilderInit(iuliia_builder_t *builder)
+{
+	memset(builder, 0, sizeof(iuliia_builder_t));
+
+	builder->name = IULIIA_NO_STRING;
+	builder->description = IULIIA_NO_STRING;
+	builder->url = IULIIA_NO_STRING;
+}
+
+static void iuliiaIntBuilderDestroy(iuliia_builder_t *builder)
+{
+	size_t i;
+
+	for(i = 0; i < IULIIA_NOF_TABLES; i++)
+		free(builder->tables[i].rules);
+
+	free(builder->patterns);
+	free(builder->pool);
+	free(builder->samples);
+}
+
+// Grows array to hold at least one more element
+static bool iuliiaIntGrowArray(void **array, size_t *max_count, size_t count, size_t element_size)
+{
+	void *new_array;
+	size_t new_max_count;
+
+	if(count < *max_count) return true;
+
+	if(*max_count)
+		new_max_count = *max_count * 2;
+	else
+		new_max_count = 16;
+	if(new_max_count < *max_count || SIZE_MAX/element_size < new_max_count) return false;
+
+	new_array = realloc(*array, new_max_count*element_size);
+	if(!new_array) return false;
+
+	*array = new_array;
+	*max_count = new_max_count;
+
+	return true;
+}
+
+static bool iuliiaIntBuilderPutChar(iuliia_builder_t *builder, uint32_t c)
+{
+	if(!iuliiaIntGrowArray((void **)&(builder->pool), &(builder->max_pool), builder->pool_len, sizeof(uint32_t))) return false;
+
+	builder->pool[builder->pool_len++] = c;
+
+	return true;
+}
+
+static bool iuliiaIntBuilderAddRule(iuliia_builder_t *builder, int table, uint32_t c, uint32_t cor_c, size_t repl)
+{
+	iuliia_builder_table_t *t;
+
+	t = builder->tables + table;
+	if(!iuliiaIntGrowArray((void **)&(t->rules), &(t->max_rules), t->nof_rules, sizeof(iuliia_builder_rule_t))) return false;
+
+	t->rules[t->nof_rules].c = c;
+	t->rules[t->nof_rules].cor_c = cor_c;
+	t->rules[t->nof_rules].repl = repl;
+	t->nof_rules++;
+	t->present = true;
+
+	return true;
+}
+
+static bool iuliiaIntBuilderAddPattern(iuliia_builder_t *builder, size_t pattern, unsigned int flags, size_t repl)
+{
+	if(!iuliiaIntGrowArray((void **)&(builder->patterns), &(builder->max_patterns), builder->nof_patterns, sizeof(iuliia_builder_pattern_t))) return false;
+
+	builder->patterns[builder->nof_patterns].pattern = pattern;
+	builder->patterns[builder->nof_patterns].repl = repl;
+	builder->patterns[builder->nof_patterns].flags = flags;
+	builder->nof_patterns++;
+
+	return true;
+}
+
+// Copies UTF-32 string from builder pool to arena, either as UTF-32 or as wchar_t
+static void *iuliiaIntBuilderCopyString(const iuliia_builder_t *builder, size_t str, iuliia_arena_t *arena, bool wide, bool *overflow)
+{
+	const uint32_t *s;
+	size_t len = 0;
+
+	s = builder->pool + str;
+	if(wide) {
+		wchar_t *new_str, *p;
+
+		while(s[len]) {
+			if(sizeof(wchar_t) < sizeof(uint32_t) && s[len] >= 0x10000) len++;
+			len++;
+		}
+		if(SIZE_MAX/sizeof(wchar_t) <= len) {
+			*overflow = true;
+
+			return 0;
+		}
+
+		new_str = iuliiaIntArenaAlloc(arena, (len+1)*sizeof(wchar_t), overflow);
+		if(!new_str) return 0;
+
+		p = new_str;
+		while(*s) {
+			if(sizeof(wchar_t) < sizeof(uint32_t) && *s >= 0x10000) {
+				*(p++) = (wchar_t)((*s-0x10000) >> 10 | 0xd800);
+				*(p++) = (wchar_t)(((*s-0x10000) & 0x3ff) | 0xdc00);
+			} else
+				*(p++) = (wchar_t)(*s);
+			s++;
+		}
+		*p = 0;
+
+		return new_str;
+	} else {
+		uint32_t *new_str;
+
+		len = iuliiaU32len(s);
+		if(SIZE_MAX/sizeof(uint32_t) <= len) {
+			*overflow = true;
+
+			return 0;
+		}
+
+		new_str = iuliiaIntArenaAlloc(arena, (len+1)*sizeof(uint32_t), overflow);
+		if(!new_str) return 0;
+
+		memcpy(new_str, s, (len+1)*sizeof(uint32_t));
+
+		return new_str;
+	}
+}
+
+// Lays out scheme from builder in arena. Called twice: to measure and to fill scheme
+static bool iuliiaIntBuilderLayout(const iuliia_builder_t *builder, iuliia_arena_t *arena, iuliia_scheme_t *scheme)
+{
+	bool overflow = false;
+	size_t i, j;
+
+	if(builder->name != IULIIA_NO_STRING) scheme->name = iuliiaIntBuilderCopyString(builder, builder->name, arena, true, &overflow);
+	if(builder->description != IULIIA_NO_STRING) scheme->description = iuliiaIntBuilderCopyString(builder, builder->description, arena, true, &overflow);
+	if(builder->url != IULIIA_NO_STRING) scheme->url = iuliiaIntBuilderCopyString(builder, builder->url, arena, true, &overflow);
+
+	for(i = 0; i < IULIIA_NOF_TABLES; i++) {
+		const iuliia_builder_table_t *t;
+
+		t = builder->tables + i;
+		if(!t->present) continue;
+
+		if(i == IULIIA_TABLE_MAPPING) {
+			iuliia_mapping_1char_t *map;
+
+			if(SIZE_MAX/sizeof(iuliia_mapping_1char_t) < t->nof_rules) return false;
+			map = iuliiaIntArenaAlloc(arena, t->nof_rules*sizeof(iuliia_mapping_1char_t), &overflow);
+			for(j = 0; j < t->nof_rules; j++) {
+				uint32_t *repl;
+
+				repl = iuliiaIntBuilderCopyString(builder, t->rules[j].repl, arena, false, &overflow);
+				if(map) {
+					map[j].c = t->rules[j].c;
+					map[j].repl = repl;
+				}
+			}
+
+			scheme->mapping = map;
+			scheme->nof_mapping = t->nof_rules;
+		} else {
+			iuliia_mapping_2char_t *map;
+
+			if(SIZE_MAX/sizeof(iuliia_mapping_2char_t) < t->nof_rules) return false;
+			map = iuliiaIntArenaAlloc(arena, t->nof_rules*sizeof(iuliia_mapping_2char_t), &overflow);
+			for(j = 0; j < t->nof_rules; j++) {
+				uint32_t *repl;
+
+				repl = iuliiaIntBuilderCopyString(builder, t->rules[j].repl, arena, false, &overflow);
+				if(map) {
+					map[j].c = t->rules[j].c;
+					map[j].cor_c = t->rules[j].cor_c;
+					map[j].repl = repl;
+				}
+			}
+
+			if(i == IULIIA_TABLE_PREV) {
+				scheme->prev_mapping = map;
+				scheme->nof_prev_mapping = t->nof_rules;
+			} else if(i == IULIIA_TABLE_NEXT) {
+				scheme->next_mapping = map;
+				scheme->nof_next_mapping = t->nof_rules;
+			} else {
+				scheme->ending_mapping = map;
+				scheme->nof_ending_mapping = t->nof_rules;
+			}
+		}
+	}
+
+	if(builder->nof_patterns) {
+		iuliia_mapping_pattern_t *map;
+		size_t nof_nodes = 1;
+
+		if(SIZE_MAX/sizeof(iuliia_mapping_pattern_t) < builder->nof_patterns) return false;
+		map = iuliiaIntArenaAlloc(arena, builder->nof_patterns*sizeof(iuliia_mapping_pattern_t), &overflow);
+		for(i = 0; i < builder->nof_patterns; i++) {
+			uint32_t *pattern, *repl;
+
+			pattern = iuliiaIntBuilderCopyString(builder, builder->patterns[i].pattern, arena, false, &overflow);
+			repl = iuliiaIntBuilderCopyString(builder, builder->patterns[i].repl, arena, false, &overflow);
+			if(map) {
+				map[i].pattern = pattern;
+				map[i].repl = repl;
+				map[i].flags = builder->patterns[i].flags;
+			}
+			nof_nodes += iuliiaU32len(builder->pool + builder->patterns[i].pattern);
+		}
+
+		scheme->pattern_mapping = map;
+		scheme->nof_pattern_mapping = builder->nof_patterns;
+		scheme->pattern_trie = iuliiaIntArenaAlloc(arena, nof_nodes*sizeof(iuliia_pattern_node_t), &overflow);
+	}
+
+	if(builder->samples_present) {
+		iuliia_samples_t *samples;
+
+		if(SIZE_MAX/sizeof(iuliia_samples_t) < builder->nof_samples) return false;
+		samples = iuliiaIntArenaAlloc(arena, builder->nof_samples*sizeof(iuliia_samples_t), &overflow);
+		for(i = 0; i < builder->nof_samples; i++) {
+			wchar_t *in, *out;
+
+			in = iuliiaIntBuilderCopyString(builder, builder->samples[2*i], arena, true, &overflow);
+			out = iuliiaIntBuilderCopyString(builder, builder->samples[2*i+1], arena, true, &overflow);
+			if(samples) {
+				samples[i].in = in;
+				samples[i].out = out;
+			}
+		}
+
+		scheme->samples = samples;
+		scheme->nof_samples = builder->nof_samples;
+	}
+
+	return !overflow;
+}
+
+static int iuliiaIntCompareBuilderRules(const void *a, const void *b)
+{
+	const iuliia_builder_rule_t *rule_a, *rule_b;
+
+	rule_a = (const iuliia_builder_rule_t *)a;
+	rule_b = (const iuliia_builder_rule_t *)b;
+
+	if(rule_a->c != rule_b->c)
+		return rule_a->c < rule_b->c ? -1 : 1;
+	else if(rule_a->cor_c != rule_b->cor_c)
+		return rule_a->cor_c < rule_b->cor_c ? -1 : 1;
+	else if(rule_a->repl != rule_b->repl) // Replacements are put to pool in order of adding rules
+		return rule_a->repl < rule_b->repl ? -1 : 1;
+	else
+		return 0;
+}
+
+// Sorts rules and removes repeated ones, the last added rule wins
+static void iuliiaIntBuilderSortRules(iuliia_builder_t *builder)
+{
+	size_t i, j, k;
+
+	for(i = 0; i < IULIIA_NOF_TABLES; i++) {
+		iuliia_builder_table_t *t;
+
+		t = builder->tables + i;
+		if(t->nof_rules < 2) continue;
+
+		qsort(t->rules, t->nof_rules, sizeof(iuliia_builder_rule_t), iuliiaIntCompareBuilderRules);
+
+		k = 0;
+		for(j = 0; j < t->nof_rules; j++) {
+			if(j+1 < t->nof_rules && t->rules[j].c == t->rules[j+1].c && t->rules[j].cor_c == t->rules[j+1].cor_c) continue;
+
+			t->rules[k++] = t->rules[j];
+		}
+		t->nof_rules = k;
+	}
+}
+
+static void iuliiaIntSelectEngine(iuliia_scheme_t *scheme);
+static bool iuliiaIntEngineIsSelected(const iuliia_scheme_t *scheme);
+static void *iuliiaIntJitCompile(const iuliia_scheme_t *scheme);
+static void iuliiaIntJitFree(void *jit_ptr);
+static void *iuliiaIntFstCompile(const iuliia_scheme_t *scheme);
+static void iuliiaIntFstFree(void *fst_ptr);
+
+// Makes prepared scheme in single memory block
+static iuliia_scheme_t *iuliiaIntBuilderFinish(iuliia_builder_t *builder)
+{
+	iuliia_scheme_t *scheme, measured_scheme;
+	iuliia_arena_t arena;
+	bool overflow = false;
+
+	iuliiaIntBuilderSortRules(builder);
+
+	memset(&arena, 0, sizeof(iuliia_arena_t));
+	memset(&measured_scheme, 0, sizeof(iuliia_scheme_t));
+	iuliiaIntArenaAlloc(&arena, sizeof(iuliia_scheme_t), &overflow);
+	if(!iuliiaIntBuilderLayout(builder, &arena, &measured_scheme) || overflow) return 0;
+
+	arena.size = arena.offset;
+	arena.offset = 0;
+	arena.base = malloc(arena.size);
+	if(!arena.base) return 0;
+
+	scheme = iuliiaIntArenaAlloc(&arena, sizeof(iuliia_scheme_t), &overflow);
+	memset(scheme, 0, sizeof(iuliia_scheme_t));
+	scheme->arena = arena.base;
+	if(!iuliiaIntBuilderLayout(builder, &arena, scheme) || overflow) {
+		free(arena.base);
+
+		return 0;
+	}
+
+	iuliiaPrepareScheme(scheme);
+
+	return scheme;
+}
+
+iuliia_builder_t *iuliiaCreateBuilder(void)
+{
+	iuliia_builder_t *builder;
+
+	builder = malloc(sizeof(iuliia_builder_t));
+	if(!builder) return 0;
+
+	iuliiaIntBuilderInit(builder);
+
+	return builder;
+}
+
+void iuliiaFreeBuilder(iuliia_builder_t *builder)
+{
+	if(!builder) return;
+
+	iuliiaIntBuilderDestroy(builder);
+
+	free(builder);
+}
+
+void iuliiaResetBuilder(iuliia_builder_t *builder)
+{
+	size_t i;
+
+	for(i = 0; i < IULIIA_NOF_TABLES; i++) {
+		builder->tables[i].nof_rules = 0;
+		builder->tables[i].present = false;
+	}
+
+	builder->nof_patterns = 0;
+	builder->pool_len = 0;
+	builder->name = IULIIA_NO_STRING;
+	builder->description = IULIIA_NO_STRING;
+	builder->url = IULIIA_NO_STRING;
+	builder->nof_samples = 0;
+	builder->samples_present = false;
+}
+
+int iuliiaBuilderAddRule(iuliia_builder_t *builder, int table, uint32_t c, uint32_t cor_c, const uint32_t *repl)
+{
+	size_t repl_offset;
+
+	if(table < 0 || table >= IULIIA_NOF_TABLES) return 0;
+	if(table == IULIIA_TABLE_MAPPING) cor_c = 0;
+
+	repl_offset = builder->pool_len;
+	while(*repl) {
+		if(!iuliiaIntBuilderPutChar(builder, *repl)) goto IULIIA_ERROR;
+		repl++;
+	}
+	if(!iuliiaIntBuilderPutChar(builder, 0)) goto IULIIA_ERROR;
+
+	if(!iuliiaIntBuilderAddRule(builder, table, c, cor_c, repl_offset)) goto IULIIA_ERROR;
+
+	return 1;
+
+IULIIA_ERROR:
+
+	builder->pool_len = repl_offset;
+
+	return 0;
+}
+
+int iuliiaBuilderAddRuleU8(iuliia_builder_t *builder, int table, uint32_t c, uint32_t cor_c, const char *repl)
+{
+	const uint8_t *u8;
+	size_t repl_offset;
+
+	if(table < 0 || table >= IULIIA_NOF_TABLES) return 0;
+	if(table == IULIIA_TABLE_MAPPING) cor_c = 0;
+
+	repl_offset = builder->pool_len;
+	u8 = (const uint8_t *)repl;
+	while(*u8) {
+		uint32_t repl_c;
+
+		u8 = iuliiaCharU8toU32(u8, &repl_c);
+		if(!u8) goto IULIIA_ERROR;
+
+		if(!iuliiaIntBuilderPutChar(builder, repl_c)) goto IULIIA_ERROR;
+	}
+	if(!iuliiaIntBuilderPutChar(builder, 0)) goto IULIIA_ERROR;
+
+	if(!iuliiaIntBuilderAddRule(builder, table, c, cor_c, repl_offset)) goto IULIIA_ERROR;
+
+	return 1;
+
+IULIIA_ERROR:
+
+	builder->pool_len = repl_offset;
+
+	return 0;
+}
+
+int iuliiaBuilderAddPattern(iuliia_builder_t *builder, const uint32_t *pattern, unsigned int flags, const uint32_t *repl)
+{
+	size_t pattern_offset, repl_offset, len;
+
+	pattern_offset = builder->pool_len;
+	for(len = 0; pattern[len]; len++) {
+		if(len == IULIIA_MAX_PATTERN_LENGTH) goto IULIIA_ERROR;
+		if(!iuliiaIntBuilderPutChar(builder, iuliiaU32ToLower(pattern[len]))) goto IULIIA_ERROR;
+	}
+	if(!len || !iuliiaIntBuilderPutChar(builder, 0)) goto IULIIA_ERROR;
+
+	repl_offset = builder->pool_len;
+	while(*repl) {
+		if(!iuliiaIntBuilderPutChar(builder, *repl)) goto IULIIA_ERROR;
+		repl++;
+	}
+	if(!iuliiaIntBuilderPutChar(builder, 0)) goto IULIIA_ERROR;
+
+	flags &= IULIIA_PATTERN_WORD_START | IULIIA_PATTERN_WORD_END;
+	if(!iuliiaIntBuilderAddPattern(builder, pattern_offset, flags, repl_offset)) goto IULIIA_ERROR;
+
+	return 1;
+
+IULIIA_ERROR:
+
+	builder->pool_len = pattern_offset;
+
+	return 0;
+}
+
+int iuliiaBuilderAddPatternU8(iuliia_builder_t *builder, const char *pattern, unsigned int flags, const char *repl)
+{
+	const uint8_t *u8;
+	size_t pattern_offset, repl_offset, len = 0;
+
+	pattern_offset = builder->pool_len;
+	u8 = (const uint8_t *)pattern;
+	while(*u8) {
+		uint32_t pattern_c;
+
+		if(len == IULIIA_MAX_PATTERN_LENGTH) goto IULIIA_ERROR;
+		u8 = iuliiaCharU8toU32(u8, &pattern_c);
+		if(!u8) goto IULIIA_ERROR;
+
+		if(!iuliiaIntBuilderPutChar(builder, iuliiaU32ToLower(pattern_c))) goto IULIIA_ERROR;
+		len++;
+	}
+	if(!len || !iuliiaIntBuilderPutChar(builder, 0)) goto IULIIA_ERROR;
+
+	repl_offset = builder->pool_len;
+	u8 = (const uint8_t *)repl;
+	while(*u8) {
+		uint32_t repl_c;
+
+		u8 = iuliiaCharU8toU32(u8, &repl_c);
+		if(!u8) goto IULIIA_ERROR;
+
+		if(!iuliiaIntBuilderPutChar(builder, repl_c)) goto IULIIA_ERROR;
+	}
+	if(!iuliiaIntBuilderPutChar(builder, 0)) goto IULIIA_ERROR;
+
+	flags &= IULIIA_PATTERN_WORD_START | IULIIA_PATTERN_WORD_END;
+	if(!iuliiaIntBuilderAddPattern(builder, pattern_offset, flags, repl_offset)) goto IULIIA_ERROR;
+
+	return 1;
+
+IULIIA_ERROR:
+
+	builder->pool_len = pattern_offset;
+
+	return 0;
+}
+
+int iuliiaBuilderAddScheme(iuliia_builder_t *builder, const iuliia_scheme_t *scheme)
+{
+	size_t i;
+
+	// Rules of overlay are added after rules of its base to replace them
+	if(scheme->base && !iuliiaBuilderAddScheme(builder, scheme->base)) return 0;
+
+	builder->tables[IULIIA_TABLE_MAPPING].present = true;
+
+	for(i = 0; i < scheme->nof_mapping; i++)
+		if(!iuliiaBuilderAddRule(builder, IULIIA_TABLE_MAPPING, scheme->mapping[i].c, 0, scheme->mapping[i].repl)) return 0;
+
+	for(i = 0; i < scheme->nof_prev_mapping; i++)
+		if(!iuliiaBuilderAddRule(builder, IULIIA_TABLE_PREV, scheme->prev_mapping[i].c, scheme->prev_mapping[i].cor_c, scheme->prev_mapping[i].repl)) return 0;
+
+	for(i = 0; i < scheme->nof_next_mapping; i++)
+		if(!iuliiaBuilderAddRule(builder, IULIIA_TABLE_NEXT, scheme->next_mapping[i].c, scheme->next_mapping[i].cor_c, scheme->next_mapping[i].repl)) return 0;
+
+	for(i = 0; i < scheme->nof_ending_mapping; i++)
+		if(!iuliiaBuilderAddRule(builder, IULIIA_TABLE_ENDING, scheme->ending_mapping[i].c, scheme->ending_mapping[i].cor_c, scheme->ending_mapping[i].repl)) return 0;
+
+	for(i = 0; i < scheme->nof_pattern_mapping; i++)
+		if(!iuliiaBuilderAddPattern(builder, scheme->pattern_mapping[i].pattern, scheme->pattern_mapping[i].flags, scheme->pattern_mapping[i].repl)) return 0;
+
+	return 1;
+}
+
+iuliia_scheme_t *iuliiaBuilderMakeScheme(iuliia_builder_t *builder)
+{
+	// Scheme without mapping can't translate anything
+	builder->tables[IULIIA_TABLE_MAPPING].present = true;
+
+	return iuliiaIntBuilderFinish(builder);
+}
+
+iuliia_scheme_t *iuliiaBuilderMakeOverlay(iuliia_builder_t *builder, const iuliia_scheme_t *base)
+{
+	iuliia_scheme_t *scheme;
+
+	scheme = iuliiaBuilderMakeScheme(builder);
+	if(scheme) {
+		scheme->base = base;
+		iuliiaIntSelectEngine(scheme);
+	}
+
+	return scheme;
+}
+
+// Puts wide string to builder pool, pairs of surrogates are joined
+static bool iuliiaIntBuilderPutStringW(iuliia_builder_t *builder, const wchar_t *str, size_t *offset)
+{
+	*offset = builder->pool_len;
+
+	while(*str) {
+		uint32_t c;
+
+		c = (uint32_t)*str;
+		if(sizeof(wchar_t) < sizeof(uint32_t) && c >= 0xd800 && c < 0xdc00 && (uint32_t)str[1] >= 0xdc00 && (uint32_t)str[1] < 0xe000) {
+			c = 0x10000 + ((c - 0xd800) << 10) + ((uint32_t)str[1] - 0xdc00);
+			str++;
+		}
+		if(!iuliiaIntBuilderPutChar(builder, c)) return false;
+		str++;
+	}
+
+	return iuliiaIntBuilderPutChar(builder, 0);
+}
+
+struct iuliia_compiled_scheme_s {
+	iuliia_atomic_t refs;
+	iuliia_scheme_t *scheme;
+};
+
+// Makes compiled scheme, which owns prepared scheme. Rules are found by transducer or native code, if they can be made
+static iuliia_compiled_scheme_t *iuliiaIntWrapScheme(iuliia_scheme_t *scheme, unsigned int flags)
+{
+	iuliia_compiled_scheme_t *compiled;
+
+	compiled = malloc(sizeof(iuliia_compiled_scheme_t));
+	if(!compiled) return 0;
+
+	if(!(flags & IULIIA_COMPILE_NO_FST) && !scheme->fst) scheme->fst = iuliiaIntFstCompile(scheme);
+	if(!(flags & IULIIA_COMPILE_NO_JIT) && !scheme->jit) scheme->jit = iuliiaIntJitCompile(scheme);
+
+	compiled->refs = 1;
+	compiled->scheme = scheme;
+
+	return compiled;
+}
+
+// Adds rules of scheme and schemes it overlays, its metadata and samples to builder
+static bool iuliiaIntBuilderAddSchemeCopy(iuliia_builder_t *builder, const iuliia_scheme_t *scheme)
+{
+	size_t i;
+
+	if(!iuliiaBuilderAddScheme(builder, scheme)) return false;
+
+	if(scheme->name && !iuliiaIntBuilderPutStringW(builder, scheme->name, &(builder->name))) return false;
+	if(scheme->description && !iuliiaIntBuilderPutStringW(builder, scheme->description, &(builder->description))) return false;
+	if(scheme->url && !iuliiaIntBuilderPutStringW(builder, scheme->url, &(builder->url))) return false;
+
+	if(scheme->samples) {
+		builder->samples_present = true;
+		for(i = 0; i < scheme->nof_samples; i++) {
+			if(!iuliiaIntGrowArray((void **)&(builder->samples), &(builder->max_samples), builder->nof_samples, 2*sizeof(size_t))) return false;
+			if(!iuliiaIntBuilderPutStringW(builder, scheme->samples[i].in, builder->samples+2*i)) return false;
+			if(!iuliiaIntBuilderPutStringW(builder, scheme->samples[i].out, builder->samples+2*i+1)) return false;
+			builder->nof_samples++;
+		}
+	}
+
+	return true;
+}
+
+iuliia_compiled_scheme_t *iuliiaCompileScheme(const iuliia_scheme_t *scheme)
+{
+	return iuliiaCompileSchemeEx(scheme, 0);
+}
+
+iuliia_compiled_scheme_t *iuliiaCompileSchemeEx(const iuliia_scheme_t *scheme, unsigned int flags)
+{
+	iuliia_compiled_scheme_t *compiled;
+	iuliia_scheme_t *copy = 0;
+	iuliia_builder_t builder;
+
+	iuliiaIntBuilderInit(&builder);
+
+	if(!iuliiaIntBuilderAddSchemeCopy(&builder, scheme)) goto IULIIA_ERROR;
+
+	copy = iuliiaBuilderMakeScheme(&builder);
+	if(!copy) goto IULIIA_ERROR;
+
+	compiled = iuliiaIntWrapScheme(copy, flags);
+	if(!compiled) goto IULIIA_ERROR;
+
+	iuliiaIntBuilderDestroy(&builder);
+
+	return compiled;
+
+IULIIA_ERROR:
+
+	iuliiaFreeScheme(copy);
+	iuliiaIntBuilderDestroy(&builder);
+
+	return 0;
+}
+
+iuliia_compiled_scheme_t *iuliiaRetainScheme(iuliia_compiled_scheme_t *compiled)
+{
+	iuliiaIntAtomicAdd(&(compiled->refs), 1);
+
+	return compiled;
+}
+
+void iuliiaReleaseScheme(iuliia_compiled_scheme_t *compiled)
+{
+	if(!compiled) return;
+
+	if(iuliiaIntAtomicAdd(&(compiled->refs), -1) == 0) {
+		iuliiaFreeScheme(compiled->scheme);
+		free(compiled);
+	}
+}
+
+const iuliia_scheme_t *iuliiaCompiledSchemeGet(const iuliia_compiled_scheme_t *compiled)
+{
+	return compiled->scheme;
+}
+
+#define IULIIA_JSON_MAX_DEPTH 256
+
+typedef struct {
+	const uint8_t *p;
+	const uint8_t *end;
+	unsigned int depth;
+} iuliia_json_reader_t;
+
+static void iuliiaIntJsonSkipSpace(iuliia_json_reader_t *reader)
+{
+	while(reader->p < reader->end
+		&& (*reader->p == ' ' || *reader->p == '\t' || *reader->p == '\n' || *reader->p == '\r'))
+		reader->p++;
+}
+
+// Skips whitespaces and checks next character
+static bool iuliiaIntJsonPeek(iuliia_json_reader_t *reader, uint8_t c)
+{
+	iuliiaIntJsonSkipSpace(reader);
+
+	return reader->p < reader->end && *reader->p == c;
+}
+
+static bool iuliiaIntJsonExpect(iuliia_json_reader_t *reader, uint8_t c)
+{
+	if(!iuliiaIntJsonPeek(reader, c)) return false;
+
+	reader->p++;
+
+	return true;
+}
+
+static bool iuliiaIntJsonExpectLiteral(iuliia_json_reader_t *reader, const char *literal)
+{
+	size_t len;
+
+	len = strlen(literal);
+	iuliiaIntJsonSkipSpace(reader);
+	if((size_t)(reader->end-reader->p) < len || memcmp(reader->p, literal, len)) return false;
+
+	reader->p += len;
+
+	return true;
+}
+
+static bool iuliiaIntJsonReadHex4(iuliia_json_reader_t *reader, uint32_t *c)
+{
+	int i;
+
+	if(reader->end-reader->p < 4) return false;
+
+	*c = 0;
+	for(i = 0; i < 4; i++) {
+		uint8_t h = *(reader->p++);
+
+		*c <<= 4;
+		if(h >= '0' && h <= '9') *c += h - '0';
+		else if(h >= 'a' && h <= 'f') *c += h - 'a' + 10;
+		else if(h >= 'A' && h <= 'F') *c += h - 'A' + 10;
+		else return false;
+	}
+
+	return true;
+}
+
+// Reads json string. Decoded characters are put to builder pool,
+// if builder is not null, otherwise string is only validated
+static bool iuliiaIntJsonReadString(iuliia_json_reader_t *reader, iuliia_builder_t *builder, size_t *str)
+{
+	if(!iuliiaIntJsonExpect(reader, '"')) return false;
+
+	if(builder) *str = builder->pool_len;
+
+	while(1) {
+		uint32_t c;
+
+		if(reader->p == reader->end) return false;
+
+		if(*reader->p == '"') {
+			reader->p++;
+
+			break;
+		} else if(*reader->p < 0x20) {
+			return false;
+		} else if(*reader->p == '\\') {
+			reader->p++;
+			if(reader->p == reader->end) return false;
+
+			switch(*(reader->p++)) {
+				case '"': c = '"'; break;
+				case '\\': c = '\\'; break;
+				case '/': c = '/'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'u':
+					if(!iuliiaIntJsonReadHex4(reader, &c)) return false;
+					if(c >= 0xd800 && c <= 0xdbff) {
+						uint32_t low_c;
+
+						if(reader->end-reader->p < 2 || reader->p[0] != '\\' || reader->p[1] != 'u') return false;
+						reader->p += 2;
+						if(!iuliiaIntJsonReadHex4(reader, &low_c)) return false;
+						if(low_c < 0xdc00 || low_c > 0xdfff) return false;
+
+						c = ((c & 0x3ff) << 10) + (low_c & 0x3ff) + 0x10000;
+					} else if(c >= 0xdc00 && c <= 0xdfff)
+						return false;
+					break;
+				default:
+					return false;
+			}
+		} else if(*reader->p < 0x80) {
+			c = *(reader->p++);
+		} else {
+			const uint8_t *next;
+			size_t len;
+
+			if((*reader->p & 0xe0) == 0xc0) len = 2;
+			else if((*reader->p & 0xf0) == 0xe0) len = 3;
+			else if((*reader->p & 0xf8) == 0xf0) len = 4;
+			else return false;
+			if((size_t)(reader->end-reader->p) < len) return false;
+
+			next = iuliiaCharU8toU32(reader->p, &c);
+			if(!next) return false;
+			reader->p = next;
+		}
+
+		if(builder && !iuliiaIntBuilderPutChar(builder, c)) return false;
+	}
+
+	if(builder && !iuliiaIntBuilderPutChar(builder, 0)) return false;
+
+	return true;
+}
+
+static bool iuliiaIntJsonSkipValue(iuliia_json_reader_t *reader)
+{
+	iuliiaIntJsonSkipSpace(reader);
+	if(reader->p == reader->end) return false;
+
+	if(*reader->p == '"') {
+		return iuliiaIntJsonReadString(reader, 0, 0);
+	} else if(*reader->p == '{' || *reader->p == '[') {
+		uint8_t close_c;
+		bool is_object;
+
+		is_object = *reader->p == '{';
+		close_c = is_object ? '}' : ']';
+		reader->p++;
+
+		if(reader->depth == IULIIA_JSON_MAX_DEPTH) return false;
+		reader->depth++;
+
+		if(iuliiaIntJsonExpect(reader, close_c)) {
+			reader->depth--;
+
+			return true;
+		}
+
+		do {
+			if(is_object) {
+				if(!iuliiaIntJsonReadString(reader, 0, 0)) return false;
+				if(!iuliiaIntJsonExpect(reader, ':')) return false;
+			}
+			if(!iuliiaIntJsonSkipValue(reader)) return false;
+		} while(iuliiaIntJsonExpect(reader, ','));
+
+		reader->depth--;
+
+		return iuliiaIntJsonExpect(reader, close_c);
+	} else if(*reader->p == 't') {
+		return iuliiaIntJsonExpectLiteral(reader, "true");
+	} else if(*reader->p == 'f') {
+		return iuliiaIntJsonExpectLiteral(reader, "false");
+	} else if(*reader->p == 'n') {
+		return iuliiaIntJsonExpectLiteral(reader, "null");
+	} else {
+		const uint8_t *start;
+
+		if(*reader->p == '-') reader->p++;
+
+		start = reader->p;
+		while(reader->p < reader->end && *reader->p >= '0' && *reader->p <= '9') reader->p++;
+		if(reader->p == start || (*start == '0' && reader->p-start > 1)) return false;
+
+		if(reader->p < reader->end && *reader->p == '.') {
+			reader->p++;
+			start = reader->p;
+			while(reader->p < reader->end && *reader->p >= '0' && *reader->p <= '9') reader->p++;
+			if(reader->p == start) return false;
+		}
+
+		if(reader->p < reader->end && (*reader->p == 'e' || *reader->p == 'E')) {
+			reader->p++;
+			if(reader->p < reader->end && (*reader->p == '+' || *reader->p == '-')) reader->p++;
+			start = reader->p;
+			while(reader->p < reader->end && *reader->p >= '0' && *reader->p <= '9') reader->p++;
+			if(reader->p == start) return false;
+		}
+
+		return true;
+	}
+}
+
+// Reads json string with characters of rule, puts its first characters to c and cor_c
+static bool iuliiaIntJsonReadRuleKey(iuliia_json_reader_t *reader, iuliia_builder_t *builder, int table, uint32_t *c, uint32_t *cor_c)
+{
+	size_t key, key_len;
+	const uint32_t *s;
+
+	if(!iuliiaIntJsonReadString(reader, builder, &key)) return false;
+
+	s = builder->pool + key;
+	key_len = builder->pool_len - key - 1;
+
+	*c = s[0];
+	*cor_c = 0;
+	if(table != IULIIA_TABLE_MAPPING) {
+		if(key_len == 0 || key_len > 2) return false;
+
+		if(key_len == 2) {
+			if(table == IULIIA_TABLE_PREV) {
+				*cor_c = s[0];
+				*c = s[1];
+			} else
+				*cor_c = s[1];
+		}
+	}
+
+	builder->pool_len = key;
+
+	return true;
+}
+
+static bool iuliiaIntJsonReadMapping(iuliia_json_reader_t *reader, iuliia_builder_t *builder, int table)
+{
+	iuliia_builder_table_t *t;
+
+	if(iuliiaIntJsonPeek(reader, 'n')) return iuliiaIntJsonExpectLiteral(reader, "null");
+
+	if(!iuliiaIntJsonExpect(reader, '{')) return false;
+
+	// Repeated key replaces mapping
+	t = builder->tables + table;
+	t->nof_rules = 0;
+	t->present = true;
+
+	if(iuliiaIntJsonExpect(reader, '}')) return true;
+
+	do {
+		uint32_t c, cor_c;
+		size_t repl;
+
+		if(!iuliiaIntJsonReadRuleKey(reader, builder, table, &c, &cor_c)) return false;
+		if(!iuliiaIntJsonExpect(reader, ':')) return false;
+		if(!iuliiaIntJsonReadString(reader, builder, &repl)) return false;
+		if(!iuliiaIntBuilderAddRule(builder, table, c, cor_c, repl)) return false;
+	} while(iuliiaIntJsonExpect(reader, ','));
+
+	return iuliiaIntJsonExpect(reader, '}');
+}
+
+static bool iuliiaIntJsonReadMappingPatternStream(iuliia_json_reader_t *reader, iuliia_builder_t *builder)
+{
+	if(iuliiaIntJsonPeek(reader, 'n')) return iuliiaIntJsonExpectLiteral(reader, "null");
+
+	if(!iuliiaIntJsonExpect(reader, '{')) return false;
+
+	// Repeated key replaces mapping
+	builder->nof_patterns = 0;
+
+	if(iuliiaIntJsonExpect(reader, '}')) return true;
+
+	do {
+		size_t key, key_len, repl;
+		unsigned int flags;
+
+		if(!iuliiaIntJsonReadString(reader, builder, &key)) return false;
+		key_len = builder->pool_len - key - 1;
+		if(!iuliiaIntPatternFromKey(builder->pool + key, &key_len, &flags)) return false;
+		builder->pool_len = key + key_len + 1;
+
+		if(!iuliiaIntJsonExpect(reader, ':')) return false;
+		if(!iuliiaIntJsonReadString(reader, builder, &repl)) return false;
+		if(!iuliiaIntBuilderAddPattern(builder, key, flags, repl)) return false;
+	} while(iuliiaIntJsonExpect(reader, ','));
+
+	return iuliiaIntJsonExpect(reader, '}');
+}
+
+static bool iuliiaIntJsonReadSamplesStream(iuliia_json_reader_t *reader, iuliia_builder_t *builder)
+{
+	if(iuliiaIntJsonPeek(reader, 'n')) return iuliiaIntJsonExpectLiteral(reader, "null");
+
+	if(!iuliiaIntJsonExpect(reader, '[')) return false;
+
+	builder->nof_samples = 0;
+	builder->samples_present = true;
+
+	if(iuliiaIntJsonExpect(reader, ']')) return true;
+
+	do {
+		if(!iuliiaIntGrowArray((void **)&(builder->samples), &(builder->max_samples), builder->nof_samples, 2*sizeof(size_t))) return false;
+
+		if(!iuliiaIntJsonExpect(reader, '[')) return false;
+		if(!iuliiaIntJsonReadString(reader, builder, builder->samples + 2*builder->nof_samples)) return false;
+		if(!iuliiaIntJsonExpect(reader, ',')) return false;
+		if(!iuliiaIntJsonReadString(reader, builder, builder->samples + 2*builder->nof_samples + 1)) return false;
+		if(!iuliiaIntJsonExpect(reader, ']')) return false;
+
+		builder->nof_samples++;
+	} while(iuliiaIntJsonExpect(reader, ','));
+
+	return iuliiaIntJsonExpect(reader, ']');
+}
+
+#define IULIIA_KEY_UNKNOWN 0
+#define IULIIA_KEY_NAME 1
+#define IULIIA_KEY_DESCRIPTION 2
+#define IULIIA_KEY_URL 3
+#define IULIIA_KEY_MAPPING 4
+#define IULIIA_KEY_PREV_MAPPING 5
+#define IULIIA_KEY_NEXT_MAPPING 6
+#define IULIIA_KEY_ENDING_MAPPING 7
+#define IULIIA_KEY_SAMPLES 8
+#define IULIIA_KEY_PATTERN_MAPPING 9
+
+static const char *iuliia_scheme_keys[] = {
+	"name", "description", "url", "mapping", "prev_mapping", "next_mapping", "ending_mapping", "samples", "pattern_mapping"
+};
+
+// Finds which scheme field is named by string in builder pool
+static int iuliiaIntBuilderFindKey(const iuliia_builder_t *builder, size_t str)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(iuliia_scheme_keys)/sizeof(const char *); i++) {
+		const uint32_t *s;
+		const char *key;
+
+		s = builder->pool + str;
+		key = iuliia_scheme_keys[i];
+		while(*key && *s == (uint8_t)(*key)) {
+			s++;
+			key++;
+		}
+
+		if(!(*key) && !(*s)) return (int)i + 1;
+	}
+
+	return IULIIA_KEY_UNKNOWN;
+}
+
+static bool iuliiaIntJsonStreamScheme(iuliia_json_reader_t *reader, iuliia_builder_t *builder, unsigned int flags)
+{
+	if(!iuliiaIntJsonExpect(reader, '{')) return false;
+
+	if(!iuliiaIntJsonExpect(reader, '}')) {
+		do {
+			size_t key;
+			int key_id;
+			bool is_ok;
+
+			if(!iuliiaIntJsonReadString(reader, builder, &key)) return false;
+			if(!iuliiaIntJsonExpect(reader, ':')) return false;
+
+			key_id = iuliiaIntBuilderFindKey(builder, key);
+			builder->pool_len = key;
+
+			if((flags & IULIIA_LOAD_SKIP_METADATA) && key_id >= IULIIA_KEY_NAME && key_id <= IULIIA_KEY_URL) key_id = IULIIA_KEY_UNKNOWN;
+			if((flags & IULIIA_LOAD_SKIP_SAMPLES) && key_id == IULIIA_KEY_SAMPLES) key_id = IULIIA_KEY_UNKNOWN;
+
+			switch(key_id) {
+				case IULIIA_KEY_NAME:
+					is_ok = iuliiaIntJsonReadString(reader, builder, &(builder->name));
+					break;
+				case IULIIA_KEY_DESCRIPTION:
+					is_ok = iuliiaIntJsonReadString(reader, builder, &(builder->description));
+					break;
+				case IULIIA_KEY_URL:
+					is_ok = iuliiaIntJsonReadString(reader, builder, &(builder->url));
+					break;
+				case IULIIA_KEY_MAPPING:
+					is_ok = iuliiaIntJsonReadMapping(reader, builder, IULIIA_TABLE_MAPPING);
+					break;
+				case IULIIA_KEY_PREV_MAPPING:
+					is_ok = iuliiaIntJsonReadMapping(reader, builder, IULIIA_TABLE_PREV);
+					break;
+				case IULIIA_KEY_NEXT_MAPPING:
+					is_ok = iuliiaIntJsonReadMapping(reader, builder, IULIIA_TABLE_NEXT);
+					break;
+				case IULIIA_KEY_ENDING_MAPPING:
+					is_ok = iuliiaIntJsonReadMapping(reader, builder, IULIIA_TABLE_ENDING);
+					break;
+				case IULIIA_KEY_SAMPLES:
+					is_ok = iuliiaIntJsonReadSamplesStream(reader, builder);
+					break;
+				case IULIIA_KEY_PATTERN_MAPPING:
+					is_ok = iuliiaIntJsonReadMappingPatternStream(reader, builder);
+					break;
+				default:
+					is_ok = iuliiaIntJsonSkipValue(reader);
+			}
+
+			if(!is_ok) return false;
+		} while(iuliiaIntJsonExpect(reader, ','));
+
+		if(!iuliiaIntJsonExpect(reader, '}')) return false;
+	}
+
+	iuliiaIntJsonSkipSpace(reader);
+
+	return reader->p == reader->end;
+}
+
+// Loads scheme with streaming parser, which puts rules directly to builder tables
+static iuliia_scheme_t *iuliiaIntLoadSchemeFromJsonStream(const char *json, size_t json_length, unsigned int flags)
+{
+	iuliia_builder_t builder;
+	iuliia_json_reader_t reader;
+	iuliia_scheme_t *scheme = 0;
+
+	iuliiaIntBuilderInit(&builder);
+
+	reader.p = (const uint8_t *)json;
+	reader.end = reader.p + json_length;
+	reader.depth = 0;
+
+	if(!iuliiaIntJsonStreamScheme(&reader, &builder, flags)) goto FINAL;
+
+	if(!builder.tables[IULIIA_TABLE_MAPPING].present) goto FINAL;
+	if(!(flags & IULIIA_LOAD_SKIP_METADATA)
+		&& (builder.name == IULIIA_NO_STRING || builder.description == IULIIA_NO_STRING || builder.url == IULIIA_NO_STRING)) goto FINAL;
+	if(!(flags & IULIIA_LOAD_SKIP_SAMPLES) && !builder.samples_present) goto FINAL;
+
+	scheme = iuliiaIntBuilderFinish(&builder);
+
+FINAL:
+	iuliiaIntBuilderDestroy(&builder);
+
+	return scheme;
+}
+
+// Loads scheme with json.h parser using scratch arena for DOM
+static iuliia_scheme_t *iuliiaIntLoadSchemeFromJsonDom(const char *json, size_t json_length, unsigned int flags, iuliia_arena_t *scratch)
+{
+	iuliia_scheme_t *scheme, measured_scheme;
+	iuliia_arena_t arena;
+	struct json_value_s *root;
+	struct json_object_s *object;
+	bool overflow = false;
+
+	scratch->offset = 0;
+	root = json_parse_ex(json, json_length, json_parse_flags_default, iuliiaIntJsonAlloc, scratch, 0);
+	if(!root) return 0;
+
+	object = json_value_as_object(root);
+	if(!object) goto IULIIA_ERROR;
+
+	// Measure scheme
+	memset(&arena, 0, sizeof(iuliia_arena_t));
+	memset(&measured_scheme, 0, sizeof(iuliia_scheme_t));
+	iuliiaIntArenaAlloc(&arena, sizeof(iuliia_scheme_t), &overflow);
+	if(!iuliiaIntJsonReadScheme(object, &arena, &measured_scheme, flags) || overflow) goto IULIIA_ERROR;
+
+	// Fill scheme
+	arena.size = arena.offset;
+	arena.offset = 0;
+	arena.base = malloc(arena.size);
+	if(!arena.base) goto IULIIA_ERROR;
+
+	scheme = iuliiaIntArenaAlloc(&arena, sizeof(iuliia_scheme_t), &overflow);
+	memset(scheme, 0, sizeof(iuliia_scheme_t));
+	scheme->arena = arena.base;
+	if(!iuliiaIntJsonReadScheme(object, &arena, scheme, flags) || overflow) {
+		free(arena.base);
+
+		goto IULIIA_ERROR;
+	}
+
+	scratch->offset = 0;
+
+	if(!scheme->mapping
+		|| (!(flags & IULIIA_LOAD_SKIP_METADATA) && (!scheme->name || !scheme->description || !scheme->url))
+		|| (!(flags & IULIIA_LOAD_SKIP_SAMPLES) && !scheme->samples)) {
+		iuliiaFreeScheme(scheme);
+
+		return 0;
+	}
+
+	iuliiaPrepareScheme(scheme);
+
+	return scheme;
+
+IULIIA_ERROR:
+
+	scratch->offset = 0;
+
+	return 0;
+}
+
+static iuliia_scheme_t *iuliiaIntLoadSchemeFromMemory(const char *json, size_t json_length, unsigned int flags, iuliia_arena_t *scratch)
+{
+	if(flags & IULIIA_LOAD_JSON_DOM)
+		return iuliiaIntLoadSchemeFromJsonDom(json, json_length, flags, scratch);
+	else
+		return iuliiaIntLoadSchemeFromJsonStream(json, json_length, flags);
+}
+
+iuliia_scheme_t *iuliiaLoadSchemeFromMemoryEx(char *json, size_t json_length, unsigned int flags)
+{
+	iuliia_arena_t scratch;
+	iuliia_scheme_t *scheme;
+
+	memset(&scratch, 0, sizeof(iuliia_arena_t));
+
+	scheme = iuliiaIntLoadSchemeFromMemory(json, json_length, flags, &scratch);
+
+	free(scratch.base);
+
+	return scheme;
+}
+
+iuliia_scheme_t *iuliiaLoadSchemeFromMemory(char *json, size_t json_length)
+{
+	return iuliiaLoadSchemeFromMemoryEx(json, json_length, 0);
+}
+
+void iuliiaFreeScheme(iuliia_scheme_t *scheme)
+{
+	if(!scheme) return;
+
+	if(scheme->jit) iuliiaIntJitFree(scheme->jit);
+	if(scheme->fst) iuliiaIntFstFree(scheme->fst);
+
+	// Loaded scheme is a single block of memory
+	if(scheme->arena) {
+		free(scheme->arena);
+
+		return;
+	}
+
+	if(scheme->name) free(scheme->name);
+	if(scheme->description) free(scheme->description);
+	if(scheme->url) free(scheme->url);
+
+	if(scheme->nof_mapping) {
+		size_t i;
+
+		for(i = 0; i < scheme->nof_mapping; i++) {
+			if(scheme->mapping[i].repl) free(scheme->mapping[i].repl);
+		}
+
+		free(scheme->mapping);
+	}
+
+	if(scheme->nof_prev_mapping) {
+		size_t i;
+
+		for(i = 0; i < scheme->nof_prev_mapping; i++) {
+			if(scheme->prev_mapping[i].repl) free(scheme->prev_mapping[i].repl);
+		}
+
+		free(scheme->prev_mapping);
+	}
+
+	if(scheme->nof_next_mapping) {
+		size_t i;
+
+		for(i = 0; i < scheme->nof_next_mapping; i++) {
 			if(scheme->next_mapping[i].repl) free(scheme->next_mapping[i].repl);
 		}
 
-		free(scheme->next_mapping);
+		free(scheme->next_mapping);
+	}
+
+	if(scheme->nof_ending_mapping) {
+		size_t i;
+
+		for(i = 0; i < scheme->nof_ending_mapping; i++) {
+			if(scheme->ending_mapping[i].repl) free(scheme->ending_mapping[i].repl);
+		}
+
+		free(scheme->ending_mapping);
+	}
+
+	if(scheme->nof_pattern_mapping) {
+		size_t i;
+
+		for(i = 0; i < scheme->nof_pattern_mapping; i++) {
+			if(scheme->pattern_mapping[i].pattern) free(scheme->pattern_mapping[i].pattern);
+			if(scheme->pattern_mapping[i].repl) free(scheme->pattern_mapping[i].repl);
+		}
+
+		free(scheme->pattern_mapping);
+	}
+	if(scheme->pattern_trie) free(scheme->pattern_trie);
+
+	if(scheme->nof_samples) {
+		size_t i;
+
+		for(i = 0; i < scheme->nof_samples; i++) {
+			free(scheme->samples[i].in);
+			free(scheme->samples[i].out);
+		}
+
+		free(scheme->samples);
+	}
+
+	free(scheme);
+}
+
+static int iuliiaCompare1char(const iuliia_mapping_1char_t *a, const iuliia_mapping_1char_t *b)
+{
+	return a->c - b->c;
+}
+
+static int iuliiaCompare2char(const iuliia_mapping_2char_t *a, const iuliia_mapping_2char_t *b)
+{
+	if(a->c != b->c)
+		return a->c - b->c;
+	else
+		return a->cor_c - b->cor_c;
+}
+
+static int iuliiaIntComparePatterns(const void *a, const void *b)
+{
+	const iuliia_mapping_pattern_t *pattern_a, *pattern_b;
+	const uint32_t *s_a, *s_b;
+
+	pattern_a = (const iuliia_mapping_pattern_t *)a;
+	pattern_b = (const iuliia_mapping_pattern_t *)b;
+
+	s_a = pattern_a->pattern;
+	s_b = pattern_b->pattern;
+	while(*s_a && *s_a == *s_b) {
+		s_a++;
+		s_b++;
+	}
+
+	if(*s_a != *s_b)
+		return *s_a < *s_b ? -1 : 1;
+	else if(pattern_a->flags != pattern_b->flags)
+		return pattern_a->flags < pattern_b->flags ? -1 : 1;
+	else if(pattern_a->repl != pattern_b->repl) // Replacements are laid out in order of adding patterns
+		return (uintptr_t)pattern_a->repl < (uintptr_t)pattern_b->repl ? -1 : 1;
+	else
+		return 0;
+}
+
+// Builds node of trie for sorted patterns [first, last), which have the same depth first characters.
+// Children are put to free nodes starting from nof_nodes. Returns number of used nodes
+static size_t iuliiaIntBuildPatternNode(iuliia_scheme_t *scheme, size_t node, size_t first, size_t last, size_t depth, size_t nof_nodes)
+{
+	const iuliia_mapping_pattern_t *patterns;
+	iuliia_pattern_node_t *trie;
+	size_t i, child;
+
+	patterns = scheme->pattern_mapping;
+	trie = scheme->pattern_trie;
+
+	// Patterns, which end here, go first. Of repeated patterns the last added one wins
+	memset(trie[node].patterns, 0, sizeof(trie[node].patterns));
+	for(; first < last && !patterns[first].pattern[depth]; first++)
+		trie[node].patterns[patterns[first].flags & (IULIIA_PATTERN_WORD_START | IULIIA_PATTERN_WORD_END)] = (uint32_t)first+1;
+
+	trie[node].first_child = (uint32_t)nof_nodes;
+	trie[node].nof_children = 0;
+	for(i = first; i < last; i++)
+		if(i == first || patterns[i].pattern[depth] != patterns[i-1].pattern[depth]) trie[node].nof_children++;
+
+	child = nof_nodes;
+	nof_nodes += trie[node].nof_children;
+	while(first < last) {
+		i = first;
+		while(i < last && patterns[i].pattern[depth] == patterns[first].pattern[depth]) i++;
+
+		trie[child].c = patterns[first].pattern[depth];
+		nof_nodes = iuliiaIntBuildPatternNode(scheme, child, first, i, depth+1, nof_nodes);
+
+		child++;
+		first = i;
+	}
+
+	return nof_nodes;
+}
+
+static void iuliiaIntBuildPatternTrie(iuliia_scheme_t *scheme)
+{
+	if(!scheme->pattern_trie) return;
+
+	if(scheme->pattern_mapping && scheme->nof_pattern_mapping) qsort(scheme->pattern_mapping, scheme->nof_pattern_mapping, sizeof(iuliia_mapping_pattern_t), iuliiaIntComparePatterns);
+
+	scheme->pattern_trie[0].c = 0;
+	iuliiaIntBuildPatternNode(scheme, 0, 0, scheme->pattern_mapping ? scheme->nof_pattern_mapping : 0, 0, 1);
+}
+
+typedef int (* iuliia_comparator_t)(const void*, const void*);
+
+void iuliiaInitScheme(iuliia_scheme_t *scheme)
+{
+	memset(scheme, 0, sizeof(iuliia_scheme_t));
+}
+
+void iuliiaPrepareScheme(iuliia_scheme_t *scheme)
+{
+	if(scheme->mapping && scheme->nof_mapping) qsort(scheme->mapping, scheme->nof_mapping, sizeof(iuliia_mapping_1char_t), (iuliia_comparator_t)iuliiaCompare1char);
+	if(scheme->prev_mapping && scheme->nof_prev_mapping) qsort(scheme->prev_mapping, scheme->nof_prev_mapping, sizeof(iuliia_mapping_2char_t), (iuliia_comparator_t)iuliiaCompare2char);
+	if(scheme->next_mapping && scheme->nof_next_mapping) qsort(scheme->next_mapping, scheme->nof_next_mapping, sizeof(iuliia_mapping_2char_t), (iuliia_comparator_t)iuliiaCompare2char);
+	if(scheme->ending_mapping && scheme->nof_ending_mapping) qsort(scheme->ending_mapping, scheme->nof_ending_mapping, sizeof(iuliia_mapping_2char_t), (iuliia_comparator_t)iuliiaCompare2char);
+	iuliiaIntBuildPatternTrie(scheme);
+
+	iuliiaIntSelectEngine(scheme);
+}
+
+// Maps whole file to memory for reading. Returns 0 if file can't be mapped
+static const char *iuliiaIntMapFile(FILE *f, size_t *size, void **mapping)
+{
+#if defined(_WIN32)
+	HANDLE file, file_mapping;
+	LARGE_INTEGER file_size;
+	const char *data;
+
+	file = (HANDLE)_get_osfhandle(_fileno(f));
+	if(file == INVALID_HANDLE_VALUE) return 0;
+
+	if(!GetFileSizeEx(file, &file_size)) return 0;
+	if(file_size.QuadPart <= 0 || (unsigned long long)file_size.QuadPart >= SIZE_MAX) return 0;
+
+	file_mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	if(!file_mapping) return 0;
+
+	data = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!data) {
+		CloseHandle(file_mapping);
+
+		return 0;
+	}
+
+	*size = (size_t)file_size.QuadPart;
+	*mapping = file_mapping;
+
+	return data;
+#else
+	struct stat st;
+	void *data;
+
+	if(fstat(fileno(f), &st)) return 0;
+	if(!S_ISREG(st.st_mode) || st.st_size <= 0 || (unsigned long long)st.st_size >= SIZE_MAX) return 0;
+
+	data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+	if(data == MAP_FAILED) return 0;
+
+	*size = (size_t)st.st_size;
+	*mapping = 0;
+
+	return data;
+#endif
+}
+
+static void iuliiaIntUnmapFile(const char *data, size_t size, void *mapping)
+{
+#if defined(_WIN32)
+	(void)size; // View is unmapped whole
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping);
+#else
+	(void)mapping; // POSIX mapping has no handle
+	munmap((void *)data, size);
+#endif
+}
+
+// Mapped file, which is truncated by other process while it is parsed, raises SIGBUS on POSIX or
+// exception on Windows. So files, which are rewritten while program runs, are read instead of mapping
+static iuliia_scheme_t *iuliiaIntLoadSchemeFromFile(FILE *f, unsigned int flags, bool is_mappable, iuliia_arena_t *scratch)
+{
+	char *json;
+	const char *mapped_json;
+	size_t json_length;
+	long long f_size;
+	void *mapping;
+	iuliia_scheme_t *scheme;
+
+	if(!f) return 0;
+
+	mapped_json = is_mappable ? iuliiaIntMapFile(f, &json_length, &mapping) : 0;
+	if(mapped_json) {
+		scheme = iuliiaIntLoadSchemeFromMemory(mapped_json, json_length, flags, scratch);
+
+		iuliiaIntUnmapFile(mapped_json, json_length, mapping);
+
+		return scheme;
+	}
+
+	// Fall back to reading file
+	if(fseek(f, 0, SEEK_END)) return 0;
+
+#if defined(_WIN32)
+	f_size = _ftelli64(f);
+#else
+	f_size = ftello64(f);
+#endif
+	if(f_size < 0 || (unsigned long long)f_size >= SIZE_MAX) return 0;
+
+	json_length = (size_t)f_size;
+
+	if(fseek(f, 0, SEEK_SET)) return 0;
+
+	json = malloc(json_length+1);
+	if(!json) return 0;
+	json[json_length] = 0;
+
+	if(fread(json, 1, json_length, f) != json_length) {
+		free(json);
+
+		return 0;
+	}
+
+	scheme = iuliiaIntLoadSchemeFromMemory(json, json_length, flags, scratch);
+
+	free(json);
+
+	return scheme;
+}
+
+iuliia_scheme_t *iuliiaLoadSchemeFromFileEx(FILE *f, unsigned int flags)
+{
+	iuliia_arena_t scratch;
+	iuliia_scheme_t *scheme;
+
+	memset(&scratch, 0, sizeof(iuliia_arena_t));
+
+	scheme = iuliiaIntLoadSchemeFromFile(f, flags, true, &scratch);
+
+	free(scratch.base);
+
+	return scheme;
+}
+
+iuliia_scheme_t *iuliiaLoadSchemeFromFile(FILE *f)
+{
+	return iuliiaLoadSchemeFromFileEx(f, 0);
+}
+
+#if !defined(_WIN32)
+static FILE *_wfopen(const wchar_t *filename, const wchar_t *mode)
+{
+	size_t filename_len, mode_len;
+	char *cfilename = 0, *cmode = 0;
+	FILE *f = 0;
+
+	filename_len = wcslen(filename);
+	mode_len = wcslen(mode);
+
+	if(SIZE_MAX/MB_CUR_MAX <= filename_len || SIZE_MAX/MB_CUR_MAX <= mode_len) {
+		errno = ENAMETOOLONG;
+		return 0;
+	}
+
+	cfilename = malloc(filename_len * MB_CUR_MAX + 1);
+	cmode = malloc(mode_len * MB_CUR_MAX + 1);
+	if(!cfilename || !cmode) {
+		errno = ENOMEM;
+		goto FINAL;
+	}
+
+	if(wcstombs(cfilename, filename, filename_len * MB_CUR_MAX + 1) == (size_t)(-1)) {
+		errno = EINVAL;
+		goto FINAL;
+	}
+
+	if(wcstombs(cmode, mode, mode_len * MB_CUR_MAX + 1) == (size_t)(-1)) {
+		errno = EINVAL;
+		goto FINAL;
+	}
+
+	f = fopen(cfilename, cmode);
+
+FINAL:
+	if(cfilename) free(cfilename);
+	if(cmode) free(cmode);
+
+	return f;
+}
+#endif
+
+iuliia_scheme_t *iuliiaLoadSchemeExW(const wchar_t *filename, unsigned int flags)
+{
+	FILE *f;
+	iuliia_scheme_t *scheme;
+
+	f = _wfopen(filename, L"rb");
+	if(!f) return 0;
+
+	scheme = iuliiaLoadSchemeFromFileEx(f, flags);
+
+	fclose(f);
+
+	return scheme;
+}
+
+iuliia_scheme_t *iuliiaLoadSchemeExA(const char *filename, unsigned int flags)
+{
+	FILE *f;
+	iuliia_scheme_t *scheme;
+
+	f = fopen(filename, "rb");
+	if(!f) return 0;
+
+	scheme = iuliiaLoadSchemeFromFileEx(f, flags);
+
+	fclose(f);
+
+	return scheme;
+}
+
+iuliia_scheme_t *iuliiaLoadSchemeW(const wchar_t *filename)
+{
+	return iuliiaLoadSchemeExW(filename, 0);
+}
+
+iuliia_scheme_t *iuliiaLoadSchemeA(const char *filename)
+{
+	return iuliiaLoadSchemeExA(filename, 0);
+}
+
+#if defined(_WIN32)
+#define IULIIA_DIR_SEPARATOR L'\\'
+typedef wchar_t iuliia_path_char_t;
+#else
+#define IULIIA_DIR_SEPARATOR '/'
+typedef char iuliia_path_char_t;
+#endif
+
+typedef struct {
+	iuliia_scheme_dir_t *dir;
+	iuliia_path_char_t **paths;
+	unsigned int flags;
+	iuliia_atomic_t next_entry;
+} iuliia_dir_loader_t;
+
+IULIIA_THREAD_PROC(iuliiaIntDirLoaderThread)
+{
+	iuliia_dir_loader_t *loader;
+	iuliia_arena_t scratch;
+
+	loader = (iuliia_dir_loader_t *)arg;
+	memset(&scratch, 0, sizeof(iuliia_arena_t));
+
+	while(1) {
+		iuliia_dir_entry_t *entry;
+		size_t i;
+		FILE *f;
+
+		i = (size_t)iuliiaIntAtomicAdd(&(loader->next_entry), 1) - 1;
+		if(i >= loader->dir->nof_entries) break;
+
+		entry = loader->dir->entries + i;
+
+#if defined(_WIN32)
+		f = _wfopen(loader->paths[i], L"rb");
+#else
+		f = fopen(loader->paths[i], "rb");
+#endif
+		if(!f) {
+			entry->error = errno ? errno : ENOENT;
+
+			continue;
+		}
+
+		errno = 0;
+		entry->scheme = iuliiaIntLoadSchemeFromFile(f, loader->flags, true, &scratch);
+		// Scheme isn't valid, unless file can't be read or memory isn't enough
+		if(!entry->scheme) {
+			if(ferror(f))
+				entry->error = errno ? errno : EIO;
+			else
+				entry->error = errno == ENOMEM ? ENOMEM : EINVAL;
+		}
+
+		fclose(f);
+	}
+
+	free(scratch.base);
+
+	return 0;
+}
+
+static bool iuliiaIntIsJsonFile(const iuliia_path_char_t *filename)
+{
+	size_t len;
+
+#if defined(_WIN32)
+	len = wcslen(filename);
+
+	return len > 5 && !_wcsicmp(filename + len - 5, L".json");
+#else
+	len = strlen(filename);
+
+	return len > 5 && !strcmp(filename + len - 5, ".json");
+#endif
+}
+
+// File found in directory. Path is kept as system gave it, because name may be not valid in current locale
+typedef struct {
+	wchar_t *filename;
+	iuliia_path_char_t *path;
+} iuliia_dir_file_t;
+
+static int iuliiaIntCompareDirFiles(const void *a, const void *b)
+{
+	return wcscmp(((const iuliia_dir_file_t *)a)->filename, ((const iuliia_dir_file_t *)b)->filename);
+}
+
+static bool iuliiaIntAddDirFile(iuliia_dir_file_t **files, size_t *nof_files, size_t *max_files, const iuliia_path_char_t *path, const iuliia_path_char_t *filename)
+{
+	iuliia_dir_file_t *file;
+	size_t path_len, filename_len;
+
+	if(!iuliiaIntGrowArray((void **)files, max_files, *nof_files, sizeof(iuliia_dir_file_t))) return false;
+
+	file = *files + *nof_files;
+	memset(file, 0, sizeof(iuliia_dir_file_t));
+
+#if defined(_WIN32)
+	path_len = wcslen(path);
+	filename_len = wcslen(filename);
+#else
+	path_len = strlen(path);
+	filename_len = strlen(filename);
+#endif
+	if(SIZE_MAX/sizeof(wchar_t)-2 < path_len+filename_len) return false;
+
+	file->path = malloc((path_len+filename_len+2)*sizeof(iuliia_path_char_t));
+	file->filename = malloc((filename_len+1)*sizeof(wchar_t));
+	if(!file->path || !file->filename) {
+		free(file->path);
+		free(file->filename);
+
+		return false;
+	}
+
+	memcpy(file->path, path, path_len*sizeof(iuliia_path_char_t));
+	file->path[path_len] = IULIIA_DIR_SEPARATOR;
+	memcpy(file->path+path_len+1, filename, (filename_len+1)*sizeof(iuliia_path_char_t));
+
+#if defined(_WIN32)
+	memcpy(file->filename, filename, (filename_len+1)*sizeof(wchar_t));
+#else
+	if(mbstowcs(file->filename, filename, filename_len+1) == (size_t)(-1)) {
+		size_t i;
+
+		// Name, which isn't valid in current locale, is shown by its bytes, file is opened by path
+		for(i = 0; i <= filename_len; i++) file->filename[i] = (uint8_t)filename[i];
+	}
+#endif
+
+	(*nof_files)++;
+
+	return true;
+}
+
+// Lists json files in directory
+static bool iuliiaIntListDir(const iuliia_path_char_t *path, iuliia_dir_file_t **files, size_t *nof_files)
+{
+	size_t max_files = 0;
+#if defined(_WIN32)
+	WIN32_FIND_DATAW find_data;
+	HANDLE find;
+	wchar_t *mask;
+	size_t path_len;
+
+	path_len = wcslen(path);
+	if(SIZE_MAX/sizeof(wchar_t)-8 < path_len) return false;
+	mask = malloc((path_len+8)*sizeof(wchar_t));
+	if(!mask) return false;
+	memcpy(mask, path, path_len*sizeof(wchar_t));
+	memcpy(mask+path_len, L"\\*.json", 8*sizeof(wchar_t));
+
+	find = FindFirstFileW(mask, &find_data);
+	free(mask);
+	if(find == INVALID_HANDLE_VALUE) return GetLastError() == ERROR_FILE_NOT_FOUND;
+
+	do {
+		if(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+		if(!iuliiaIntIsJsonFile(find_data.cFileName)) continue;
+
+		if(!iuliiaIntAddDirFile(files, nof_files, &max_files, path, find_data.cFileName)) {
+			FindClose(find);
+
+			return false;
+		}
+	} while(FindNextFileW(find, &find_data));
+
+	FindClose(find);
+#else
+	DIR *d;
+	struct dirent *de;
+
+	d = opendir(path);
+	if(!d) return false;
+
+	while((de = readdir(d)) != 0) {
+		if(!iuliiaIntIsJsonFile(de->d_name)) continue;
+
+		if(!iuliiaIntAddDirFile(files, nof_files, &max_files, path, de->d_name)) {
+			closedir(d);
+
+			return false;
+		}
+	}
+
+	closedir(d);
+#endif
+
+	return true;
+}
+
+static iuliia_scheme_dir_t *iuliiaIntLoadSchemeDir(const iuliia_path_char_t *path, unsigned int flags, unsigned int nthreads)
+{
+	iuliia_scheme_dir_t *dir;
+	iuliia_dir_loader_t loader;
+	iuliia_dir_file_t *files = 0;
+	iuliia_thread_t *threads = 0;
+	unsigned int nof_started = 0, i;
+	size_t nof_files = 0, j;
+
+	dir = malloc(sizeof(iuliia_scheme_dir_t));
+	if(!dir) return 0;
+	memset(dir, 0, sizeof(iuliia_scheme_dir_t));
+
+	memset(&loader, 0, sizeof(iuliia_dir_loader_t));
+	loader.dir = dir;
+	loader.flags = flags;
+
+	if(!iuliiaIntListDir(path, &files, &nof_files)) goto IULIIA_ERROR;
+	if(!nof_files) return dir;
+
+	qsort(files, nof_files, sizeof(iuliia_dir_file_t), iuliiaIntCompareDirFiles);
+
+	dir->entries = malloc(nof_files*sizeof(iuliia_dir_entry_t));
+	loader.paths = malloc(nof_files*sizeof(iuliia_path_char_t *));
+	if(!dir->entries || !loader.paths) goto IULIIA_ERROR;
+	memset(dir->entries, 0, nof_files*sizeof(iuliia_dir_entry_t));
+
+	// Entries take names, loader takes paths
+	for(j = 0; j < nof_files; j++) {
+		dir->entries[j].filename = files[j].filename;
+		loader.paths[j] = files[j].path;
+	}
+	dir->nof_entries = nof_files;
+	free(files);
+	files = 0;
+
+	// Calling thread loads schemes too
+	if(!nthreads) nthreads = iuliiaIntCpuCount();
+	if(nthreads > dir->nof_entries) nthreads = (unsigned int)dir->nof_entries;
+
+	if(nthreads > 1) {
+		threads = malloc((nthreads-1)*sizeof(iuliia_thread_t));
+		if(threads) {
+			for(i = 0; i < nthreads-1; i++) {
+				if(!iuliiaIntThreadCreate(threads+i, iuliiaIntDirLoaderThread, &loader)) break;
+				nof_started++;
+			}
+		}
+	}
+
+	iuliiaIntDirLoaderThread(&loader);
+
+	for(i = 0; i < nof_started; i++) iuliiaIntThreadJoin(threads[i]);
+
+	free(threads);
+	for(j = 0; j < dir->nof_entries; j++) free(loader.paths[j]);
+	free(loader.paths);
+
+	return dir;
+
+IULIIA_ERROR:
+
+	for(j = 0; files && j < nof_files; j++) {
+		free(files[j].filename);
+		free(files[j].path);
+	}
+	free(files);
+	free(loader.paths);
+
+	iuliiaFreeSchemeDir(dir);
+
+	return 0;
+}
+
+// Makes path in form, which file functions of system take. Result should be freed
+static iuliia_path_char_t *iuliiaIntPathFromW(const wchar_t *path)
+{
+	iuliia_path_char_t *new_path;
+	size_t path_len;
+
+	path_len = wcslen(path);
+#if defined(_WIN32)
+	if(SIZE_MAX/sizeof(wchar_t) <= path_len) return 0;
+
+	new_path = malloc((path_len+1)*sizeof(wchar_t));
+	if(!new_path) return 0;
+
+	memcpy(new_path, path, (path_len+1)*sizeof(wchar_t));
+#else
+	if(SIZE_MAX/MB_CUR_MAX <= path_len) return 0;
+
+	new_path = malloc(path_len * MB_CUR_MAX + 1);
+	if(!new_path) return 0;
+
+	if(wcstombs(new_path, path, path_len * MB_CUR_MAX + 1) == (size_t)(-1)) {
+		free(new_path);
+
+		return 0;
+	}
+#endif
+
+	return new_path;
+}
+
+static iuliia_path_char_t *iuliiaIntPathFromA(const char *path)
+{
+	iuliia_path_char_t *new_path;
+#if defined(_WIN32)
+	int wpath_len;
+
+	wpath_len = MultiByteToWideChar(CP_ACP, 0, path, -1, 0, 0);
+	if(!wpath_len) return 0;
+
+	new_path = malloc(wpath_len*sizeof(wchar_t));
+	if(!new_path) return 0;
+
+	if(!MultiByteToWideChar(CP_ACP, 0, path, -1, new_path, wpath_len)) {
+		free(new_path);
+
+		return 0;
+	}
+#else
+	size_t path_len;
+
+	path_len = strlen(path);
+
+	new_path = malloc(path_len+1);
+	if(!new_path) return 0;
+
+	memcpy(new_path, path, path_len+1);
+#endif
+
+	return new_path;
+}
+
+iuliia_scheme_dir_t *iuliiaLoadSchemeDirW(const wchar_t *path, unsigned int flags, unsigned int nthreads)
+{
+	iuliia_scheme_dir_t *dir;
+	iuliia_path_char_t *sys_path;
+
+	sys_path = iuliiaIntPathFromW(path);
+	if(!sys_path) return 0;
+
+	dir = iuliiaIntLoadSchemeDir(sys_path, flags, nthreads);
+
+	free(sys_path);
+
+	return dir;
+}
+
+iuliia_scheme_dir_t *iuliiaLoadSchemeDirA(const char *path, unsigned int flags, unsigned int nthreads)
+{
+	iuliia_scheme_dir_t *dir;
+	iuliia_path_char_t *sys_path;
+
+	sys_path = iuliiaIntPathFromA(path);
+	if(!sys_path) return 0;
+
+	dir = iuliiaIntLoadSchemeDir(sys_path, flags, nthreads);
+
+	free(sys_path);
+
+	return dir;
+}
+
+void iuliiaFreeSchemeDir(iuliia_scheme_dir_t *dir)
+{
+	size_t i;
+
+	if(!dir) return;
+
+	for(i = 0; i < dir->nof_entries; i++) {
+		iuliiaFreeScheme(dir->entries[i].scheme);
+		free(dir->entries[i].filename);
+	}
+
+	free(dir->entries);
+	free(dir);
+}
+
+#define IULIIA_SLOT_POLL_STEP 50 // Milliseconds between checks of stop request
+
+// File is changed, if any field differs. Times are in nanoseconds on POSIX and in 100 ns on Windows,
+// so write within the same second is found. Id of file finds file replaced by rename
+typedef struct {
+	int64_t time;
+	int64_t change_time;
+	uint64_t id;
+	int64_t size;
+} iuliia_file_stamp_t;
+
+// Readers register themselves in counter of current epoch, then check that epoch is still
+// the same and take the current scheme. Writer swaps scheme, switches epoch and waits until
+// nobody is registered in previous epoch, so nobody can get the old scheme any more
+struct iuliia_scheme_slot_s {
+	iuliia_compiled_scheme_t *volatile current;
+	iuliia_atomic_t epoch;
+	iuliia_atomic_t readers[2];
+	iuliia_atomic_t writer; // Publications are done one by one
+	iuliia_atomic_t checker; // So are checks of watched file
+	iuliia_path_char_t *path; // Watched file
+	unsigned int flags;
+	unsigned int period;
+	iuliia_file_stamp_t stamp;
+	iuliia_atomic_t stop;
+	iuliia_thread_t thread;
+	bool has_thread;
+};
+
+static bool iuliiaIntGetFileStamp(const iuliia_path_char_t *path, iuliia_file_stamp_t *stamp)
+{
+#if defined(_WIN32)
+	BY_HANDLE_FILE_INFORMATION info;
+	HANDLE file;
+	BOOL is_got;
+
+	file = CreateFileW(path, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0);
+	if(file == INVALID_HANDLE_VALUE) return false;
+	is_got = GetFileInformationByHandle(file, &info);
+	CloseHandle(file);
+	if(!is_got) return false;
+
+	stamp->time = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+	stamp->change_time = (int64_t)(((uint64_t)info.ftCreationTime.dwHighDateTime << 32) | info.ftCreationTime.dwLowDateTime);
+	stamp->id = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+	stamp->size = (int64_t)(((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow);
+#else
+	struct stat st;
+
+	if(stat(path, &st)) return false;
+
+#if defined(__APPLE__)
+	stamp->time = (int64_t)st.st_mtimespec.tv_sec*1000000000 + st.st_mtimespec.tv_nsec;
+	stamp->change_time = (int64_t)st.st_ctimespec.tv_sec*1000000000 + st.st_ctimespec.tv_nsec;
+#else
+	stamp->time = (int64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+	stamp->change_time = (int64_t)st.st_ctim.tv_sec*1000000000 + st.st_ctim.tv_nsec;
+#endif
+	stamp->id = (uint64_t)st.st_ino;
+	stamp->size = (int64_t)st.st_size;
+#endif
+
+	return true;
+}
+
+static bool iuliiaIntIsSameFileStamp(const iuliia_file_stamp_t *a, const iuliia_file_stamp_t *b)
+{
+	return a->time == b->time && a->change_time == b->change_time && a->id == b->id && a->size == b->size;
+}
+
+static iuliia_compiled_scheme_t *iuliiaIntLoadCompiledScheme(const iuliia_path_char_t *path, unsigned int flags)
+{
+	iuliia_compiled_scheme_t *compiled;
+	iuliia_scheme_t *scheme;
+	iuliia_arena_t scratch;
+	FILE *f;
+
+#if defined(_WIN32)
+	f = _wfopen(path, L"rb");
+#else
+	f = fopen(path, "rb");
+#endif
+	if(!f) return 0;
+
+	// Watched file may be rewritten while it is loaded
+	memset(&scratch, 0, sizeof(iuliia_arena_t));
+	scheme = iuliiaIntLoadSchemeFromFile(f, flags, false, &scratch);
+	free(scratch.base);
+	fclose(f);
+	if(!scheme) return 0;
+
+	compiled = iuliiaIntWrapScheme(scheme, 0);
+	if(!compiled) iuliiaFreeScheme(scheme);
+
+	return compiled;
+}
+
+int iuliiaSchemeSlotCheck(iuliia_scheme_slot_t *slot)
+{
+	iuliia_file_stamp_t stamp;
+	iuliia_compiled_scheme_t *compiled = 0;
+
+	if(!slot->path) return 0;
+
+	while(iuliiaIntAtomicAdd(&(slot->checker), 1) != 1) {
+		iuliiaIntAtomicAdd(&(slot->checker), -1);
+		iuliiaIntThreadYield();
+	}
+
+	// File being written may be invalid, it is read again on next check then
+	if(iuliiaIntGetFileStamp(slot->path, &stamp) && !iuliiaIntIsSameFileStamp(&stamp, &(slot->stamp))) {
+		compiled = iuliiaIntLoadCompiledScheme(slot->path, slot->flags);
+		if(compiled) {
+			slot->stamp = stamp;
+			iuliiaSchemeSlotPublish(slot, compiled);
+			iuliiaReleaseScheme(compiled);
+		}
+	}
+
+	iuliiaIntAtomicAdd(&(slot->checker), -1);
+
+	return compiled != 0;
+}
+
+IULIIA_THREAD_PROC(iuliiaIntSlotWatcherThread)
+{
+	iuliia_scheme_slot_t *slot;
+	unsigned int waited = 0, step;
+
+	slot = (iuliia_scheme_slot_t *)arg;
+
+	while(!iuliiaIntAtomicAdd(&(slot->stop), 0)) {
+		step = slot->period < IULIIA_SLOT_POLL_STEP ? slot->period : IULIIA_SLOT_POLL_STEP;
+		iuliiaIntSleep(step);
+		waited += step;
+		if(waited < slot->period) continue;
+		waited = 0;
+
+		iuliiaSchemeSlotCheck(slot);
+	}
+
+	return 0;
+}
+
+static iuliia_scheme_slot_t *iuliiaIntCreateSchemeSlot(void)
+{
+	iuliia_scheme_slot_t *slot;
+
+	slot = malloc(sizeof(iuliia_scheme_slot_t));
+	if(!slot) return 0;
+	memset(slot, 0, sizeof(iuliia_scheme_slot_t));
+
+	return slot;
+}
+
+iuliia_scheme_slot_t *iuliiaCreateSchemeSlot(iuliia_compiled_scheme_t *compiled)
+{
+	iuliia_scheme_slot_t *slot;
+
+	slot = iuliiaIntCreateSchemeSlot();
+	if(!slot) return 0;
+
+	slot->current = iuliiaRetainScheme(compiled);
+
+	return slot;
+}
+
+static iuliia_scheme_slot_t *iuliiaIntCreateSchemeFileSlot(iuliia_path_char_t *path, unsigned int flags, unsigned int period_ms)
+{
+	iuliia_scheme_slot_t *slot;
+
+	slot = iuliiaIntCreateSchemeSlot();
+	if(!slot) goto IULIIA_ERROR;
+
+	slot->path = path;
+	slot->flags = flags;
+	slot->period = period_ms;
+
+	// Stamp is taken before reading, so changes made while reading aren't missed
+	if(!iuliiaIntGetFileStamp(path, &(slot->stamp))) goto IULIIA_ERROR;
+
+	slot->current = iuliiaIntLoadCompiledScheme(path, flags);
+	if(!slot->current) goto IULIIA_ERROR;
+
+	if(period_ms) {
+		if(!iuliiaIntThreadCreate(&(slot->thread), iuliiaIntSlotWatcherThread, slot)) goto IULIIA_ERROR;
+		slot->has_thread = true;
+	}
+
+	return slot;
+
+IULIIA_ERROR:
+
+	if(slot) {
+		iuliiaReleaseScheme(slot->current);
+		free(slot);
+	}
+	free(path);
+
+	return 0;
+}
+
+iuliia_scheme_slot_t *iuliiaCreateSchemeSlotW(const wchar_t *filename, unsigned int flags, unsigned int period_ms)
+{
+	iuliia_path_char_t *path;
+
+	path = iuliiaIntPathFromW(filename);
+	if(!path) return 0;
+
+	return iuliiaIntCreateSchemeFileSlot(path, flags, period_ms);
+}
+
+iuliia_scheme_slot_t *iuliiaCreateSchemeSlotA(const char *filename, unsigned int flags, unsigned int period_ms)
+{
+	iuliia_path_char_t *path;
+
+	path = iuliiaIntPathFromA(filename);
+	if(!path) return 0;
+
+	return iuliiaIntCreateSchemeFileSlot(path, flags, period_ms);
+}
+
+void iuliiaFreeSchemeSlot(iuliia_scheme_slot_t *slot)
+{
+	if(!slot) return;
+
+	if(slot->has_thread) {
+		iuliiaIntAtomicAdd(&(slot->stop), 1);
+		iuliiaIntThreadJoin(slot->thread);
+	}
+
+	iuliiaReleaseScheme(slot->current);
+	free(slot->path);
+	free(slot);
+}
+
+iuliia_compiled_scheme_t *iuliiaSchemeSlotAcquire(iuliia_scheme_slot_t *slot)
+{
+	iuliia_compiled_scheme_t *compiled;
+
+	while(1) {
+		long epoch;
+
+		epoch = iuliiaIntAtomicAdd(&(slot->epoch), 0) & 1;
+		iuliiaIntAtomicAdd(slot->readers + epoch, 1);
+		if((iuliiaIntAtomicAdd(&(slot->epoch), 0) & 1) == epoch) {
+			compiled = iuliiaRetainScheme(iuliiaIntAtomicLoadPtr(&(slot->current)));
+			iuliiaIntAtomicAdd(slot->readers + epoch, -1);
+
+			return compiled;
+		}
+
+		// Writer has switched epoch, it may be waiting for us
+		iuliiaIntAtomicAdd(slot->readers + epoch, -1);
+	}
+}
+
+void iuliiaSchemeSlotPublish(iuliia_scheme_slot_t *slot, iuliia_compiled_scheme_t *compiled)
+{
+	iuliia_compiled_scheme_t *old;
+	long epoch;
+
+	while(iuliiaIntAtomicAdd(&(slot->writer), 1) != 1) {
+		iuliiaIntAtomicAdd(&(slot->writer), -1);
+		iuliiaIntThreadYield();
+	}
+
+	iuliiaRetainScheme(compiled);
+	old = iuliiaIntAtomicExchangePtr(&(slot->current), compiled);
+
+	epoch = iuliiaIntAtomicAdd(&(slot->epoch), 1) - 1;
+	while(iuliiaIntAtomicAdd(slot->readers + (epoch & 1), 0))
+		iuliiaIntThreadYield();
+
+	iuliiaIntAtomicAdd(&(slot->writer), -1);
+
+	// Translations, which still use old scheme, hold their own references
+	iuliiaReleaseScheme(old);
+}
+
+#define IULIIA_SHARED_MAGIC 0x534c5549 // "IULS"
+#define IULIIA_SHARED_READY_TIMEOUT 30 // Seconds, after which memory not filled by creator is abandoned
+
+// Shared memory starts with header and offsets of schemes, then schemes follow.
+// Pointers in schemes are valid at address, where creator has mapped memory
+typedef struct {
+	uint32_t magic;
+	uint16_t pointer_size; // Memory made by incompatible build isn't used
+	uint16_t wchar_size;
+	iuliia_atomic_t ready;
+	uint64_t owner; // Process of creator
+	int64_t created; // Time, when creator started to fill memory
+	uint64_t size;
+	uint64_t base;
+	uint64_t nof_schemes;
+} iuliia_shared_header_t;
+
+struct iuliia_shared_schemes_s {
+	iuliia_shared_header_t *header;
+	size_t size;
+#if defined(_WIN32)
+	HANDLE mapping;
+#endif
+};
+
+#define IULIIA_RELOCATE(p, delta) ((p) ? (void *)((uintptr_t)(p) + (delta)) : 0)
+
+// Lays out schemes from builders in arena. Called twice: to measure and to fill memory
+static bool iuliiaIntSharedLayout(const iuliia_builder_t *builders, size_t nof_schemes, iuliia_arena_t *arena)
+{
+	iuliia_shared_header_t *header;
+	uint64_t *offsets;
+	bool overflow = false;
+	size_t i;
+
+	header = iuliiaIntArenaAlloc(arena, sizeof(iuliia_shared_header_t), &overflow);
+	if(SIZE_MAX/sizeof(uint64_t) < nof_schemes) return false;
+	offsets = iuliiaIntArenaAlloc(arena, nof_schemes*sizeof(uint64_t), &overflow);
+
+	for(i = 0; i < nof_schemes; i++) {
+		iuliia_scheme_t *scheme, measured_scheme;
+
+		scheme = iuliiaIntArenaAlloc(arena, sizeof(iuliia_scheme_t), &overflow);
+		if(scheme && offsets)
+			offsets[i] = (uint64_t)((uint8_t *)scheme - arena->base);
+		else
+			scheme = &measured_scheme;
+		memset(scheme, 0, sizeof(iuliia_scheme_t));
+
+		if(!iuliiaIntBuilderLayout(builders + i, arena, scheme)) return false;
+		iuliiaIntBuildPatternTrie(scheme);
+		iuliiaIntSelectEngine(scheme);
+	}
+
+	if(header) {
+		header->magic = IULIIA_SHARED_MAGIC;
+		header->pointer_size = sizeof(void *);
+		header->wchar_size = sizeof(wchar_t);
+		header->size = arena->size;
+		header->base = (uint64_t)(uintptr_t)arena->base;
+		header->nof_schemes = nof_schemes;
+	}
+
+	return !overflow;
+}
+
+// Fixes pointers of schemes, which are mapped not at address of creator
+static void iuliiaIntRelocateShared(iuliia_shared_header_t *header)
+{
+	const uint64_t *offsets;
+	uintptr_t delta;
+	size_t i, j;
+
+	delta = (uintptr_t)header - (uintptr_t)header->base;
+	offsets = (const uint64_t *)((uint8_t *)header + sizeof(iuliia_shared_header_t));
+
+	for(i = 0; i < header->nof_schemes; i++) {
+		iuliia_scheme_t *scheme;
+
+		scheme = (iuliia_scheme_t *)((uint8_t *)header + offsets[i]);
+
+		scheme->name = IULIIA_RELOCATE(scheme->name, delta);
+		scheme->description = IULIIA_RELOCATE(scheme->description, delta);
+		scheme->url = IULIIA_RELOCATE(scheme->url, delta);
+
+		scheme->mapping = IULIIA_RELOCATE(scheme->mapping, delta);
+		for(j = 0; j < scheme->nof_mapping; j++)
+			scheme->mapping[j].repl = IULIIA_RELOCATE(scheme->mapping[j].repl, delta);
+
+		scheme->prev_mapping = IULIIA_RELOCATE(scheme->prev_mapping, delta);
+		for(j = 0; j < scheme->nof_prev_mapping; j++)
+			scheme->prev_mapping[j].repl = IULIIA_RELOCATE(scheme->prev_mapping[j].repl, delta);
+
+		scheme->next_mapping = IULIIA_RELOCATE(scheme->next_mapping, delta);
+		for(j = 0; j < scheme->nof_next_mapping; j++)
+			scheme->next_mapping[j].repl = IULIIA_RELOCATE(scheme->next_mapping[j].repl, delta);
+
+		scheme->ending_mapping = IULIIA_RELOCATE(scheme->ending_mapping, delta);
+		for(j = 0; j < scheme->nof_ending_mapping; j++)
+			scheme->ending_mapping[j].repl = IULIIA_RELOCATE(scheme->ending_mapping[j].repl, delta);
+
+		scheme->pattern_mapping = IULIIA_RELOCATE(scheme->pattern_mapping, delta);
+		for(j = 0; j < scheme->nof_pattern_mapping; j++) {
+			scheme->pattern_mapping[j].pattern = IULIIA_RELOCATE(scheme->pattern_mapping[j].pattern, delta);
+			scheme->pattern_mapping[j].repl = IULIIA_RELOCATE(scheme->pattern_mapping[j].repl, delta);
+		}
+		scheme->pattern_trie = IULIIA_RELOCATE(scheme->pattern_trie, delta);
+
+		scheme->samples = IULIIA_RELOCATE(scheme->samples, delta);
+		for(j = 0; j < scheme->nof_samples; j++) {
+			scheme->samples[j].in = IULIIA_RELOCATE(scheme->samples[j].in, delta);
+			scheme->samples[j].out = IULIIA_RELOCATE(scheme->samples[j].out, delta);
+		}
+	}
+
+	header->base = (uint64_t)(uintptr_t)header;
+}
+
+// Checks that table of nof_items at pointer of creator is inside of memory
+static bool iuliiaIntSharedRangeIsValid(const iuliia_shared_header_t *header, const void *p, size_t nof_items, size_t item_size)
+{
+	uint64_t offset;
+
+	if(!p) return !nof_items;
+
+	offset = (uint64_t)(uintptr_t)p - header->base;
+	if(offset >= header->size || offset % IULIIA_ARENA_ALIGN) return false;
+
+	return (uint64_t)nof_items <= (header->size - offset)/item_size;
+}
+
+// Checks that string at pointer of creator ends inside of memory. Returns its length or SIZE_MAX
+static size_t iuliiaIntSharedStringLength(const iuliia_shared_header_t *header, const void *p, size_t char_size)
+{
+	const uint8_t *c, *end;
+	size_t len = 0;
+
+	if(!iuliiaIntSharedRangeIsValid(header, p, 1, char_size)) return SIZE_MAX;
+
+	c = (const uint8_t *)header + ((uint64_t)(uintptr_t)p - header->base);
+	end = (const uint8_t *)header + header->size;
+	for(; (size_t)(end - c) >= char_size; c += char_size, len++) {
+		if(char_size == sizeof(uint32_t) ? !*(const uint32_t *)c : !*(const wchar_t *)c) return len;
+	}
+
+	return SIZE_MAX;
+}
+
+// Returns pointer of creator as pointer to mapped memory. Pointer should be checked before
+#define IULIIA_SHARED_PTR(header, p) ((void *)((uint8_t *)(header) + ((uint64_t)(uintptr_t)(p) - (header)->base)))
+
+static bool iuliiaIntSharedMappingIsValid(const iuliia_shared_header_t *header, const iuliia_mapping_2char_t *mapping, size_t nof_mapping)
+{
+	const iuliia_mapping_2char_t *m;
+	size_t i;
+
+	if(!iuliiaIntSharedRangeIsValid(header, mapping, nof_mapping, sizeof(iuliia_mapping_2char_t))) return false;
+
+	m = mapping ? IULIIA_SHARED_PTR(header, mapping) : 0;
+	for(i = 0; i < nof_mapping; i++)
+		if(iuliiaIntSharedStringLength(header, m[i].repl, sizeof(uint32_t)) == SIZE_MAX) return false;
+
+	return true;
+}
+
+// Checks every table and pointer of scheme against size of memory, before they are used or relocated
+static bool iuliiaIntSharedSchemeIsValid(const iuliia_shared_header_t *header, const iuliia_scheme_t *scheme)
+{
+	const iuliia_mapping_1char_t *mapping;
+	const iuliia_mapping_pattern_t *patterns;
+	const iuliia_pattern_node_t *trie;
+	const iuliia_samples_t *samples;
+	size_t nof_nodes = 1, i, j;
+
+	if(scheme->arena || scheme->base || scheme->jit || scheme->fst) return false;
+
+	if(scheme->name && iuliiaIntSharedStringLength(header, scheme->name, sizeof(wchar_t)) == SIZE_MAX) return false;
+	if(scheme->description && iuliiaIntSharedStringLength(header, scheme->description, sizeof(wchar_t)) == SIZE_MAX) return false;
+	if(scheme->url && iuliiaIntSharedStringLength(header, scheme->url, sizeof(wchar_t)) == SIZE_MAX) return false;
+
+	if(!iuliiaIntSharedRangeIsValid(header, scheme->mapping, scheme->nof_mapping, sizeof(iuliia_mapping_1char_t))) return false;
+	mapping = scheme->mapping ? IULIIA_SHARED_PTR(header, scheme->mapping) : 0;
+	for(i = 0; i < scheme->nof_mapping; i++)
+		if(iuliiaIntSharedStringLength(header, mapping[i].repl, sizeof(uint32_t)) == SIZE_MAX) return false;
+
+	if(!iuliiaIntSharedMappingIsValid(header, scheme->prev_mapping, scheme->nof_prev_mapping)) return false;
+	if(!iuliiaIntSharedMappingIsValid(header, scheme->next_mapping, scheme->nof_next_mapping)) return false;
+	if(!iuliiaIntSharedMappingIsValid(header, scheme->ending_mapping, scheme->nof_ending_mapping)) return false;
+
+	if(!iuliiaIntSharedRangeIsValid(header, scheme->pattern_mapping, scheme->nof_pattern_mapping, sizeof(iuliia_mapping_pattern_t))) return false;
+	patterns = scheme->pattern_mapping ? IULIIA_SHARED_PTR(header, scheme->pattern_mapping) : 0;
+	for(i = 0; i < scheme->nof_pattern_mapping; i++) {
+		size_t len;
+
+		len = iuliiaIntSharedStringLength(header, patterns[i].pattern, sizeof(uint32_t));
+		if(len > IULIIA_MAX_PATTERN_LENGTH) return false;
+		if(iuliiaIntSharedStringLength(header, patterns[i].repl, sizeof(uint32_t)) == SIZE_MAX) return false;
+		nof_nodes += len;
+	}
+
+	// Trie has place for every character of patterns, children of nodes should be in it
+	if(scheme->nof_pattern_mapping && !scheme->pattern_trie) return false;
+	if(scheme->pattern_trie) {
+		if(!iuliiaIntSharedRangeIsValid(header, scheme->pattern_trie, nof_nodes, sizeof(iuliia_pattern_node_t))) return false;
+		trie = IULIIA_SHARED_PTR(header, scheme->pattern_trie);
+		for(i = 0; i < nof_nodes; i++) {
+			if((uint64_t)trie[i].first_child + trie[i].nof_children > nof_nodes) return false;
+			for(j = 0; j < sizeof(trie[i].patterns)/sizeof(uint32_t); j++)
+				if(trie[i].patterns[j] > scheme->nof_pattern_mapping) return false;
+		}
+	}
+
+	if(!iuliiaIntSharedRangeIsValid(header, scheme->samples, scheme->nof_samples, sizeof(iuliia_samples_t))) return false;
+	samples = scheme->samples ? IULIIA_SHARED_PTR(header, scheme->samples) : 0;
+	for(i = 0; i < scheme->nof_samples; i++) {
+		if(iuliiaIntSharedStringLength(header, samples[i].in, sizeof(wchar_t)) == SIZE_MAX) return false;
+		if(iuliiaIntSharedStringLength(header, samples[i].out, sizeof(wchar_t)) == SIZE_MAX) return false;
+	}
+
+	return iuliiaIntEngineIsSelected(scheme);
+}
+
+static bool iuliiaIntSharedHeaderIsValid(const iuliia_shared_header_t *header, size_t size)
+{
+	const uint64_t *offsets;
+	size_t i;
+
+	if(header->magic != IULIIA_SHARED_MAGIC || header->pointer_size != sizeof(void *) || header->wchar_size != sizeof(wchar_t)) return false;
+	if(header->size != size) return false;
+	if((size - sizeof(iuliia_shared_header_t))/sizeof(uint64_t) < header->nof_schemes) return false;
+
+	offsets = (const uint64_t *)((const uint8_t *)header + sizeof(iuliia_shared_header_t));
+	for(i = 0; i < header->nof_schemes; i++) {
+		if(offsets[i] > size - sizeof(iuliia_scheme_t) || offsets[i] % IULIIA_ARENA_ALIGN) return false;
+		if(!iuliiaIntSharedSchemeIsValid(header, (const iuliia_scheme_t *)((const uint8_t *)header + offsets[i]))) return false;
+	}
+
+	return true;
+}
+
+static uint64_t iuliiaIntProcessId(void)
+{
+#if defined(_WIN32)
+	return (uint64_t)GetCurrentProcessId();
+#else
+	return (uint64_t)getpid();
+#endif
+}
+
+static bool iuliiaIntProcessIsAlive(uint64_t id)
+{
+#if defined(_WIN32)
+	HANDLE process;
+	bool is_alive;
+
+	process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)id);
+	if(!process) return GetLastError() == ERROR_ACCESS_DENIED;
+
+	is_alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+	CloseHandle(process);
+
+	return is_alive;
+#else
+	return !kill((pid_t)id, 0) || errno == EPERM;
+#endif
+}
+
+// Creator, which crashed before memory was filled, leaves it not ready forever. Such memory is abandoned,
+// when creator is dead or filling takes too long (id of dead creator may be taken by other process).
+// created is time of memory by system (0 - unknown), when creator hasn't written header yet
+static bool iuliiaIntSharedIsAbandoned(const iuliia_shared_header_t *header, int64_t created)
+{
+	if(header->ready) return false;
+
+	if(header->created) created = header->created;
+	if(created && (int64_t)time(0) - created > IULIIA_SHARED_READY_TIMEOUT) return true;
+
+	return header->owner && !iuliiaIntProcessIsAlive(header->owner);
+}
+
+#if !defined(_WIN32)
+// Reads header of memory, which may be not filled yet. Header of too small memory is zeroed
+static bool iuliiaIntReadSharedHeader(int fd, iuliia_shared_header_t *header, struct stat *st)
+{
+	void *view;
+
+	memset(header, 0, sizeof(iuliia_shared_header_t));
+	if(fstat(fd, st)) return false;
+	if((uint64_t)st->st_size < sizeof(iuliia_shared_header_t)) return true;
+
+	view = mmap(0, sizeof(iuliia_shared_header_t), PROT_READ, MAP_SHARED, fd, 0);
+	if(view == MAP_FAILED) return false;
+	memcpy(header, view, sizeof(iuliia_shared_header_t));
+	header->ready = iuliiaIntAtomicLoad(&(((iuliia_shared_header_t *)view)->ready));
+	munmap(view, sizeof(iuliia_shared_header_t));
+
+	return true;
+}
+
+// Removes memory with name, if it is abandoned and still the same memory
+static bool iuliiaIntRemoveAbandonedShared(const char *name)
+{
+	iuliia_shared_header_t header;
+	struct stat st, new_st;
+	bool is_abandoned;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd < 0) return errno == ENOENT;
+
+	is_abandoned = iuliiaIntReadSharedHeader(fd, &header, &st) && iuliiaIntSharedIsAbandoned(&header, (int64_t)st.st_ctime);
+	close(fd);
+	if(!is_abandoned) return false;
+
+	// Other process may have removed it and made new memory meanwhile
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd < 0) return errno == ENOENT;
+	is_abandoned = !fstat(fd, &new_st) && new_st.st_ino == st.st_ino && new_st.st_dev == st.st_dev;
+	close(fd);
+
+	return is_abandoned && (!shm_unlink(name) || errno == ENOENT);
+}
+#endif
+
+iuliia_shared_schemes_t *iuliiaCreateSharedSchemes(const char *name, const iuliia_scheme_t *const *schemes, size_t nof_schemes)
+{
+	iuliia_shared_schemes_t *shared = 0;
+	iuliia_builder_t *builders;
+	iuliia_arena_t arena;
+	void *memory = 0;
+	size_t i;
+#if defined(_WIN32)
+	HANDLE mapping = 0;
+#else
+	int fd;
+#endif
+
+	if(SIZE_MAX/sizeof(iuliia_builder_t) <= nof_schemes) return 0;
+	builders = malloc((nof_schemes+1)*sizeof(iuliia_builder_t));
+	if(!builders) return 0;
+	memset(builders, 0, (nof_schemes+1)*sizeof(iuliia_builder_t));
+
+	for(i = 0; i < nof_schemes; i++) iuliiaIntBuilderInit(builders + i);
+
+	for(i = 0; i < nof_schemes; i++) {
+		if(!iuliiaIntBuilderAddSchemeCopy(builders + i, schemes[i])) goto IULIIA_ERROR;
+
+		builders[i].tables[IULIIA_TABLE_MAPPING].present = true;
+		iuliiaIntBuilderSortRules(builders + i);
+	}
+
+	memset(&arena, 0, sizeof(iuliia_arena_t));
+	if(!iuliiaIntSharedLayout(builders, nof_schemes, &arena)) goto IULIIA_ERROR;
+	arena.size = arena.offset;
+	arena.offset = 0;
+
+	shared = malloc(sizeof(iuliia_shared_schemes_t));
+	if(!shared) goto IULIIA_ERROR;
+	memset(shared, 0, sizeof(iuliia_shared_schemes_t));
+
+#if defined(_WIN32)
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, (DWORD)((uint64_t)arena.size >> 32), (DWORD)arena.size, name);
+	if(!mapping) goto IULIIA_ERROR;
+	if(GetLastError() == ERROR_ALREADY_EXISTS) {
+		errno = EEXIST;
+
+		goto IULIIA_ERROR;
+	}
+
+	memory = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, arena.size);
+	if(!memory) goto IULIIA_ERROR;
+#else
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd < 0 && errno == EEXIST) {
+		if(!iuliiaIntRemoveAbandonedShared(name)) {
+			errno = EEXIST;
+
+			goto IULIIA_ERROR;
+		}
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	}
+	if(fd < 0) goto IULIIA_ERROR;
+
+	if(ftruncate(fd, (off_t)arena.size)) {
+		close(fd);
+		shm_unlink(name);
+
+		goto IULIIA_ERROR;
+	}
+
+	memory = mmap(0, arena.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(memory == MAP_FAILED) {
+		memory = 0;
+		shm_unlink(name);
+
+		goto IULIIA_ERROR;
+	}
+#endif
+
+	// Openers find abandoned memory by creator and time
+	((iuliia_shared_header_t *)memory)->owner = iuliiaIntProcessId();
+	((iuliia_shared_header_t *)memory)->created = (int64_t)time(0);
+
+	arena.base = memory;
+	iuliiaIntSharedLayout(builders, nof_schemes, &arena);
+
+	shared->header = memory;
+	shared->size = arena.size;
+#if defined(_WIN32)
+	shared->mapping = mapping;
+#endif
+
+	// Other processes use memory only after it is filled
+	iuliiaIntAtomicAdd(&(shared->header->ready), 1);
+
+#if !defined(_WIN32)
+	mprotect(memory, arena.size, PROT_READ);
+#endif
+
+	for(i = 0; i < nof_schemes; i++) iuliiaIntBuilderDestroy(builders + i);
+	free(builders);
+
+	return shared;
+
+IULIIA_ERROR:
+
+#if defined(_WIN32)
+	if(memory) UnmapViewOfFile(memory);
+	if(mapping) CloseHandle(mapping);
+#endif
+	free(shared);
+	for(i = 0; i < nof_schemes; i++) iuliiaIntBuilderDestroy(builders + i);
+	free(builders);
+
+	return 0;
+}
+
+iuliia_shared_schemes_t *iuliiaOpenSharedSchemes(const char *name)
+{
+	iuliia_shared_schemes_t *shared;
+	iuliia_shared_header_t header, *memory = 0;
+	int64_t created = 0;
+	bool is_copy = false;
+#if defined(_WIN32)
+	HANDLE mapping;
+	void *view;
+#else
+	struct stat st;
+	int fd = -1;
+#endif
+
+	shared = malloc(sizeof(iuliia_shared_schemes_t));
+	if(!shared) return 0;
+	memset(shared, 0, sizeof(iuliia_shared_schemes_t));
+
+#if defined(_WIN32)
+	mapping = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_COPY, FALSE, name);
+	if(!mapping) goto IULIIA_ERROR;
+	shared->mapping = mapping;
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(iuliia_shared_header_t));
+	if(!view) goto IULIIA_ERROR;
+	memcpy(&header, view, sizeof(iuliia_shared_header_t));
+	header.ready = iuliiaIntAtomicLoad(&(((iuliia_shared_header_t *)view)->ready));
+	UnmapViewOfFile(view);
+#else
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd < 0) goto IULIIA_ERROR;
+
+	if(!iuliiaIntReadSharedHeader(fd, &header, &st)) goto IULIIA_ERROR;
+	created = (int64_t)st.st_ctime;
+	if((uint64_t)st.st_size > SIZE_MAX) {
+		errno = EINVAL;
+
+		goto IULIIA_ERROR;
+	}
+#endif
+
+	// Creator is still filling memory or has crashed
+	if(!header.ready) {
+		errno = iuliiaIntSharedIsAbandoned(&header, created) ? ENOENT : EAGAIN;
+
+		goto IULIIA_ERROR;
+	}
+	if(header.size > SIZE_MAX || header.size < sizeof(iuliia_shared_header_t)) {
+		errno = EINVAL;
+
+		goto IULIIA_ERROR;
+	}
+	shared->size = (size_t)header.size;
+
+	// At address of creator pointers are valid and memory is shared,
+	// otherwise private copy of pages is made to relocate pointers
+#if defined(_WIN32)
+	memory = MapViewOfFileEx(mapping, FILE_MAP_READ, 0, 0, shared->size, (void *)(uintptr_t)header.base);
+	if(!memory) {
+		memory = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, shared->size);
+		if(!memory) goto IULIIA_ERROR;
+		is_copy = true;
+	}
+#else
+	memory = mmap((void *)(uintptr_t)header.base, shared->size, PROT_READ, MAP_SHARED, fd, 0);
+	if(memory != MAP_FAILED && memory != (void *)(uintptr_t)header.base) {
+		munmap(memory, shared->size);
+		memory = MAP_FAILED;
+	}
+	if(memory == MAP_FAILED) {
+		memory = mmap(0, shared->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if(memory == MAP_FAILED) {
+			memory = 0;
+
+			goto IULIIA_ERROR;
+		}
+		is_copy = true;
+	}
+	close(fd);
+	fd = -1;
+#endif
+	shared->header = memory;
+
+	// Shared memory is checked once and isn't copied, so later changes by writer aren't detected.
+	// Only user of creator can write it (mode 0644), other writers must be trusted
+	if(!iuliiaIntSharedHeaderIsValid(memory, shared->size)) {
+		errno = EINVAL;
+
+		goto IULIIA_ERROR;
+	}
+
+	if(is_copy) {
+		iuliiaIntRelocateShared(memory);
+#if !defined(_WIN32)
+		mprotect(memory, shared->size, PROT_READ);
+#endif
+	}
+
+	return shared;
+
+IULIIA_ERROR:
+
+#if !defined(_WIN32)
+	if(fd >= 0) close(fd);
+#endif
+	iuliiaCloseSharedSchemes(shared);
+
+	return 0;
+}
+
+void iuliiaCloseSharedSchemes(iuliia_shared_schemes_t *shared)
+{
+	if(!shared) return;
+
+#if defined(_WIN32)
+	if(shared->header) UnmapViewOfFile(shared->header);
+	if(shared->mapping) CloseHandle(shared->mapping);
+#else
+	if(shared->header) munmap(shared->header, shared->size);
+#endif
+
+	free(shared);
+}
+
+int iuliiaRemoveSharedSchemes(const char *name)
+{
+#if defined(_WIN32)
+	// Named mapping is removed, when it is closed by all processes
+	(void)name;
+
+	return 1;
+#else
+	return shm_unlink(name) == 0;
+#endif
+}
+
+size_t iuliiaSharedSchemesCount(const iuliia_shared_schemes_t *shared)
+{
+	return (size_t)shared->header->nof_schemes;
+}
+
+const iuliia_scheme_t *iuliiaSharedSchemesGet(const iuliia_shared_schemes_t *shared, size_t i)
+{
+	const uint64_t *offsets;
+
+	if(i >= shared->header->nof_schemes) return 0;
+
+	offsets = (const uint64_t *)((const uint8_t *)shared->header + sizeof(iuliia_shared_header_t));
+
+	return (const iuliia_scheme_t *)((const uint8_t *)shared->header + offsets[i]);
+}
+
+size_t iuliiaU32len(const uint32_t *s)
+{
+	size_t size = 0;
+	
+	while(*(s++) != 0) size++;
+	
+	return size;
+}
+
+wchar_t *iuliiaU32toW(const uint32_t *s)
+{
+	size_t s_len;
+	wchar_t *new_s;
+
+	s_len = iuliiaU32len(s);
+	new_s = malloc((s_len+1)*sizeof(uint32_t));
+	if(!new_s) return 0;
+	
+	if(sizeof(uint32_t) == sizeof(wchar_t)) {
+		memcpy(new_s, s, (s_len+1)*sizeof(wchar_t));
+	} else {
+		wchar_t *p;
+		
+		p = new_s;
+		while(1) {
+			if(*s < 65536)
+				*p = *s;
+			else {
+				*p = (*s-0x10000) >> 10 | 0xd800;
+				p++;
+				*p = ((*s-0x10000) & 0x3ff) | 0xdc00;
+			}
+
+			if(*s == 0) break;
+
+			p++;
+			s++;
+		}
+	}
+	
+	return new_s;
+}
+
+uint32_t *iuliiaWtoU32(const wchar_t *s)
+{
+	size_t s_len;
+	uint32_t *new_s;
+
+	s_len = wcslen(s);
+	if(SIZE_MAX/sizeof(uint32_t) <= s_len) return 0;
+	new_s = malloc((s_len+1)*sizeof(uint32_t));
+	if(!new_s) return 0;
+
+	if(sizeof(uint32_t) == sizeof(wchar_t)) {
+		memcpy(new_s, s, (s_len+1)*sizeof(wchar_t));
+	} else {
+		uint32_t *p;
+		
+		p = new_s;
+		while(1) {
+			if(*s < 0xd800 || *s > 0xdfff)
+				*p = *s;
+			else {
+				if(*s >= 0xdc00) {
+					free(new_s);
+					
+					return 0;
+				}
+				
+				*p = ((*s) & 0x3ff) << 10;
+				s++;
+				
+				if(*s < 0xdc00 || *s > 0xdfff) {
+					free(new_s);
+					
+					return 0;
+				}
+				
+				*p = *p + ((*s) & 0x3ff) + 0x10000;
+			}
+
+			if(*s == 0) break;
+
+			p++;
+			s++;
+		}
+	}
+	
+	return new_s;
+}
+
+const uint8_t *iuliiaCharU8toU32(const uint8_t *u8, uint32_t *u32)
+{
+	uint32_t new_u32 = 0;
+	const uint8_t *pu8;
+	
+	pu8 = u8;
+
+	if(*pu8 < 0x80) {
+		new_u32 = *pu8;
+		pu8++;
+	} else {
+		if((*pu8 & 0xe0) == 0xc0) {
+			new_u32 = (*pu8 & 0x1f) << 6;
+			pu8++;
+			if(!(*pu8)) return 0;
+			if((*pu8 & 0xc0) == 0x80) {
+				new_u32 += *pu8 & 0x3f;
+				pu8++;
+			} else return 0;
+		} else if((*pu8 & 0xf0) == 0xe0) {
+			new_u32 = (*pu8 & 0xf) << 12;
+			pu8++;
+
+			if(!(*pu8)) return 0;
+			if((*pu8 & 0xc0) == 0x80) {
+				new_u32 += (*pu8 & 0x3f) << 6;
+				pu8++;
+			} else return 0;
+
+			if (!(*pu8)) return 0;
+			if((*pu8 & 0xc0) == 0x80) {
+				new_u32 += *pu8 & 0x3f;
+				pu8++;
+			} else return 0;
+		} else if((*pu8 & 0xf8) == 0xf0) {
+			new_u32 = (*pu8 & 0xf) << 18;
+			pu8++;
+
+			if(!(*pu8)) return 0;
+			if((*pu8 & 0xc0) == 0x80) {
+				new_u32 += (*pu8 & 0x3f) << 12;
+				pu8++;
+			} else return 0;
+
+			if(!(*pu8)) return 0;
+			if((*pu8 & 0xc0) == 0x80) {
+				new_u32 += (*pu8 & 0x3f) << 6;
+				pu8++;
+			} else return 0;
+
+			if (!(*pu8)) return 0;
+			if((*pu8 & 0xc0) == 0x80) {
+				new_u32 += *pu8 & 0x3f;
+				pu8++;
+			} else return 0;
+		} else // TODO: Fix this
+			return 0;
+	} 
+
+	*u32 = new_u32;
+
+	return pu8;
+}
+
+uint32_t *iuliiaU8toU32(const uint8_t *u8)
+{
+	const uint8_t *pu8;
+	uint32_t *u32, *pu32;
+	size_t str_size;
+
+	str_size = strlen((const char *)u8);
+
+	if(SIZE_MAX/sizeof(uint32_t) <= str_size) return 0;
+
+	u32 = malloc((str_size+1)*sizeof(uint32_t));
+	if(!u32) return 0;
+
+	pu8 = u8;
+	pu32 = u32;
+	while(1) {
+		bool need_break = false;
+
+		if (*pu8 == 0) need_break = true;
+
+		pu8 = iuliiaCharU8toU32(pu8, pu32);
+		if(!pu8) {
+			free(u32);
+
+			return 0;
+		}
+
+		if(need_break) break;
+
+		pu32++;
+	}
+
+	return u32;
+}
+
+// Case pairs of scripts, which schemes work with. Upper case characters are
+// first, first+stride, ... last, lower case character is upper+delta
+typedef struct {
+	uint32_t first;
+	uint32_t last;
+	int32_t delta;
+	uint32_t stride;
+} iuliia_case_range_t;
+
+static const iuliia_case_range_t iuliia_case_ranges[] = {
+	{0x41, 0x5A, 32, 1}, // Basic Latin
+	{0xC0, 0xD6, 32, 1}, {0xD8, 0xDE, 32, 1}, // Latin-1
+	{0x100, 0x12E, 1, 2}, {0x130, 0x130, -199, 1}, {0x132, 0x136, 1, 2}, {0x139, 0x147, 1, 2}, // Latin Extended-A
+	{0x14A, 0x176, 1, 2}, {0x178, 0x178, -121, 1}, {0x179, 0x17D, 1, 2},
+	{0x1CD, 0x1DB, 1, 2}, {0x1DE, 0x1EE, 1, 2}, {0x1F4, 0x1F4, 1, 1}, {0x1F8, 0x21E, 1, 2}, {0x222, 0x232, 1, 2}, // Latin Extended-B
+	{0x386, 0x386, 38, 1}, {0x388, 0x38A, 37, 1}, {0x38C, 0x38C, 64, 1}, {0x38E, 0x38F, 63, 1}, // Greek
+	{0x391, 0x3A1, 32, 1}, {0x3A3, 0x3AB, 32, 1}, {0x3D8, 0x3EE, 1, 2},
+	{0x400, 0x40F, 80, 1}, {0x410, 0x42F, 32, 1}, {0x460, 0x480, 1, 2}, {0x48A, 0x4BE, 1, 2}, // Cyrillic
+	{0x4C0, 0x4C0, 15, 1}, {0x4C1, 0x4CD, 1, 2}, {0x4D0, 0x52E, 1, 2},
+	{0x531, 0x556, 48, 1}, // Armenian
+	{0x10A0, 0x10C5, 0x1C60, 1}, // Georgian
+	{0x1E00, 0x1E94, 1, 2}, {0x1EA0, 0x1EFE, 1, 2}, // Latin Extended Additional
+	{0x2C00, 0x2C2E, 48, 1}, // Glagolitic
+	{0xA640, 0xA66C, 1, 2}, {0xA680, 0xA69A, 1, 2}, // Cyrillic Extended-B
+	{0xFF21, 0xFF3A, 32, 1} // Fullwidth Latin
+};
+
+// Letters without case pairs
+static const uint32_t iuliia_alpha_ranges[][2] = {
+	{0xAA, 0xAA}, {0xB5, 0xB5}, {0xBA, 0xBA}, {0xDF, 0xDF}, {0x131, 0x131}, {0x138, 0x138}, {0x149, 0x149},
+	{0x17F, 0x1CC}, {0x1DD, 0x1DD}, {0x1F0, 0x1F3}, {0x1F6, 0x1F7}, {0x220, 0x221}, {0x234, 0x2C1}, // Latin
+	{0x2C6, 0x2D1}, {0x2E0, 0x2E4}, {0x2EC, 0x2EC}, {0x2EE, 0x2EE}, // Modifier letters
+	{0x370, 0x374}, {0x376, 0x377}, {0x37A, 0x37D}, {0x37F, 0x37F}, {0x390, 0x390}, {0x3B0, 0x3D7}, {0x3F0, 0x3F5}, {0x3F7, 0x3FF}, // Greek
+	{0x559, 0x559}, {0x560, 0x588}, // Armenian
+	{0x5D0, 0x5EA}, {0x5EF, 0x5F2}, // Hebrew
+	{0x620, 0x64A}, {0x66E, 0x66F}, {0x671, 0x6D3}, {0x6D5, 0x6D5}, {0x6FA, 0x6FC}, // Arabic
+	{0x904, 0x939}, {0x958, 0x961}, // Devanagari
+	{0xE01, 0xE30}, // Thai
+	{0x10C7, 0x10C7}, {0x10CD, 0x10CD}, {0x10D0, 0x10FF}, // Georgian
+	{0x1100, 0x11FF}, // Hangul Jamo
+	{0x1C80, 0x1C88}, // Cyrillic Extended-C
+	{0x1D00, 0x1DBF}, // Phonetic extensions
+	{0x1E96, 0x1E9F}, {0x1F00, 0x1FFC}, // Latin Extended Additional, Greek Extended
+	{0x2C2F, 0x2C5F}, {0x2C60, 0x2CE4}, // Glagolitic, Latin Extended-C, Coptic
+	{0x2D00, 0x2D25}, {0x2DE0, 0x2DFF}, // Georgian Supplement, Cyrillic Extended-A
+	{0x3041, 0x3096}, {0x30A1, 0x30FA}, {0x3105, 0x312F}, // Hiragana, Katakana, Bopomofo
+	{0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, // CJK
+	{0xA66D, 0xA66E}, {0xA67F, 0xA67F}, {0xA69B, 0xA69D}, {0xA722, 0xA7FF}, // Cyrillic Extended-B, Latin Extended-D
+	{0xAC00, 0xD7A3}, // Hangul
+	{0xF900, 0xFAFF}, {0xFB00, 0xFB06}, // CJK Compatibility, ligatures
+	{0xFF41, 0xFF5A}, {0xFF66, 0xFFDC} // Halfwidth and Fullwidth Forms
+};
+
+// Looks for case range, which contains upper or lower case character c
+static const iuliia_case_range_t *iuliiaIntFindCaseRange(uint32_t c, bool upper)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(iuliia_case_ranges)/sizeof(iuliia_case_range_t); i++) {
+		const iuliia_case_range_t *range;
+		uint32_t upper_c;
+
+		range = iuliia_case_ranges + i;
+		upper_c = upper ? c : c - (uint32_t)range->delta;
+		if(upper_c >= range->first && upper_c <= range->last && (upper_c - range->first) % range->stride == 0)
+			return range;
+	}
+
+	return 0;
+}
+
+// Case functions use own tables instead of towlower and others,
+// so translation doesn't depend on locale and can run in any thread
+uint32_t iuliiaU32ToLower(uint32_t c)
+{
+	const iuliia_case_range_t *range;
+
+	if(c < 128) {
+		if(c >= 'A' && c <= 'Z')
+			return c + 32;
+		else
+			return c;
+	} else if(c == 0x401) return 0x451;
+	else if(c >= 0x410 && c <= 0x44F) {
+		if(c <= 0x42F)
+			return c + 32;
+		else
+			return c;
+	}
+
+	range = iuliiaIntFindCaseRange(c, true);
+	if(range)
+		return c + (uint32_t)range->delta;
+	else
+		return c;
+}
+
+uint32_t iuliiaU32ToUpper(uint32_t c)
+{
+	const iuliia_case_range_t *range;
+
+	if(c < 128) {
+		if(c >= 'a' && c <= 'z')
+			return c - 32;
+		else
+			return c;
+	}
+
+	range = iuliiaIntFindCaseRange(c, false);
+	if(range)
+		return c - (uint32_t)range->delta;
+	else
+		return c;
+}
+
+int iuliiaU32IsUpper(uint32_t c)
+{
+	if(c >= 'A' && c <= 'Z')
+		return 1;
+	else if(c >= 0x410 && c <= 0x42F)
+		return 1;
+	else if(c < 128 || (c >= 0x430 && c <= 0x44F))
+		return 0;
+	else
+		return iuliiaIntFindCaseRange(c, true) != 0;
+}
+
+int iuliiaU32IsAlpha(uint32_t c) {
+	size_t i;
+
+	if(c < 128)
+		return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+	else if(c >= 0x400 && c <= 0x45F)
+		return 1;
+
+	if(iuliiaIntFindCaseRange(c, true) || iuliiaIntFindCaseRange(c, false)) return 1;
+
+	for(i = 0; i < sizeof(iuliia_alpha_ranges)/sizeof(iuliia_alpha_ranges[0]); i++)
+		if(c >= iuliia_alpha_ranges[i][0] && c <= iuliia_alpha_ranges[i][1]) return 1;
+
+	return 0;
+}
+
+typedef struct {
+	uint32_t c;
+	uint32_t mark;
+	uint32_t composed;
+} iuliia_composition_t;
+
+// Canonical compositions of Latin and Cyrillic letters with combining marks, sorted by character and mark
+static const iuliia_composition_t iuliia_compositions[] = {
+	{0x41, 0x300, 0xC0}, {0x41, 0x301, 0xC1}, {0x41, 0x302, 0xC2}, {0x41, 0x303, 0xC3},
+	{0x41, 0x304, 0x100}, {0x41, 0x306, 0x102}, {0x41, 0x307, 0x226}, {0x41, 0x308, 0xC4},
+	{0x41, 0x30A, 0xC5}, {0x41, 0x30C, 0x1CD}, {0x41, 0x30F, 0x200}, {0x41, 0x311, 0x202},
+	{0x41, 0x328, 0x104}, {0x43, 0x301, 0x106}, {0x43, 0x302, 0x108}, {0x43, 0x307, 0x10A},
+	{0x43, 0x30C, 0x10C}, {0x43, 0x327, 0xC7}, {0x44, 0x30C, 0x10E}, {0x45, 0x300, 0xC8},
+	{0x45, 0x301, 0xC9}, {0x45, 0x302, 0xCA}, {0x45, 0x304, 0x112}, {0x45, 0x306, 0x114},
+	{0x45, 0x307, 0x116}, {0x45, 0x308, 0xCB}, {0x45, 0x30C, 0x11A}, {0x45, 0x30F, 0x204},
+	{0x45, 0x311, 0x206}, {0x45, 0x327, 0x228}, {0x45, 0x328, 0x118}, {0x47, 0x301, 0x1F4},
+	{0x47, 0x302, 0x11C}, {0x47, 0x306, 0x11E}, {0x47, 0x307, 0x120}, {0x47, 0x30C, 0x1E6},
+	{0x47, 0x327, 0x122}, {0x48, 0x302, 0x124}, {0x48, 0x30C, 0x21E}, {0x49, 0x300, 0xCC},
+	{0x49, 0x301, 0xCD}, {0x49, 0x302, 0xCE}, {0x49, 0x303, 0x128}, {0x49, 0x304, 0x12A},
+	{0x49, 0x306, 0x12C}, {0x49, 0x307, 0x130}, {0x49, 0x308, 0xCF}, {0x49, 0x30C, 0x1CF},
+	{0x49, 0x30F, 0x208}, {0x49, 0x311, 0x20A}, {0x49, 0x328, 0x12E}, {0x4A, 0x302, 0x134},
+	{0x4B, 0x30C, 0x1E8}, {0x4B, 0x327, 0x136}, {0x4C, 0x301, 0x139}, {0x4C, 0x30C, 0x13D},
+	{0x4C, 0x327, 0x13B}, {0x4E, 0x300, 0x1F8}, {0x4E, 0x301, 0x143}, {0x4E, 0x303, 0xD1},
+	{0x4E, 0x30C, 0x147}, {0x4E, 0x327, 0x145}, {0x4F, 0x300, 0xD2}, {0x4F, 0x301, 0xD3},
+	{0x4F, 0x302, 0xD4}, {0x4F, 0x303, 0xD5}, {0x4F, 0x304, 0x14C}, {0x4F, 0x306, 0x14E},
+	{0x4F, 0x307, 0x22E}, {0x4F, 0x308, 0xD6}, {0x4F, 0x30B, 0x150}, {0x4F, 0x30C, 0x1D1},
+	{0x4F, 0x30F, 0x20C}, {0x4F, 0x311, 0x20E}, {0x4F, 0x31B, 0x1A0}, {0x4F, 0x328, 0x1EA},
+	{0x52, 0x301, 0x154}, {0x52, 0x30C, 0x158}, {0x52, 0x30F, 0x210}, {0x52, 0x311, 0x212},
+	{0x52, 0x327, 0x156}, {0x53, 0x301, 0x15A}, {0x53, 0x302, 0x15C}, {0x53, 0x30C, 0x160},
+	{0x53, 0x326, 0x218}, {0x53, 0x327, 0x15E}, {0x54, 0x30C, 0x164}, {0x54, 0x326, 0x21A},
+	{0x54, 0x327, 0x162}, {0x55, 0x300, 0xD9}, {0x55, 0x301, 0xDA}, {0x55, 0x302, 0xDB},
+	{0x55, 0x303, 0x168}, {0x55, 0x304, 0x16A}, {0x55, 0x306, 0x16C}, {0x55, 0x308, 0xDC},
+	{0x55, 0x30A, 0x16E}, {0x55, 0x30B, 0x170}, {0x55, 0x30C, 0x1D3}, {0x55, 0x30F, 0x214},
+	{0x55, 0x311, 0x216}, {0x55, 0x31B, 0x1AF}, {0x55, 0x328, 0x172}, {0x57, 0x302, 0x174},
+	{0x59, 0x301, 0xDD}, {0x59, 0x302, 0x176}, {0x59, 0x304, 0x232}, {0x59, 0x308, 0x178},
+	{0x5A, 0x301, 0x179}, {0x5A, 0x307, 0x17B}, {0x5A, 0x30C, 0x17D}, {0x61, 0x300, 0xE0},
+	{0x61, 0x301, 0xE1}, {0x61, 0x302, 0xE2}, {0x61, 0x303, 0xE3}, {0x61, 0x304, 0x101},
+	{0x61, 0x306, 0x103}, {0x61, 0x307, 0x227}, {0x61, 0x308, 0xE4}, {0x61, 0x30A, 0xE5},
+	{0x61, 0x30C, 0x1CE}, {0x61, 0x30F, 0x201}, {0x61, 0x311, 0x203}, {0x61, 0x328, 0x105},
+	{0x63, 0x301, 0x107}, {0x63, 0x302, 0x109}, {0x63, 0x307, 0x10B}, {0x63, 0x30C, 0x10D},
+	{0x63, 0x327, 0xE7}, {0x64, 0x30C, 0x10F}, {0x65, 0x300, 0xE8}, {0x65, 0x301, 0xE9},
+	{0x65, 0x302, 0xEA}, {0x65, 0x304, 0x113}, {0x65, 0x306, 0x115}, {0x65, 0x307, 0x117},
+	{0x65, 0x308, 0xEB}, {0x65, 0x30C, 0x11B}, {0x65, 0x30F, 0x205}, {0x65, 0x311, 0x207},
+	{0x65, 0x327, 0x229}, {0x65, 0x328, 0x119}, {0x67, 0x301, 0x1F5}, {0x67, 0x302, 0x11D},
+	{0x67, 0x306, 0x11F}, {0x67, 0x307, 0x121}, {0x67, 0x30C, 0x1E7}, {0x67, 0x327, 0x123},
+	{0x68, 0x302, 0x125}, {0x68, 0x30C, 0x21F}, {0x69, 0x300, 0xEC}, {0x69, 0x301, 0xED},
+	{0x69, 0x302, 0xEE}, {0x69, 0x303, 0x129}, {0x69, 0x304, 0x12B}, {0x69, 0x306, 0x12D},
+	{0x69, 0x308, 0xEF}, {0x69, 0x30C, 0x1D0}, {0x69, 0x30F, 0x209}, {0x69, 0x311, 0x20B},
+	{0x69, 0x328, 0x12F}, {0x6A, 0x302, 0x135}, {0x6A, 0x30C, 0x1F0}, {0x6B, 0x30C, 0x1E9},
+	{0x6B, 0x327, 0x137}, {0x6C, 0x301, 0x13A}, {0x6C, 0x30C, 0x13E}, {0x6C, 0x327, 0x13C},
+	{0x6E, 0x300, 0x1F9}, {0x6E, 0x301, 0x144}, {0x6E, 0x303, 0xF1}, {0x6E, 0x30C, 0x148},
+	{0x6E, 0x327, 0x146}, {0x6F, 0x300, 0xF2}, {0x6F, 0x301, 0xF3}, {0x6F, 0x302, 0xF4},
+	{0x6F, 0x303, 0xF5}, {0x6F, 0x304, 0x14D}, {0x6F, 0x306, 0x14F}, {0x6F, 0x307, 0x22F},
+	{0x6F, 0x308, 0xF6}, {0x6F, 0x30B, 0x151}, {0x6F, 0x30C, 0x1D2}, {0x6F, 0x30F, 0x20D},
+	{0x6F, 0x311, 0x20F}, {0x6F, 0x31B, 0x1A1}, {0x6F, 0x328, 0x1EB}, {0x72, 0x301, 0x155},
+	{0x72, 0x30C, 0x159}, {0x72, 0x30F, 0x211}, {0x72, 0x311, 0x213}, {0x72, 0x327, 0x157},
+	{0x73, 0x301, 0x15B}, {0x73, 0x302, 0x15D}, {0x73, 0x30C, 0x161}, {0x73, 0x326, 0x219},
+	{0x73, 0x327, 0x15F}, {0x74, 0x30C, 0x165}, {0x74, 0x326, 0x21B}, {0x74, 0x327, 0x163},
+	{0x75, 0x300, 0xF9}, {0x75, 0x301, 0xFA}, {0x75, 0x302, 0xFB}, {0x75, 0x303, 0x169},
+	{0x75, 0x304, 0x16B}, {0x75, 0x306, 0x16D}, {0x75, 0x308, 0xFC}, {0x75, 0x30A, 0x16F},
+	{0x75, 0x30B, 0x171}, {0x75, 0x30C, 0x1D4}, {0x75, 0x30F, 0x215}, {0x75, 0x311, 0x217},
+	{0x75, 0x31B, 0x1B0}, {0x75, 0x328, 0x173}, {0x77, 0x302, 0x175}, {0x79, 0x301, 0xFD},
+	{0x79, 0x302, 0x177}, {0x79, 0x304, 0x233}, {0x79, 0x308, 0xFF}, {0x7A, 0x301, 0x17A},
+	{0x7A, 0x307, 0x17C}, {0x7A, 0x30C, 0x17E}, {0xC4, 0x304, 0x1DE}, {0xC5, 0x301, 0x1FA},
+	{0xC6, 0x301, 0x1FC}, {0xC6, 0x304, 0x1E2}, {0xD5, 0x304, 0x22C}, {0xD6, 0x304, 0x22A},
+	{0xD8, 0x301, 0x1FE}, {0xDC, 0x300, 0x1DB}, {0xDC, 0x301, 0x1D7}, {0xDC, 0x304, 0x1D5},
+	{0xDC, 0x30C, 0x1D9}, {0xE4, 0x304, 0x1DF}, {0xE5, 0x301, 0x1FB}, {0xE6, 0x301, 0x1FD},
+	{0xE6, 0x304, 0x1E3}, {0xF5, 0x304, 0x22D}, {0xF6, 0x304, 0x22B}, {0xF8, 0x301, 0x1FF},
+	{0xFC, 0x300, 0x1DC}, {0xFC, 0x301, 0x1D8}, {0xFC, 0x304, 0x1D6}, {0xFC, 0x30C, 0x1DA},
+	{0x1B7, 0x30C, 0x1EE}, {0x1EA, 0x304, 0x1EC}, {0x1EB, 0x304, 0x1ED}, {0x226, 0x304, 0x1E0},
+	{0x227, 0x304, 0x1E1}, {0x22E, 0x304, 0x230}, {0x22F, 0x304, 0x231}, {0x292, 0x30C, 0x1EF},
+	{0x406, 0x308, 0x407}, {0x410, 0x306, 0x4D0}, {0x410, 0x308, 0x4D2}, {0x413, 0x301, 0x403},
+	{0x415, 0x300, 0x400}, {0x415, 0x306, 0x4D6}, {0x415, 0x308, 0x401}, {0x416, 0x306, 0x4C1},
+	{0x416, 0x308, 0x4DC}, {0x417, 0x308, 0x4DE}, {0x418, 0x300, 0x40D}, {0x418, 0x304, 0x4E2},
+	{0x418, 0x306, 0x419}, {0x418, 0x308, 0x4E4}, {0x41A, 0x301, 0x40C}, {0x41E, 0x308, 0x4E6},
+	{0x423, 0x304, 0x4EE}, {0x423, 0x306, 0x40E}, {0x423, 0x308, 0x4F0}, {0x423, 0x30B, 0x4F2},
+	{0x427, 0x308, 0x4F4}, {0x42B, 0x308, 0x4F8}, {0x42D, 0x308, 0x4EC}, {0x430, 0x306, 0x4D1},
+	{0x430, 0x308, 0x4D3}, {0x433, 0x301, 0x453}, {0x435, 0x300, 0x450}, {0x435, 0x306, 0x4D7},
+	{0x435, 0x308, 0x451}, {0x436, 0x306, 0x4C2}, {0x436, 0x308, 0x4DD}, {0x437, 0x308, 0x4DF},
+	{0x438, 0x300, 0x45D}, {0x438, 0x304, 0x4E3}, {0x438, 0x306, 0x439}, {0x438, 0x308, 0x4E5},
+	{0x43A, 0x301, 0x45C}, {0x43E, 0x308, 0x4E7}, {0x443, 0x304, 0x4EF}, {0x443, 0x306, 0x45E},
+	{0x443, 0x308, 0x4F1}, {0x443, 0x30B, 0x4F3}, {0x447, 0x308, 0x4F5}, {0x44B, 0x308, 0x4F9},
+	{0x44D, 0x308, 0x4ED}, {0x456, 0x308, 0x457}, {0x474, 0x30F, 0x476}, {0x475, 0x30F, 0x477},
+	{0x4D8, 0x308, 0x4DA}, {0x4D9, 0x308, 0x4DB}, {0x4E8, 0x308, 0x4EA}, {0x4E9, 0x308, 0x4EB}
+};
+
+#define iuliiaIntIsCombiningMark(c) ((c) >= 0x300 && (c) <= 0x36F)
+
+// Returns character s[0] composed with following combining marks and sets number of used characters
+static uint32_t iuliiaIntComposeChar(const uint32_t *s, size_t *used)
+{
+	uint32_t c;
+
+	c = s[0];
+	*used = 1;
+	if(!c) return c;
+
+	while(iuliiaIntIsCombiningMark(s[*used])) {
+		size_t start, end;
+		uint64_t searching_c;
+		bool is_found = false;
+
+		searching_c = ((uint64_t)c << 32) + s[*used];
+		start = 0;
+		end = sizeof(iuliia_compositions)/sizeof(iuliia_composition_t);
+		while(start < end) {
+			size_t mid;
+			uint64_t founded_c;
+
+			mid = (start + end) / 2;
+			founded_c = ((uint64_t)iuliia_compositions[mid].c << 32) + iuliia_compositions[mid].mark;
+			if(founded_c == searching_c) {
+				c = iuliia_compositions[mid].composed;
+				is_found = true;
+				break;
+			} else if(founded_c < searching_c)
+				start = mid + 1;
+			else
+				end = mid;
+		}
+		if(!is_found) break;
+
+		(*used)++;
+	}
+
+	return c;
+}
+
+static uint32_t *iuliiaBsearch1char(uint32_t c, const iuliia_mapping_1char_t *mapping, size_t size)
+{
+	size_t start, end;
+
+	if(!size) return 0;
+	if(SIZE_MAX/2 < size) return 0;
+
+	start = 0;
+	end = size - 1;
+
+	while(start <= end) {
+		size_t mid;
+
+		mid = (end + start) / 2;
+		if(mapping[mid].c == c)
+			return mapping[mid].repl;
+		else if(mapping[mid].c < c)
+			start = mid + 1;
+		else if(mid > 0) // mapping[mid].c > c
+			end = mid - 1;
+		else
+			break;
+	}
+
+	return 0;
+}
+
+static uint32_t *iuliiaBsearch2char(uint32_t c, uint32_t cor_c, const iuliia_mapping_2char_t *mapping, size_t size)
+{
+	size_t start, end;
+	uint64_t searching_c;
+
+	if(!size) return 0;
+	if(SIZE_MAX/2 < size) return 0;
+
+	start = 0;
+	end = size - 1;
+
+	searching_c = ((uint64_t)c << 32) + cor_c;
+
+	while (start <= end) {
+		uint64_t founded_c;
+		size_t mid;
+
+		mid = (end + start) / 2;
+		founded_c = ((uint64_t)mapping[mid].c << 32) + mapping[mid].cor_c;
+		if(founded_c == searching_c) {
+			return mapping[mid].repl;
+		} else if(founded_c < searching_c)
+			start = mid + 1; 
+		else if(mid > 0) // founded_c > searching_c
+			end = mid - 1;
+		else
+			break;
+	}
+
+	return 0;
+}
+
+// Looks for rule in scheme and then in schemes it overlays
+static uint32_t *iuliiaIntFind1char(uint32_t c, const iuliia_scheme_t *scheme)
+{
+	do {
+		uint32_t *repl;
+
+		repl = iuliiaBsearch1char(c, scheme->mapping, scheme->nof_mapping);
+		if(repl) return repl;
+
+		scheme = scheme->base;
+	} while(scheme);
+
+	return 0;
+}
+
+static uint32_t *iuliiaIntFind2char(uint32_t c, uint32_t cor_c, const iuliia_scheme_t *scheme, int table)
+{
+	do {
+		uint32_t *repl;
+
+		if(table == IULIIA_TABLE_PREV)
+			repl = iuliiaBsearch2char(c, cor_c, scheme->prev_mapping, scheme->nof_prev_mapping);
+		else if(table == IULIIA_TABLE_NEXT)
+			repl = iuliiaBsearch2char(c, cor_c, scheme->next_mapping, scheme->nof_next_mapping);
+		else
+			repl = iuliiaBsearch2char(c, cor_c, scheme->ending_mapping, scheme->nof_ending_mapping);
+		if(repl) return repl;
+
+		scheme = scheme->base;
+	} while(scheme);
+
+	return 0;
+}
+
+// JIT makes native x86-64 code, which finds rules of prepared scheme. Define IULIIA_NO_JIT to turn it off
+#if !defined(IULIIA_NO_JIT) && (defined(__x86_64__) || defined(_M_X64))
+#define IULIIA_JIT
+#endif
+
+typedef const uint32_t *(*iuliia_jit_rules_t)(uint32_t c, uint32_t prev_s, uint32_t next_s);
+typedef const uint32_t *(*iuliia_jit_ending_t)(uint32_t c, uint32_t next_s);
+
+typedef struct {
+	void *code;
+	size_t size;
+	iuliia_jit_rules_t rules; // Previous, next and direct mapping rules in order of translation loop
+	iuliia_jit_ending_t ending; // 0 if scheme has no word endings
+} iuliia_jit_t;
+
+#if defined(IULIIA_JIT)
+
+#define IULIIA_JIT_MAX_GAP 16 // Characters, which are nearer than this, are dispatched by one jump table
+#define IULIIA_JIT_MAX_TABLE 4096 // Maximal number of entries in jump table
+#define IULIIA_JIT_MIN_TABLE 4 // Fewer characters are dispatched by comparisons
+
+// Registers of arguments
+#if defined(_WIN32) || defined(__CYGWIN__)
+#define IULIIA_JIT_ARG1 1 // ecx
+#define IULIIA_JIT_ARG2 2 // edx
+#define IULIIA_JIT_ARG3 8 // r8d
+#else
+#define IULIIA_JIT_ARG1 7 // edi
+#define IULIIA_JIT_ARG2 6 // esi
+#define IULIIA_JIT_ARG3 2 // edx
+#endif
+
+typedef struct {
+	size_t at; // Offset of rel32 field
+	size_t label;
+} iuliia_jit_fixup_t;
+
+typedef struct {
+	uint8_t *code;
+	size_t len;
+	size_t max_len;
+	bool failed;
+	size_t *labels;
+	iuliia_jit_fixup_t *fixups;
+	size_t nof_fixups;
+	size_t max_fixups;
+} iuliia_jit_buffer_t;
+
+// Rules of one kind, which are compared with given argument
+typedef struct {
+	const iuliia_mapping_2char_t *mapping;
+	size_t nof_mapping;
+	int reg;
+} iuliia_jit_check_t;
+
+static void iuliiaIntJitEmit(iuliia_jit_buffer_t *buf, const uint8_t *bytes, size_t n)
+{
+	if(buf->failed) return;
+
+	while(buf->max_len - buf->len < n) {
+		if(!iuliiaIntGrowArray((void **)&(buf->code), &(buf->max_len), buf->max_len, 1)) {
+			buf->failed = true;
+
+			return;
+		}
+	}
+
+	memcpy(buf->code + buf->len, bytes, n);
+	buf->len += n;
+}
+
+static void iuliiaIntJitEmit32(iuliia_jit_buffer_t *buf, uint32_t v)
+{
+	uint8_t bytes[4];
+
+	bytes[0] = (uint8_t)v;
+	bytes[1] = (uint8_t)(v >> 8);
+	bytes[2] = (uint8_t)(v >> 16);
+	bytes[3] = (uint8_t)(v >> 24);
+	iuliiaIntJitEmit(buf, bytes, 4);
+}
+
+// Emits rel32 field, which is filled when label is known
+static void iuliiaIntJitEmitRel32(iuliia_jit_buffer_t *buf, size_t label)
+{
+	if(buf->failed) return;
+
+	if(!iuliiaIntGrowArray((void **)&(buf->fixups), &(buf->max_fixups), buf->nof_fixups, sizeof(iuliia_jit_fixup_t))) {
+		buf->failed = true;
+
+		return;
+	}
+
+	buf->fixups[buf->nof_fixups].at = buf->len;
+	buf->fixups[buf->nof_fixups].label = label;
+	buf->nof_fixups++;
+	iuliiaIntJitEmit32(buf, 0);
+}
+
+// mov rax, repl; ret or xor eax, eax; ret
+static void iuliiaIntJitEmitReturn(iuliia_jit_buffer_t *buf, const uint32_t *repl)
+{
+	static const uint8_t ret_zero[] = { 0x31, 0xc0, 0xc3 };
+	uint8_t bytes[11];
+	uint64_t v;
+	int i;
+
+	if(!repl) {
+		iuliiaIntJitEmit(buf, ret_zero, sizeof(ret_zero));
+
+		return;
+	}
+
+	v = (uint64_t)(uintptr_t)repl;
+	bytes[0] = 0x48;
+	bytes[1] = 0xb8;
+	for(i = 0; i < 8; i++) bytes[2+i] = (uint8_t)(v >> (8*i));
+	bytes[10] = 0xc3;
+	iuliiaIntJitEmit(buf, bytes, sizeof(bytes));
+}
+
+// cmp reg32, imm32
+static void iuliiaIntJitEmitCmp(iuliia_jit_buffer_t *buf, int reg, uint32_t v)
+{
+	uint8_t bytes[3];
+	size_t n = 0;
+
+	if(reg >= 8) bytes[n++] = 0x41;
+	bytes[n++] = 0x81;
+	bytes[n++] = (uint8_t)(0xf8 | (reg & 7));
+	iuliiaIntJitEmit(buf, bytes, n);
+	iuliiaIntJitEmit32(buf, v);
+}
+
+// mov eax, reg32
+static void iuliiaIntJitEmitMovEax(iuliia_jit_buffer_t *buf, int reg)
+{
+	uint8_t bytes[3];
+	size_t n = 0;
+
+	if(reg >= 8) bytes[n++] = 0x44;
+	bytes[n++] = 0x89;
+	bytes[n++] = (uint8_t)(0xc0 | ((reg & 7) << 3));
+	iuliiaIntJitEmit(buf, bytes, n);
+}
+
+static int iuliiaIntCompareU32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// Emits function, which dispatches on character in first argument and checks rules of this character
+static bool iuliiaIntJitEmitFunction(iuliia_jit_buffer_t *buf, const iuliia_jit_check_t *checks, size_t nof_checks, const iuliia_mapping_1char_t *mapping, size_t nof_mapping)
+{
+	static const uint8_t jump_table[] = {
+		0x49, 0x63, 0x04, 0x83, // movsxd rax, dword [r11+rax*4]
+		0x4c, 0x01, 0xd8, // add rax, r11
+		0xff, 0xe0 // jmp rax
+	};
+	uint32_t *chars, c;
+	size_t nof_chars = 0, cursors[2] = { 0, 0 }, *tables, nof_tables = 0, none, start, i, j, k;
+
+	start = buf->len;
+	buf->nof_fixups = 0;
+
+	// Characters, which have rules
+	k = nof_mapping;
+	for(i = 0; i < nof_checks; i++) k += checks[i].nof_mapping;
+	if(!k) {
+		iuliiaIntJitEmitReturn(buf, 0);
+
+		return !buf->failed;
+	}
+	if(SIZE_MAX/sizeof(size_t)/3 < k) return false;
+
+	chars = malloc(k*sizeof(uint32_t));
+	tables = malloc(2*k*sizeof(size_t));
+	buf->labels = malloc((2*k+1)*sizeof(size_t));
+	if(!chars || !tables || !buf->labels) goto IULIIA_ERROR;
+
+	for(i = 0; i < nof_mapping; i++) chars[nof_chars++] = mapping[i].c;
+	for(i = 0; i < nof_checks; i++)
+		for(j = 0; j < checks[i].nof_mapping; j++) chars[nof_chars++] = checks[i].mapping[j].c;
+
+	qsort(chars, nof_chars, sizeof(uint32_t), iuliiaIntCompareU32);
+	k = 0;
+	for(i = 0; i < nof_chars; i++)
+		if(!i || chars[i] != chars[i-1]) chars[k++] = chars[i];
+	nof_chars = k;
+
+	// Labels: blocks of characters, return of 0, jump tables
+	none = nof_chars;
+
+	// Dispatch. Near characters are found by jump table, other ones by comparisons
+	for(i = 0; i < nof_chars; i = j) {
+		j = i+1;
+		while(j < nof_chars && chars[j] - chars[j-1] <= IULIIA_JIT_MAX_GAP && chars[j] - chars[i] < IULIIA_JIT_MAX_TABLE) j++;
+
+		if(j - i >= IULIIA_JIT_MIN_TABLE) {
+			uint8_t bytes[2];
+
+			iuliiaIntJitEmitMovEax(buf, IULIIA_JIT_ARG1);
+			bytes[0] = 0x2d; // sub eax, first
+			iuliiaIntJitEmit(buf, bytes, 1);
+			iuliiaIntJitEmit32(buf, chars[i]);
+			bytes[0] = 0x3d; // cmp eax, last-first
+			iuliiaIntJitEmit(buf, bytes, 1);
+			iuliiaIntJitEmit32(buf, chars[j-1] - chars[i]);
+			bytes[0] = 0x77; // ja over jump
+			bytes[1] = 7 + sizeof(jump_table);
+			iuliiaIntJitEmit(buf, bytes, 2);
+			bytes[0] = 0x4c; // lea r11, [rip+table]
+			bytes[1] = 0x8d;
+			iuliiaIntJitEmit(buf, bytes, 2);
+			bytes[0] = 0x1d;
+			iuliiaIntJitEmit(buf, bytes, 1);
+			iuliiaIntJitEmitRel32(buf, none+1+nof_tables);
+			iuliiaIntJitEmit(buf, jump_table, sizeof(jump_table));
+
+			tables[2*nof_tables] = i;
+			tables[2*nof_tables+1] = j;
+			nof_tables++;
+		} else {
+			for(k = i; k < j; k++) {
+				static const uint8_t je[] = { 0x0f, 0x84 };
+
+				iuliiaIntJitEmitCmp(buf, IULIIA_JIT_ARG1, chars[k]);
+				iuliiaIntJitEmit(buf, je, sizeof(je));
+				iuliiaIntJitEmitRel32(buf, k);
+			}
+		}
+	}
+	buf->labels[none] = buf->len - start;
+	iuliiaIntJitEmitReturn(buf, 0);
+
+	// Blocks of characters. Rules are sorted, so every kind of rules is walked once
+	for(i = 0; i < nof_chars; i++) {
+		buf->labels[i] = buf->len - start;
+
+		for(j = 0; j < nof_checks; j++) {
+			const iuliia_mapping_2char_t *m = checks[j].mapping;
+
+			while(cursors[j] < checks[j].nof_mapping && m[cursors[j]].c < chars[i]) cursors[j]++;
+			for(; cursors[j] < checks[j].nof_mapping && m[cursors[j]].c == chars[i]; cursors[j]++) {
+				static const uint8_t jne[] = { 0x75, 11 };
+
+				iuliiaIntJitEmitCmp(buf, checks[j].reg, m[cursors[j]].cor_c);
+				iuliiaIntJitEmit(buf, jne, sizeof(jne));
+				iuliiaIntJitEmitReturn(buf, m[cursors[j]].repl);
+			}
+		}
+
+		iuliiaIntJitEmitReturn(buf, nof_mapping ? iuliiaBsearch1char(chars[i], mapping, nof_mapping) : 0);
+	}
+
+	// Jump tables have offsets of blocks from table start
+	for(i = 0; i < nof_tables; i++) {
+		size_t table_start;
+
+		table_start = buf->len - start;
+		buf->labels[none+1+i] = table_start;
+
+		k = tables[2*i];
+		for(c = chars[k]; k < tables[2*i+1]; c++) {
+			if(c == chars[k]) {
+				iuliiaIntJitEmit32(buf, (uint32_t)(buf->labels[k] - table_start));
+				k++;
+			} else
+				iuliiaIntJitEmit32(buf, (uint32_t)(buf->labels[none] - table_start));
+		}
+	}
+
+	if(buf->failed) goto IULIIA_ERROR;
+
+	for(i = 0; i < buf->nof_fixups; i++) {
+		uint8_t *field;
+		uint32_t rel;
+
+		field = buf->code + buf->fixups[i].at;
+		rel = (uint32_t)(start + buf->labels[buf->fixups[i].label] - (buf->fixups[i].at + 4));
+		field[0] = (uint8_t)rel;
+		field[1] = (uint8_t)(rel >> 8);
+		field[2] = (uint8_t)(rel >> 16);
+		field[3] = (uint8_t)(rel >> 24);
+	}
+
+	free(chars);
+	free(tables);
+	free(buf->labels);
+	buf->labels = 0;
+
+	return true;
+
+IULIIA_ERROR:
+
+	free(chars);
+	free(tables);
+	free(buf->labels);
+	buf->labels = 0;
+
+	return false;
+}
+
+#endif
+
+// Makes native code for scheme without base or returns 0, if it's not possible
+static void *iuliiaIntJitCompile(const iuliia_scheme_t *scheme)
+{
+#if defined(IULIIA_JIT)
+	iuliia_jit_buffer_t buf;
+	iuliia_jit_check_t checks[2];
+	iuliia_jit_t *jit = 0;
+	size_t nof_checks = 0, ending_start = 0;
+#if defined(_WIN32)
+	DWORD old_protect;
+#endif
+
+	// Code has addresses of replacements of this scheme only. Patterns are found by trie
+	if(scheme->base || !scheme->mapping || scheme->nof_pattern_mapping) return 0;
+
+	memset(&buf, 0, sizeof(iuliia_jit_buffer_t));
+
+	if(scheme->prev_mapping && scheme->nof_prev_mapping) {
+		checks[nof_checks].mapping = scheme->prev_mapping;
+		checks[nof_checks].nof_mapping = scheme->nof_prev_mapping;
+		checks[nof_checks].reg = IULIIA_JIT_ARG2;
+		nof_checks++;
+	}
+	if(scheme->next_mapping && scheme->nof_next_mapping) {
+		checks[nof_checks].mapping = scheme->next_mapping;
+		checks[nof_checks].nof_mapping = scheme->nof_next_mapping;
+		checks[nof_checks].reg = IULIIA_JIT_ARG3;
+		nof_checks++;
+	}
+	if(!iuliiaIntJitEmitFunction(&buf, checks, nof_checks, scheme->mapping, scheme->nof_mapping)) goto IULIIA_ERROR;
+
+	if(scheme->ending_mapping && scheme->nof_ending_mapping) {
+		ending_start = buf.len;
+		checks[0].mapping = scheme->ending_mapping;
+		checks[0].nof_mapping = scheme->nof_ending_mapping;
+		checks[0].reg = IULIIA_JIT_ARG2;
+		if(!iuliiaIntJitEmitFunction(&buf, checks, 1, 0, 0)) goto IULIIA_ERROR;
+	}
+
+	jit = malloc(sizeof(iuliia_jit_t));
+	if(!jit) goto IULIIA_ERROR;
+	jit->size = buf.len;
+
+	// Memory is never writable and executable at once
+#if defined(_WIN32)
+	jit->code = VirtualAlloc(0, buf.len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if(!jit->code) goto IULIIA_ERROR;
+	memcpy(jit->code, buf.code, buf.len);
+	if(!VirtualProtect(jit->code, buf.len, PAGE_EXECUTE_READ, &old_protect)) {
+		VirtualFree(jit->code, 0, MEM_RELEASE);
+		goto IULIIA_ERROR;
+	}
+	FlushInstructionCache(GetCurrentProcess(), jit->code, buf.len);
+#else
+	jit->code = mmap(0, buf.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(jit->code == MAP_FAILED) goto IULIIA_ERROR;
+	memcpy(jit->code, buf.code, buf.len);
+	if(mprotect(jit->code, buf.len, PROT_READ | PROT_EXEC)) {
+		munmap(jit->code, buf.len);
+		goto IULIIA_ERROR;
+	}
+#endif
+
+	jit->rules = (iuliia_jit_rules_t)jit->code;
+	jit->ending = ending_start ? (iuliia_jit_ending_t)((uint8_t *)jit->code + ending_start) : 0;
+
+	free(buf.code);
+	free(buf.fixups);
+
+	return jit;
+
+IULIIA_ERROR:
+
+	free(jit);
+	free(buf.code);
+	free(buf.fixups);
+
+	return 0;
+#else
+	(void)scheme;
+
+	return 0;
+#endif
+}
+
+static void iuliiaIntJitFree(void *jit_ptr)
+{
+#if defined(IULIIA_JIT)
+	iuliia_jit_t *jit = jit_ptr;
+
+#if defined(_WIN32)
+	VirtualFree(jit->code, 0, MEM_RELEASE);
+#else
+	munmap(jit->code, jit->size);
+#endif
+	free(jit);
+#else
+	(void)jit_ptr;
+#endif
+}
+
+
+// Transducer over classes of characters. Characters, which behave identically in all rules,
+// are collapsed into one class. State is behaviour of previous character for prev_mapping
+#define IULIIA_FST_MAX_CLASSES 255
+#define IULIIA_FST_MAX_RANGE 0x10000 // Characters below range are classified by table
+#define IULIIA_FST_MIN_RANGE 0x80
+#define IULIIA_FST_NEXT 0x8000 // Action is row of next actions
+#define IULIIA_FST_MAX_REPLS 0x7fff
+#define IULIIA_FST_NO_CHAR 0xffffffff // Representative of classes of characters without rules
+#define IULIIA_FST_SEPARATOR 0xfffffffe // Separates parts of signature
+
+typedef struct {
+	uint32_t range;
+	size_t nof_classes;
+	uint8_t other_alpha; // Classes of characters above range without rules
+	uint8_t other_nonalpha;
+	uint8_t start_state; // State at start of text
+	uint8_t *classes; // Class of every character below range
+	uint8_t *alpha; // Class is letters
+	uint8_t *states; // State after character of class
+	uint16_t *ending_rows; // Row of ending actions + 1 or 0, if class has no word endings
+	uint16_t *actions; // Replacement or row of next actions for state and class
+	uint16_t *next_actions; // Replacement for class of next character
+	uint16_t *ending_actions; // Replacement of word ending for class of next character or 0
+	const uint32_t **repls; // Replacements, 0 - character is copied
+} iuliia_fst_t;
+
+typedef struct {
+	uint32_t c;
+	size_t sig; // Offset of signature in pool, then pointer
+	size_t sig_len;
+	const uint32_t *sig_ptr;
+	size_t cls;
+} iuliia_fst_char_t;
+
+typedef struct {
+	const uint32_t **repls;
+	size_t nof_repls;
+	size_t max_repls;
+	uint32_t *pool;
+	size_t pool_len;
+	size_t max_pool;
+	bool failed;
+} iuliia_fst_builder_t;
+
+static void iuliiaIntFstFree(void *fst_ptr)
+{
+	iuliia_fst_t *fst = fst_ptr;
+
+	free(fst->classes);
+	free(fst->alpha);
+	free(fst->states);
+	free(fst->ending_rows);
+	free(fst->actions);
+	free(fst->next_actions);
+	free(fst->ending_actions);
+	free((void *)fst->repls);
+	free(fst);
+}
+
+static unsigned int iuliiaIntFstClass(const iuliia_fst_t *fst, uint32_t c)
+{
+	if(c < fst->range) return fst->classes[c];
+
+	c = iuliiaU32ToLower(c);
+	if(c < fst->range) return fst->classes[c];
+
+	return iuliiaU32IsAlpha(c) ? fst->other_alpha : fst->other_nonalpha;
+}
+
+// Replacements with the same text have the same number
+static uint16_t iuliiaIntFstReplId(iuliia_fst_builder_t *builder, const uint32_t *repl)
+{
+	size_t i;
+
+	if(!repl) return 0;
+
+	for(i = 1; i < builder->nof_repls; i++) {
+		const uint32_t *a = builder->repls[i], *b = repl;
+
+		while(*a && *a == *b) {
+			a++;
+			b++;
+		}
+		if(*a == *b) return (uint16_t)i;
+	}
+
+	if(builder->nof_repls > IULIIA_FST_MAX_REPLS || !iuliiaIntGrowArray((void **)&(builder->repls), &(builder->max_repls), builder->nof_repls, sizeof(uint32_t *))) {
+		builder->failed = true;
+
+		return 0;
+	}
+	builder->repls[builder->nof_repls] = repl;
+
+	return (uint16_t)builder->nof_repls++;
+}
+
+static void iuliiaIntFstPut(iuliia_fst_builder_t *builder, uint32_t v)
+{
+	if(builder->failed) return;
+
+	if(!iuliiaIntGrowArray((void **)&(builder->pool), &(builder->max_pool), builder->pool_len, sizeof(uint32_t))) {
+		builder->failed = true;
+
+		return;
+	}
+	builder->pool[builder->pool_len++] = v;
+}
+
+// Signature lists everything, what rules do with character. Characters with equal signatures are replaceable
+static void iuliiaIntFstPutSignature(iuliia_fst_builder_t *builder, const iuliia_scheme_t *scheme, uint32_t c, bool alpha)
+{
+	const iuliia_mapping_2char_t *tables[3];
+	size_t nof_tables[3], i, j;
+
+	tables[0] = scheme->prev_mapping;
+	nof_tables[0] = scheme->prev_mapping ? scheme->nof_prev_mapping : 0;
+	tables[1] = scheme->next_mapping;
+	nof_tables[1] = scheme->next_mapping ? scheme->nof_next_mapping : 0;
+	tables[2] = scheme->ending_mapping;
+	nof_tables[2] = scheme->ending_mapping ? scheme->nof_ending_mapping : 0;
+
+	iuliiaIntFstPut(builder, alpha);
+	iuliiaIntFstPut(builder, iuliiaIntFstReplId(builder, iuliiaBsearch1char(c, scheme->mapping, scheme->nof_mapping)));
+
+	for(i = 0; i < 3; i++) {
+		iuliiaIntFstPut(builder, IULIIA_FST_SEPARATOR);
+		for(j = 0; j < nof_tables[i]; j++) {
+			if(tables[i][j].c != c) continue;
+
+			iuliiaIntFstPut(builder, tables[i][j].cor_c);
+			iuliiaIntFstPut(builder, iuliiaIntFstReplId(builder, tables[i][j].repl));
+		}
+
+		iuliiaIntFstPut(builder, IULIIA_FST_SEPARATOR);
+		for(j = 0; j < nof_tables[i]; j++) {
+			if(tables[i][j].cor_c != c) continue;
+
+			iuliiaIntFstPut(builder, tables[i][j].c);
+			iuliiaIntFstPut(builder, iuliiaIntFstReplId(builder, tables[i][j].repl));
+		}
+	}
+}
+
+static int iuliiaIntFstCompareChars(const void *a, const void *b)
+{
+	uint32_t x = ((const iuliia_fst_char_t *)a)->c, y = ((const iuliia_fst_char_t *)b)->c;
+
+	return x < y ? -1 : x > y;
+}
+
+static bool iuliiaIntFstSameSignature(const iuliia_fst_char_t *a, const iuliia_fst_char_t *b)
+{
+	return a->sig_len == b->sig_len && memcmp(a->sig_ptr, b->sig_ptr, a->sig_len*sizeof(uint32_t)) == 0;
+}
+
+static int iuliiaIntFstCompareSignatures(const void *a, const void *b)
+{
+	const iuliia_fst_char_t *x = a, *y = b;
+	size_t i;
+
+	if(x->sig_len != y->sig_len) return x->sig_len < y->sig_len ? -1 : 1;
+	for(i = 0; i < x->sig_len; i++)
+		if(x->sig_ptr[i] != y->sig_ptr[i]) return x->sig_ptr[i] < y->sig_ptr[i] ? -1 : 1;
+
+	// First character of class is its representative
+	return iuliiaIntFstCompareChars(a, b);
+}
+
+// Characters a and b before character give the same replacements
+static bool iuliiaIntFstSamePrev(iuliia_fst_builder_t *builder, const iuliia_scheme_t *scheme, uint32_t a, uint32_t b)
+{
+	size_t i, count_a = 0, count_b = 0;
+
+	if(a == b || !scheme->prev_mapping) return true;
+
+	for(i = 0; i < scheme->nof_prev_mapping; i++) {
+		const iuliia_mapping_2char_t *rule = scheme->prev_mapping + i;
+
+		if(rule->cor_c == a) {
+			count_a++;
+			if(iuliiaIntFstReplId(builder, rule->repl) != iuliiaIntFstReplId(builder, iuliiaBsearch2char(rule->c, b, scheme->prev_mapping, scheme->nof_prev_mapping))) return false;
+		}
+		if(rule->cor_c == b) count_b++;
+	}
+
+	return count_a == count_b;
+}
+
+static bool iuliiaIntFstHasRules(uint32_t c, const iuliia_mapping_2char_t *mapping, size_t nof_mapping)
+{
+	size_t i;
+
+	if(!mapping) return false;
+
+	for(i = 0; i < nof_mapping; i++)
+		if(mapping[i].c == c) return true;
+
+	return false;
+}
+
+// Makes transducer for scheme without base or returns 0, if scheme has too many classes
+static void *iuliiaIntFstCompile(const iuliia_scheme_t *scheme)
+{
+	iuliia_fst_builder_t builder;
+	iuliia_fst_char_t *chars = 0;
+	iuliia_fst_t *fst = 0;
+	uint32_t *reps = 0, *state_reps = 0;
+	uint8_t *rule_classes = 0;
+	uint16_t *next_rows = 0;
+	size_t nof_chars = 0, max_chars = 0, nof_classes, nof_states = 0, nof_next_rows = 0, nof_ending_rows = 0, i, j, k;
+	const iuliia_mapping_2char_t *tables[3];
+	size_t nof_tables[3];
+
+	// Patterns are found by trie
+	if(scheme->base || !scheme->mapping || scheme->nof_pattern_mapping) return 0;
+
+	memset(&builder, 0, sizeof(iuliia_fst_builder_t));
+
+	tables[0] = scheme->prev_mapping;
+	nof_tables[0] = scheme->prev_mapping ? scheme->nof_prev_mapping : 0;
+	tables[1] = scheme->next_mapping;
+	nof_tables[1] = scheme->next_mapping ? scheme->nof_next_mapping : 0;
+	tables[2] = scheme->ending_mapping;
+	nof_tables[2] = scheme->ending_mapping ? scheme->nof_ending_mapping : 0;
+
+	// Number 0 is reserved for "no rule"
+	if(!iuliiaIntGrowArray((void **)&(builder.repls), &(builder.max_repls), 0, sizeof(uint32_t *))) return 0;
+	builder.repls[0] = 0;
+	builder.nof_repls = 1;
+
+	// Characters, which have rules. Character 0 ends text and stands for not letter before character
+	for(i = 0; i < scheme->nof_mapping; i++) {
+		if(!iuliiaIntGrowArray((void **)&chars, &max_chars, nof_chars, sizeof(iuliia_fst_char_t))) goto IULIIA_ERROR;
+		chars[nof_chars++].c = scheme->mapping[i].c;
+	}
+	for(i = 0; i < 3; i++) {
+		for(j = 0; j < nof_tables[i]; j++) {
+			if(!iuliiaIntGrowArray((void **)&chars, &max_chars, nof_chars+1, sizeof(iuliia_fst_char_t))) goto IULIIA_ERROR;
+			chars[nof_chars++].c = tables[i][j].c;
+			chars[nof_chars++].c = tables[i][j].cor_c;
+		}
+	}
+	if(!iuliiaIntGrowArray((void **)&chars, &max_chars, nof_chars+2, sizeof(iuliia_fst_char_t))) goto IULIIA_ERROR;
+	chars[nof_chars++].c = 0;
+
+	qsort(chars, nof_chars, sizeof(iuliia_fst_char_t), iuliiaIntFstCompareChars);
+	j = 0;
+	for(i = 0; i < nof_chars; i++)
+		if(!i || chars[i].c != chars[i-1].c) chars[j++].c = chars[i].c;
+	nof_chars = j;
+	if(chars[nof_chars-1].c >= IULIIA_FST_MAX_RANGE) goto IULIIA_ERROR;
+
+	fst = malloc(sizeof(iuliia_fst_t));
+	if(!fst) goto IULIIA_ERROR;
+	memset(fst, 0, sizeof(iuliia_fst_t));
+
+	fst->range = chars[nof_chars-1].c + 1;
+	if(fst->range < IULIIA_FST_MIN_RANGE) fst->range = IULIIA_FST_MIN_RANGE;
+
+	// Other letters and other characters without rules
+	chars[nof_chars++].c = IULIIA_FST_NO_CHAR - 1;
+	chars[nof_chars++].c = IULIIA_FST_NO_CHAR;
+
+	for(i = 0; i < nof_chars; i++) {
+		bool alpha;
+
+		if(chars[i].c == IULIIA_FST_NO_CHAR - 1)
+			alpha = true;
+		else if(chars[i].c == IULIIA_FST_NO_CHAR)
+			alpha = false;
+		else
+			alpha = iuliiaU32IsAlpha(chars[i].c) != 0;
+
+		chars[i].sig = builder.pool_len;
+		iuliiaIntFstPutSignature(&builder, scheme, i >= nof_chars-2 ? IULIIA_FST_NO_CHAR : chars[i].c, alpha);
+		chars[i].sig_len = builder.pool_len - chars[i].sig;
+	}
+	if(builder.failed) goto IULIIA_ERROR;
+
+	for(i = 0; i < nof_chars; i++) chars[i].sig_ptr = builder.pool + chars[i].sig;
+
+	// Characters with equal signatures make class
+	qsort(chars, nof_chars, sizeof(iuliia_fst_char_t), iuliiaIntFstCompareSignatures);
+
+	reps = malloc(nof_chars*sizeof(uint32_t));
+	fst->alpha = malloc(nof_chars);
+	if(!reps || !fst->alpha) goto IULIIA_ERROR;
+
+	nof_classes = 0;
+	for(i = 0; i < nof_chars; i++) {
+		if(i && !iuliiaIntFstSameSignature(chars + i-1, chars + i)) nof_classes++;
+
+		chars[i].cls = nof_classes;
+		if(!i || chars[i-1].cls != nof_classes) {
+			reps[nof_classes] = chars[i].c >= IULIIA_FST_NO_CHAR - 1 ? IULIIA_FST_NO_CHAR : chars[i].c;
+			fst->alpha[nof_classes] = (uint8_t)chars[i].sig_ptr[0];
+		}
+		if(chars[i].c == IULIIA_FST_NO_CHAR - 1) fst->other_alpha = (uint8_t)nof_classes;
+		if(chars[i].c == IULIIA_FST_NO_CHAR) fst->other_nonalpha = (uint8_t)nof_classes;
+	}
+	nof_classes++;
+	if(nof_classes > IULIIA_FST_MAX_CLASSES) goto IULIIA_ERROR;
+	fst->nof_classes = nof_classes;
+
+	// Table of classes. Characters are classified by lower case, as rules are
+	rule_classes = malloc(fst->range);
+	fst->classes = malloc(fst->range);
+	if(!rule_classes || !fst->classes) goto IULIIA_ERROR;
+
+	memset(rule_classes, IULIIA_FST_MAX_CLASSES, fst->range);
+	for(i = 0; i < nof_chars; i++)
+		if(chars[i].c < fst->range) rule_classes[chars[i].c] = (uint8_t)chars[i].cls;
+
+	for(i = 0; i < fst->range; i++) {
+		uint32_t c;
+
+		c = iuliiaU32ToLower((uint32_t)i);
+		if(c < fst->range && rule_classes[c] != IULIIA_FST_MAX_CLASSES)
+			fst->classes[i] = rule_classes[c];
+		else
+			fst->classes[i] = iuliiaU32IsAlpha(c) ? fst->other_alpha : fst->other_nonalpha;
+	}
+
+	// States. Previous character is 0 for anything except letters
+	state_reps = malloc(nof_classes*sizeof(uint32_t));
+	fst->states = malloc(nof_classes);
+	if(!state_reps || !fst->states) goto IULIIA_ERROR;
+
+	for(i = 0; i < nof_classes; i++) {
+		uint32_t c;
+
+		c = fst->alpha[i] ? reps[i] : 0;
+		for(j = 0; j < nof_states; j++)
+			if(iuliiaIntFstSamePrev(&builder, scheme, c, state_reps[j])) break;
+		if(j == nof_states) state_reps[nof_states++] = c;
+
+		fst->states[i] = (uint8_t)j;
+	}
+	fst->start_state = fst->states[fst->classes[0]];
+
+	// Rows of next and ending actions
+	next_rows = malloc(nof_classes*sizeof(uint16_t));
+	fst->ending_rows = malloc(nof_classes*sizeof(uint16_t));
+	if(!next_rows || !fst->ending_rows) goto IULIIA_ERROR;
+
+	for(i = 0; i < nof_classes; i++) {
+		next_rows[i] = iuliiaIntFstHasRules(reps[i], tables[1], nof_tables[1]) ? (uint16_t)(++nof_next_rows) : 0;
+		fst->ending_rows[i] = iuliiaIntFstHasRules(reps[i], tables[2], nof_tables[2]) ? (uint16_t)(++nof_ending_rows) : 0;
+	}
+
+	fst->actions = malloc(nof_states*nof_classes*sizeof(uint16_t));
+	fst->next_actions = malloc((nof_next_rows+1)*nof_classes*sizeof(uint16_t));
+	fst->ending_actions = malloc((nof_ending_rows+1)*nof_classes*sizeof(uint16_t));
+	if(!fst->actions || !fst->next_actions || !fst->ending_actions) goto IULIIA_ERROR;
+
+	// Rules are checked in order of translation loop: previous, next, direct mapping
+	for(i = 0; i < nof_classes; i++) {
+		uint16_t map_id;
+
+		map_id = iuliiaIntFstReplId(&builder, iuliiaBsearch1char(reps[i], scheme->mapping, scheme->nof_mapping));
+
+		for(j = 0; j < nof_states; j++) {
+			uint16_t id = 0;
+
+			if(tables[0]) id = iuliiaIntFstReplId(&builder, iuliiaBsearch2char(reps[i], state_reps[j], tables[0], nof_tables[0]));
+			if(!id) id = next_rows[i] ? (uint16_t)(IULIIA_FST_NEXT | (next_rows[i]-1)) : map_id;
+			fst->actions[j*nof_classes + i] = id;
+		}
+
+		for(k = 0; k < nof_classes; k++) {
+			if(next_rows[i]) {
+				uint16_t id;
+
+				id = iuliiaIntFstReplId(&builder, iuliiaBsearch2char(reps[i], reps[k], tables[1], nof_tables[1]));
+				fst->next_actions[(next_rows[i]-1)*nof_classes + k] = id ? id : map_id;
+			}
+			if(fst->ending_rows[i])
+				fst->ending_actions[(fst->ending_rows[i]-1)*nof_classes + k] = iuliiaIntFstReplId(&builder, iuliiaBsearch2char(reps[i], reps[k], tables[2], nof_tables[2]));
+		}
+	}
+	if(builder.failed) goto IULIIA_ERROR;
+
+	fst->repls = builder.repls;
+
+	free(chars);
+	free(builder.pool);
+	free(reps);
+	free(state_reps);
+	free(rule_classes);
+	free(next_rows);
+
+	return fst;
+
+IULIIA_ERROR:
+
+	if(fst) iuliiaIntFstFree(fst);
+	free(chars);
+	free(builder.pool);
+	free((void *)builder.repls);
+	free(reps);
+	free(state_reps);
+	free(rule_classes);
+	free(next_rows);
+
+	return 0;
+}
+
+typedef struct {
+	bool has_prev;
+	bool has_next;
+	bool has_ending;
+	bool has_patterns;
+} iuliia_scheme_features_t;
+
+static void iuliiaIntGetFeatures(const iuliia_scheme_t *scheme, iuliia_scheme_features_t *features)
+{
+	memset(features, 0, sizeof(iuliia_scheme_features_t));
+
+	for(; scheme; scheme = scheme->base) {
+		if(scheme->prev_mapping && scheme->nof_prev_mapping) features->has_prev = true;
+		if(scheme->next_mapping && scheme->nof_next_mapping) features->has_next = true;
+		if(scheme->ending_mapping && scheme->nof_ending_mapping) features->has_ending = true;
+		if(scheme->pattern_trie && scheme->nof_pattern_mapping) features->has_patterns = true;
+	}
+}
+
+typedef struct {
+	uint32_t prev_s; // Previous letter in lower case or 0
+	uint32_t cur_s; // Current character in lower case
+} iuliia_translate_state_t;
+
+static void iuliiaIntTranslateStart(iuliia_translate_state_t *state, uint32_t first_s, const iuliia_scheme_t *scheme)
+{
+	(void)scheme;
+	state->prev_s = 0;
+	state->cur_s = iuliiaU32ToLower(first_s);
+}
+
+// Defines function, which finds replacement for characters at s. s[1] is read only if s[0] isn't 0
+// and s[2] only if s[1] isn't 0. It sets number of used characters (1 or 2) and advances state,
+// returns 0 if there is no rule. Kinds of rules to check are given as constants or as features of scheme
+#define IULIIA_DEFINE_TRANSLATE_STEP(name, has_prev, has_next, has_ending) \
+static const uint32_t *name(const uint32_t *s, const iuliia_scheme_t *scheme, const iuliia_scheme_features_t *features, iuliia_translate_state_t *state, size_t *used) \
+{ \
+	const uint32_t *repl = 0; \
+	uint32_t cur_s, next_s; \
+\
+	(void)features; \
+	cur_s = state->cur_s; \
+	next_s = iuliiaU32ToLower(s[1]); \
+	*used = 1; \
+\
+	/* Check word ending */ \
+	if((has_ending) && next_s != 0 \
+		&& iuliiaU32IsAlpha(s[0]) && iuliiaU32IsAlpha(next_s)) { \
+\
+		if(s[2] == 0 || !iuliiaU32IsAlpha(s[2])) { \
+			repl = iuliiaIntFind2char(cur_s, next_s, scheme, IULIIA_TABLE_ENDING); \
+			if(repl) { \
+				next_s = iuliiaU32ToLower(s[2]); \
+				*used = 2; \
+			} \
+		} \
+	} \
+\
+	/* Check previous mapping */ \
+	if(!repl && (has_prev)) { \
+		repl = iuliiaIntFind2char(cur_s, state->prev_s, scheme, IULIIA_TABLE_PREV); \
+	} \
+\
+	/* Check next mapping */ \
+	if(!repl && (has_next)) { \
+		repl = iuliiaIntFind2char(cur_s, next_s, scheme, IULIIA_TABLE_NEXT); \
+	} \
+\
+	/* Check direct mapping */ \
+	if(!repl) { \
+		repl = iuliiaIntFind1char(cur_s, scheme); \
+	} \
+\
+	state->prev_s = iuliiaU32IsAlpha(cur_s) ? cur_s : 0; \
+	state->cur_s = next_s; \
+\
+	return repl; \
+}
+
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStep, features->has_prev, features->has_next, features->has_ending)
+
+// Finds longest pattern at s in scheme and schemes it overlays. Pattern of overlay wins over pattern
+// of the same length in base. Pattern with more flags wins over pattern with the same characters
+static const iuliia_mapping_pattern_t *iuliiaIntFindPattern(const uint32_t *s, const iuliia_scheme_t *scheme, bool word_start, size_t *len)
+{
+	const iuliia_mapping_pattern_t *found = 0;
+
+	*len = 0;
+	for(; scheme; scheme = scheme->base) {
+		const iuliia_pattern_node_t *trie, *node;
+		size_t depth = 0;
+
+		if(!scheme->pattern_trie || !scheme->nof_pattern_mapping) continue;
+
+		trie = scheme->pattern_trie;
+		node = trie;
+		while(s[depth]) {
+			uint32_t c, start, end, i;
+			bool word_end;
+
+			c = iuliiaU32ToLower(s[depth]);
+			start = node->first_child;
+			end = start + node->nof_children;
+			while(start < end) {
+				uint32_t mid;
+
+				mid = start + (end - start) / 2;
+				if(trie[mid].c < c)
+					start = mid + 1;
+				else
+					end = mid;
+			}
+			if(start == node->first_child + node->nof_children || trie[start].c != c) break;
+
+			node = trie + start;
+			depth++;
+			if(depth <= *len) continue;
+
+			word_end = !iuliiaU32IsAlpha(s[depth]);
+			i = 0;
+			if(word_start && word_end) i = node->patterns[IULIIA_PATTERN_WORD_START | IULIIA_PATTERN_WORD_END];
+			if(!i && word_start) i = node->patterns[IULIIA_PATTERN_WORD_START];
+			if(!i && word_end) i = node->patterns[IULIIA_PATTERN_WORD_END];
+			if(!i) i = node->patterns[0];
+			if(i) {
+				found = scheme->pattern_mapping + i-1;
+				*len = depth;
+			}
+		}
+	}
+
+	return found;
+}
+
+// Step for schemes with patterns. Longest pattern at s is used instead of rules of its characters.
+// Sets character, which case is applied to replacement: first character of pattern, otherwise last used one
+static const uint32_t *iuliiaIntTranslateStepPatterns(const uint32_t *s, const iuliia_scheme_t *scheme, const iuliia_scheme_features_t *features, iuliia_translate_state_t *state, size_t *used, uint32_t *case_s)
+{
+	const iuliia_mapping_pattern_t *pattern;
+	const uint32_t *repl;
+	uint32_t last_s;
+
+	pattern = iuliiaIntFindPattern(s, scheme, state->prev_s == 0, used);
+	if(!pattern) {
+		repl = iuliiaIntTranslateStep(s, scheme, features, state, used);
+		*case_s = s[*used-1];
+
+		return repl;
+	}
+
+	*case_s = s[0];
+	last_s = iuliiaU32ToLower(s[*used-1]);
+	state->prev_s = iuliiaU32IsAlpha(last_s) ? last_s : 0;
+	state->cur_s = iuliiaU32ToLower(s[*used]);
+
+	return pattern->repl;
+}
+
+// Window of composed characters for translation with IULIIA_TRANSLATE_NFC
+typedef struct {
+	uint32_t c[3];
+	size_t used[3]; // Number of input characters, which were composed
+} iuliia_compose_window_t;
+
+static void iuliiaIntComposeWindowFill(iuliia_compose_window_t *window, const uint32_t *s)
+{
+	size_t i;
+
+	for(i = 0; i < 3; i++) {
+		if(i && !window->c[i-1]) {
+			window->c[i] = 0;
+			window->used[i] = 0;
+		} else {
+			window->c[i] = iuliiaIntComposeChar(s, window->used + i);
+			s += window->used[i];
+		}
+	}
+}
+
+#define IULIIA_ENGINE_PREV 0x1
+#define IULIIA_ENGINE_NEXT 0x2
+#define IULIIA_ENGINE_ENDING 0x4
+#define IULIIA_ENGINE_SELECTED 0x8
+#define IULIIA_ENGINE_PATTERNS 0x10
+#define IULIIA_ENGINE_BLOCKS 0x20
+
+typedef uint32_t *(*iuliia_engine_t)(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags);
+
+// Defines translation loop, which uses given start and step functions
+#define IULIIA_DEFINE_ENGINE(name, start, step) \
+static uint32_t *name(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags) \
+{ \
+	uint32_t *new_s; \
+	const uint32_t *w; \
+	size_t new_len, new_offset = 0, chars_to_add = 5; \
+	iuliia_translate_state_t state; \
+	iuliia_compose_window_t window; \
+	bool compose; \
+\
+	compose = (flags & IULIIA_TRANSLATE_NFC) != 0; \
+\
+	new_len = iuliiaU32len(s); \
+	new_s = malloc((new_len+1)*sizeof(uint32_t)); \
+	if(!new_s) return 0; \
+\
+	/* Rules are looked up in composed characters, when combining marks are composed */ \
+	if(compose) { \
+		iuliiaIntComposeWindowFill(&window, s); \
+		w = window.c; \
+	} else \
+		w = s; \
+\
+	start(&state, *w, scheme); \
+\
+	while(*w) { \
+		const uint32_t *repl; \
+		size_t used; \
+\
+		if(new_offset == new_len) { \
+			uint32_t *_new_s = 0; \
+\
+			if(SIZE_MAX/sizeof(uint32_t)-chars_to_add >= new_len) _new_s = realloc(new_s, (new_len+chars_to_add)*sizeof(uint32_t)); \
+			if(!_new_s) { \
+				free(new_s); \
+				return 0; \
+			} \
+			new_s = _new_s; \
+			new_len += chars_to_add-1; \
+			if((SIZE_MAX/sizeof(uint32_t)-1)/2 > chars_to_add) chars_to_add = (chars_to_add-1)*2+1; \
+		} \
+\
+		repl = step(w, scheme, 0, &state, &used); \
+\
+		if(repl) { \
+			bool first_char = true; \
+			uint32_t case_s; \
+\
+			case_s = w[used-1]; /* Case of word ending is taken from its last character */ \
+			while(*repl) { \
+				if(new_offset == new_len) { \
+					uint32_t* _new_s = 0; \
+\
+					if(SIZE_MAX/sizeof(uint32_t)-5 >= new_len) _new_s = realloc(new_s, (new_len+5)*sizeof(uint32_t)); \
+					if(!_new_s) { \
+						free(new_s); \
+						return 0; \
+					} \
+					new_s = _new_s; \
+					new_len += 4; \
+				} \
+				if(first_char && iuliiaU32IsUpper(case_s)) \
+					new_s[new_offset] = iuliiaU32ToUpper(*repl); \
+				else \
+					new_s[new_offset] = *repl; \
+				new_offset++; \
+				repl++; \
+				first_char = false; \
+			} \
+		} else { \
+			new_s[new_offset] = *w; \
+			new_offset++; \
+		} \
+\
+		if(compose) { \
+			s += window.used[0]; \
+			if(used == 2) s += window.used[1]; \
+			iuliiaIntComposeWindowFill(&window, s); \
+		} else { \
+			s += used; \
+			w = s; \
+		} \
+	} \
+	new_s[new_offset] = 0; \
+\
+	return new_s; \
+}
+
+// Engines for every set of kinds of rules, so translation loop doesn't check rules, which scheme hasn't
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepMap, false, false, false)
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepPrev, true, false, false)
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepNext, false, true, false)
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepPrevNext, true, true, false)
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepEnding, false, false, true)
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepPrevEnding, true, false, true)
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepNextEnding, false, true, true)
+IULIIA_DEFINE_TRANSLATE_STEP(iuliiaIntTranslateStepFull, true, true, true)
+
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslateMap, iuliiaIntTranslateStart, iuliiaIntTranslateStepMap)
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslatePrev, iuliiaIntTranslateStart, iuliiaIntTranslateStepPrev)
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslateNext, iuliiaIntTranslateStart, iuliiaIntTranslateStepNext)
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslatePrevNext, iuliiaIntTranslateStart, iuliiaIntTranslateStepPrevNext)
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslateEnding, iuliiaIntTranslateStart, iuliiaIntTranslateStepEnding)
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslatePrevEnding, iuliiaIntTranslateStart, iuliiaIntTranslateStepPrevEnding)
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslateNextEnding, iuliiaIntTranslateStart, iuliiaIntTranslateStepNextEnding)
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslateFull, iuliiaIntTranslateStart, iuliiaIntTranslateStepFull)
+
+// Block engines classify block of characters at once: bit is set for character, which lower case
+// rules may use. Spans of other characters are copied, rules are looked for only at set bits
+#define IULIIA_BLOCK_SIZE 64
+
+static uint64_t iuliiaIntClassifyBlock(const uint32_t *s, size_t n, uint32_t first_c, uint32_t range)
+{
+	uint64_t bits = 0;
+	size_t i = 0;
+
+#if defined(IULIIA_SSE2)
+	__m128i v_first, v_range, v_sign;
+
+	// SSE2 compares signed numbers, so offsets from first character are moved by sign bit
+	v_first = _mm_set1_epi32((int)first_c);
+	v_sign = _mm_set1_epi32((int)0x80000000u);
+	v_range = _mm_set1_epi32((int)(range ^ 0x80000000u));
+	for(; i+4 <= n; i += 4) {
+		__m128i v;
+		unsigned int outside;
+
+		v = _mm_loadu_si128((const __m128i *)(s+i));
+		v = _mm_xor_si128(_mm_sub_epi32(v, v_first), v_sign);
+		outside = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, v_range)));
+		bits |= (uint64_t)(~outside & 0xf) << i;
+	}
+#endif
+	for(; i < n; i++)
+		if(s[i] - first_c <= range) bits |= (uint64_t)1 << i;
+
+	return bits;
+}
+
+static unsigned int iuliiaIntLowestBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+	return (unsigned int)__builtin_ctzll(bits);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long i;
+
+	_BitScanForward64(&i, bits);
+
+	return (unsigned int)i;
+#else
+	unsigned int i = 0;
+
+	while(!(bits & 1)) {
+		bits >>= 1;
+		i++;
+	}
+
+	return i;
+#endif
+}
+
+// Defines translation loop over blocks, which uses given step function
+#define IULIIA_DEFINE_BLOCK_ENGINE(name, step) \
+static uint32_t *name(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags) \
+{ \
+	uint32_t *new_s = 0; \
+	size_t len, pos = 0, step_end = SIZE_MAX, new_len = 0, max_new_len = 0; \
+	iuliia_translate_state_t state; \
+\
+	(void)flags; \
+	len = iuliiaU32len(s); \
+	new_s = malloc((len+1)*sizeof(uint32_t)); \
+	if(!new_s) return 0; \
+	max_new_len = len+1; \
+	iuliiaIntTranslateStart(&state, *s, scheme); \
+\
+	while(pos < len) { \
+		uint64_t bits; \
+		size_t block, n; \
+\
+		block = pos; \
+		n = len-pos < IULIIA_BLOCK_SIZE ? len-pos : IULIIA_BLOCK_SIZE; \
+		bits = iuliiaIntClassifyBlock(s+block, n, scheme->first_rule_c, scheme->last_rule_c-scheme->first_rule_c); \
+\
+		while(1) { \
+			const uint32_t *repl; \
+			size_t next, used; \
+\
+			next = bits ? block+iuliiaIntLowestBit(bits) : block+n; \
+			bits &= bits-1; \
+\
+			/* Character can be already used by rule of previous one */ \
+			if(next > pos) { \
+				while(max_new_len-new_len <= next-pos) \
+					if(!iuliiaIntGrowArray((void **)&new_s, &max_new_len, max_new_len, sizeof(uint32_t))) goto IULIIA_ERROR; \
+				memcpy(new_s+new_len, s+pos, (next-pos)*sizeof(uint32_t)); \
+				new_len += next-pos; \
+				pos = next; \
+			} \
+			if(pos >= block+n) break; \
+			if(next < pos) continue; \
+\
+			/* State is made again after copied characters */ \
+			if(step_end != pos) { \
+				state.prev_s = pos && iuliiaU32IsAlpha(s[pos-1]) ? iuliiaU32ToLower(s[pos-1]) : 0; \
+				state.cur_s = iuliiaU32ToLower(s[pos]); \
+			} \
+\
+			repl = step(s+pos, scheme, 0, &state, &used); \
+			if(repl) { \
+				bool first_char = true; \
+				uint32_t case_s; \
+\
+				case_s = s[pos+used-1]; /* Case of word ending is taken from its last character */ \
+				for(; *repl; repl++) { \
+					if(!iuliiaIntGrowArray((void **)&new_s, &max_new_len, new_len+1, sizeof(uint32_t))) goto IULIIA_ERROR; \
+					if(first_char && iuliiaU32IsUpper(case_s)) \
+						new_s[new_len++] = iuliiaU32ToUpper(*repl); \
+					else \
+						new_s[new_len++] = *repl; \
+					first_char = false; \
+				} \
+			} else { \
+				if(!iuliiaIntGrowArray((void **)&new_s, &max_new_len, new_len+1, sizeof(uint32_t))) goto IULIIA_ERROR; \
+				new_s[new_len++] = s[pos]; \
+			} \
+\
+			pos += used; \
+			step_end = pos; \
+		} \
+	} \
+	new_s[new_len] = 0; \
+\
+	return new_s; \
+\
+IULIIA_ERROR: \
+	free(new_s); \
+\
+	return 0; \
+}
+
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksMap, iuliiaIntTranslateStepMap)
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksPrev, iuliiaIntTranslateStepPrev)
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksNext, iuliiaIntTranslateStepNext)
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksPrevNext, iuliiaIntTranslateStepPrevNext)
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksEnding, iuliiaIntTranslateStepEnding)
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksPrevEnding, iuliiaIntTranslateStepPrevEnding)
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksNextEnding, iuliiaIntTranslateStepNextEnding)
+IULIIA_DEFINE_BLOCK_ENGINE(iuliiaIntTranslateBlocksFull, iuliiaIntTranslateStepFull)
+
+#if defined(IULIIA_JIT)
+// Finds rules by native code of scheme
+static const uint32_t *iuliiaIntTranslateStepJit(const uint32_t *s, const iuliia_scheme_t *scheme, const iuliia_scheme_features_t *features, iuliia_translate_state_t *state, size_t *used)
+{
+	const iuliia_jit_t *jit = scheme->jit;
+	const uint32_t *repl = 0;
+	uint32_t cur_s, next_s;
+
+	(void)features;
+	cur_s = state->cur_s;
+	next_s = iuliiaU32ToLower(s[1]);
+	*used = 1;
+
+	if(jit->ending && next_s != 0 && iuliiaU32IsAlpha(s[0]) && iuliiaU32IsAlpha(next_s)
+		&& (s[2] == 0 || !iuliiaU32IsAlpha(s[2]))) {
+		repl = jit->ending(cur_s, next_s);
+		if(repl) {
+			next_s = iuliiaU32ToLower(s[2]);
+			*used = 2;
+		}
+	}
+
+	if(!repl) repl = jit->rules(cur_s, state->prev_s, next_s);
+
+	state->prev_s = iuliiaU32IsAlpha(cur_s) ? cur_s : 0;
+	state->cur_s = next_s;
+
+	return repl;
+}
+
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslateJit, iuliiaIntTranslateStart, iuliiaIntTranslateStepJit)
+#endif
+
+static void iuliiaIntTranslateStartFst(iuliia_translate_state_t *state, uint32_t first_s, const iuliia_scheme_t *scheme)
+{
+	const iuliia_fst_t *fst = scheme->fst;
+
+	state->prev_s = fst->start_state;
+	state->cur_s = iuliiaIntFstClass(fst, first_s);
+}
+
+// State keeps state of transducer and class of current character. Every character is classified once,
+// except characters after possible word ending
+static const uint32_t *iuliiaIntTranslateStepFst(const uint32_t *s, const iuliia_scheme_t *scheme, const iuliia_scheme_features_t *features, iuliia_translate_state_t *state, size_t *used)
+{
+	const iuliia_fst_t *fst = scheme->fst;
+	unsigned int cur_class, next_class, action, id = 0;
+
+	(void)features;
+	cur_class = state->cur_s;
+	next_class = iuliiaIntFstClass(fst, s[1]);
+	*used = 1;
+
+	if(fst->ending_rows[cur_class] && fst->alpha[cur_class] && fst->alpha[next_class]) {
+		unsigned int after_class;
+
+		after_class = iuliiaIntFstClass(fst, s[2]);
+		if(!fst->alpha[after_class]) {
+			id = fst->ending_actions[(fst->ending_rows[cur_class]-1)*fst->nof_classes + next_class];
+			if(id) {
+				next_class = after_class;
+				*used = 2;
+			}
+		}
+	}
+
+	if(!id) {
+		action = fst->actions[state->prev_s*fst->nof_classes + cur_class];
+		if(action & IULIIA_FST_NEXT)
+			id = fst->next_actions[(action & ~IULIIA_FST_NEXT)*fst->nof_classes + next_class];
+		else
+			id = action;
+	}
+
+	state->prev_s = fst->states[cur_class];
+	state->cur_s = next_class;
+
+	return fst->repls[id];
+}
+
+IULIIA_DEFINE_ENGINE(iuliiaIntTranslateFst, iuliiaIntTranslateStartFst, iuliiaIntTranslateStepFst)
+
+// Translation loop for schemes with patterns. Pattern may need more characters than window of
+// composed characters has, so text is composed before translation
+static uint32_t *iuliiaIntTranslatePatterns(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags)
+{
+	iuliia_scheme_features_t features;
+	iuliia_translate_state_t state;
+	uint32_t *new_s = 0, *composed = 0;
+	size_t new_len = 0, max_new_len = 0;
+
+	if(flags & IULIIA_TRANSLATE_NFC) {
+		size_t len, used;
+
+		len = iuliiaU32len(s);
+		if(SIZE_MAX/sizeof(uint32_t) <= len) return 0;
+		composed = malloc((len+1)*sizeof(uint32_t));
+		if(!composed) return 0;
+
+		len = 0;
+		while((composed[len] = iuliiaIntComposeChar(s, &used)) != 0) {
+			s += used;
+			len++;
+		}
+		s = composed;
+	}
+
+	iuliiaIntGetFeatures(scheme, &features);
+	iuliiaIntTranslateStart(&state, *s, scheme);
+
+	while(1) {
+		const uint32_t *repl;
+		uint32_t case_s;
+		size_t used;
+
+		if(!iuliiaIntGrowArray((void **)&new_s, &max_new_len, new_len, sizeof(uint32_t))) goto IULIIA_ERROR;
+		if(!(*s)) break;
+
+		repl = iuliiaIntTranslateStepPatterns(s, scheme, &features, &state, &used, &case_s);
+		if(repl) {
+			if(*repl) {
+				new_s[new_len++] = iuliiaU32IsUpper(case_s) ? iuliiaU32ToUpper(*repl) : *repl;
+				repl++;
+			}
+			while(*repl) {
+				if(!iuliiaIntGrowArray((void **)&new_s, &max_new_len, new_len, sizeof(uint32_t))) goto IULIIA_ERROR;
+				new_s[new_len++] = *(repl++);
+			}
+		} else
+			new_s[new_len++] = *s;
+
+		s += used;
+	}
+	new_s[new_len] = 0;
+
+	free(composed);
+
+	return new_s;
+
+IULIIA_ERROR:
+
+	free(new_s);
+	free(composed);
+
+	return 0;
+}
+
+// Indexed by IULIIA_ENGINE_* bits
+static const iuliia_engine_t iuliia_engines[8] = {
+	iuliiaIntTranslateMap,
+	iuliiaIntTranslatePrev,
+	iuliiaIntTranslateNext,
+	iuliiaIntTranslatePrevNext,
+	iuliiaIntTranslateEnding,
+	iuliiaIntTranslatePrevEnding,
+	iuliiaIntTranslateNextEnding,
+	iuliiaIntTranslateFull
+};
+
+static const iuliia_engine_t iuliia_block_engines[8] = {
+	iuliiaIntTranslateBlocksMap,
+	iuliiaIntTranslateBlocksPrev,
+	iuliiaIntTranslateBlocksNext,
+	iuliiaIntTranslateBlocksPrevNext,
+	iuliiaIntTranslateBlocksEnding,
+	iuliiaIntTranslateBlocksPrevEnding,
+	iuliiaIntTranslateBlocksNextEnding,
+	iuliiaIntTranslateBlocksFull
+};
+
+// Finds range of characters, which lower case is key or context of rule of scheme or schemes it overlays
+static void iuliiaIntFindRuleRange(iuliia_scheme_t *scheme)
+{
+	const iuliia_scheme_t *current;
+	uint32_t first_c = UINT32_MAX, last_c = 0, lower_first_c, lower_last_c;
+	size_t i;
+
+	for(current = scheme; current; current = current->base) {
+		const iuliia_mapping_2char_t *tables[3];
+		size_t nof_tables[3], j;
+
+		for(i = 0; current->mapping && i < current->nof_mapping; i++) {
+			if(current->mapping[i].c < first_c) first_c = current->mapping[i].c;
+			if(current->mapping[i].c > last_c) last_c = current->mapping[i].c;
+		}
+
+		tables[0] = current->prev_mapping;
+		nof_tables[0] = current->prev_mapping ? current->nof_prev_mapping : 0;
+		tables[1] = current->next_mapping;
+		nof_tables[1] = current->next_mapping ? current->nof_next_mapping : 0;
+		tables[2] = current->ending_mapping;
+		nof_tables[2] = current->ending_mapping ? current->nof_ending_mapping : 0;
+		for(j = 0; j < 3; j++) {
+			for(i = 0; i < nof_tables[j]; i++) {
+				if(tables[j][i].c < first_c) first_c = tables[j][i].c;
+				if(tables[j][i].c > last_c) last_c = tables[j][i].c;
+				if(!tables[j][i].cor_c) continue;
+				if(tables[j][i].cor_c < first_c) first_c = tables[j][i].cor_c;
+				if(tables[j][i].cor_c > last_c) last_c = tables[j][i].cor_c;
+			}
+		}
+	}
+
+	// Scheme without rules looks only at terminating 0, which isn't in text
+	if(first_c > last_c) {
+		scheme->first_rule_c = 0;
+		scheme->last_rule_c = 0;
+
+		return;
+	}
+
+	// Upper case letters, which lower case is in range
+	lower_first_c = first_c;
+	lower_last_c = last_c;
+	for(i = 0; i < sizeof(iuliia_case_ranges)/sizeof(iuliia_case_range_t); i++) {
+		const iuliia_case_range_t *range;
+		uint32_t c;
+
+		range = iuliia_case_ranges + i;
+		for(c = range->first; c <= range->last; c += range->stride) {
+			uint32_t lower_c;
+
+			lower_c = c + (uint32_t)range->delta;
+			if(lower_c < lower_first_c || lower_c > lower_last_c) continue;
+
+			if(c < first_c) first_c = c;
+			if(c > last_c) last_c = c;
+		}
+	}
+
+	scheme->first_rule_c = first_c;
+	scheme->last_rule_c = last_c;
+}
+
+static unsigned int iuliiaIntEngineOf(const iuliia_scheme_t *scheme)
+{
+	iuliia_scheme_features_t features;
+	unsigned int engine = 0;
+
+	iuliiaIntGetFeatures(scheme, &features);
+	if(features.has_prev) engine |= IULIIA_ENGINE_PREV;
+	if(features.has_next) engine |= IULIIA_ENGINE_NEXT;
+	if(features.has_ending) engine |= IULIIA_ENGINE_ENDING;
+	if(features.has_patterns) engine |= IULIIA_ENGINE_PATTERNS;
+
+	return engine;
+}
+
+static void iuliiaIntSelectEngine(iuliia_scheme_t *scheme)
+{
+	scheme->engine = IULIIA_ENGINE_SELECTED | IULIIA_ENGINE_BLOCKS | iuliiaIntEngineOf(scheme);
+	iuliiaIntFindRuleRange(scheme);
+}
+
+// Scheme, which wasn't prepared by library, may have engine, which doesn't match its rules
+static bool iuliiaIntEngineIsSelected(const iuliia_scheme_t *scheme)
+{
+	return scheme->engine == (IULIIA_ENGINE_SELECTED | IULIIA_ENGINE_BLOCKS | iuliiaIntEngineOf(scheme));
+}
+
+uint32_t *iuliiaTranslateExU32(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags)
+{
+	unsigned int engine;
+
+	if(!scheme->mapping) return 0;
+
+	if(scheme->fst) return iuliiaIntTranslateFst(s, scheme, flags);
+#if defined(IULIIA_JIT)
+	if(scheme->jit) return iuliiaIntTranslateJit(s, scheme, flags);
+#endif
+
+	// Scheme, which wasn't prepared by library or was changed after it, is checked on every call
+	if(iuliiaIntEngineIsSelected(scheme))
+		engine = scheme->engine & ~IULIIA_ENGINE_SELECTED;
+	else
+		engine = iuliiaIntEngineOf(scheme);
+
+	if(engine & IULIIA_ENGINE_PATTERNS) return iuliiaIntTranslatePatterns(s, scheme, flags);
+	// Combining marks are composed by window of characters, which block engines haven't
+	if((engine & IULIIA_ENGINE_BLOCKS) && !(flags & IULIIA_TRANSLATE_NFC)) return iuliia_block_engines[engine & 7](s, scheme, flags);
+
+	return iuliia_engines[engine & 7](s, scheme, flags);
+}
+
+uint32_t *iuliiaTranslateU32(const uint32_t *s, const iuliia_scheme_t *scheme)
+{
+	return iuliiaTranslateExU32(s, scheme, 0);
+}
+
+// Checks, whether character is used by context rules or patterns of scheme and schemes it overlays
+static bool iuliiaIntIsContextChar(uint32_t c, const iuliia_scheme_t *scheme)
+{
+	size_t i;
+
+	for(; scheme; scheme = scheme->base) {
+		for(i = 0; scheme->prev_mapping && i < scheme->nof_prev_mapping; i++)
+			if(scheme->prev_mapping[i].c == c || scheme->prev_mapping[i].cor_c == c) return true;
+		for(i = 0; scheme->next_mapping && i < scheme->nof_next_mapping; i++)
+			if(scheme->next_mapping[i].c == c || scheme->next_mapping[i].cor_c == c) return true;
+		for(i = 0; scheme->pattern_mapping && i < scheme->nof_pattern_mapping; i++) {
+			const uint32_t *p;
+
+			for(p = scheme->pattern_mapping[i].pattern; *p; p++)
+				if(*p == c) return true;
+		}
+	}
+
+	return false;
+}
+
+// Text can be split before c, if it isn't a letter or combining mark, context rules and patterns don't use it
+// and character before it (prev_c) has no rule for end of text. last_c caches the last character, which context rules use
+static bool iuliiaIntIsSafeSplit(uint32_t prev_c, uint32_t c, const iuliia_scheme_t *scheme, uint32_t *last_c)
+{
+	c = iuliiaU32ToLower(c);
+	if(!c || iuliiaU32IsAlpha(c) || iuliiaIntIsCombiningMark(c)) return false;
+	if(c == *last_c) return false;
+	if(iuliiaIntIsContextChar(c, scheme)) {
+		*last_c = c;
+
+		return false;
 	}
 
-	if(scheme->nof_ending_mapping) {
+	return !iuliiaIntFind2char(iuliiaU32ToLower(prev_c), 0, scheme, IULIIA_TABLE_NEXT);
+}
+
+// Decodes UTF-8 character, which may be cut by end of buffer. Returns its length, c is 0 if it isn't valid
+static size_t iuliiaIntCharU8toU32N(const uint8_t *u8, size_t len, uint32_t *c)
+{
+	uint8_t tmp[5];
+	const uint8_t *next;
+	size_t i;
+
+	for(i = 0; i < 4 && i < len; i++) tmp[i] = u8[i];
+	tmp[i] = 0;
+
+	next = iuliiaCharU8toU32(tmp, c);
+	if(!next || next == tmp) {
+		*c = 0;
+
+		return 1;
+	}
+
+	return (size_t)(next - tmp);
+}
+
+size_t iuliiaFindSafeSplit(const uint8_t *buf, size_t len, size_t target_offset, const iuliia_scheme_t *scheme)
+{
+	uint32_t prev_c = 0, last_c = 0;
+	size_t offset, prev_offset;
+
+	if(target_offset == 0) return 0;
+	if(target_offset >= len) return len;
+
+	// Start of character at target or after it and character before it
+	offset = target_offset;
+	while(offset < len && (buf[offset] & 0xc0) == 0x80) offset++;
+	prev_offset = offset-1;
+	while(prev_offset > 0 && offset-prev_offset < 4 && (buf[prev_offset] & 0xc0) == 0x80) prev_offset--;
+	iuliiaIntCharU8toU32N(buf+prev_offset, offset-prev_offset, &prev_c);
+
+	while(offset < len) {
+		uint32_t c;
+		size_t c_len;
+
+		c_len = iuliiaIntCharU8toU32N(buf+offset, len-offset, &c);
+		if(iuliiaIntIsSafeSplit(prev_c, c, scheme, &last_c)) return offset;
+
+		prev_c = c;
+		offset += c_len;
+	}
+
+	return len;
+}
+
+// Chunks shorter than this are translated by one thread
+#define IULIIA_PARALLEL_MIN_CHUNK 65536
+
+typedef struct {
+	const uint32_t *s;
+	size_t len;
+	uint32_t *new_s;
+	size_t new_len;
+	size_t new_offset; // Position in result, found by sum of lengths of previous chunks
+} iuliia_parallel_chunk_t;
+
+typedef struct {
+	const iuliia_scheme_t *scheme;
+	unsigned int flags;
+	iuliia_parallel_chunk_t *chunks;
+	size_t nof_chunks;
+	uint32_t *result; // 0 while chunks are translated, then they are copied to it
+	iuliia_atomic_t next_chunk;
+	iuliia_atomic_t failed;
+} iuliia_parallel_job_t;
+
+IULIIA_THREAD_PROC(iuliiaIntParallelThread)
+{
+	iuliia_parallel_job_t *job;
+
+	job = (iuliia_parallel_job_t *)arg;
+
+	while(1) {
+		iuliia_parallel_chunk_t *chunk;
+		uint32_t *s;
 		size_t i;
 
-		for(i = 0; i < scheme->nof_ending_mapping; i++) {
-			if(scheme->ending_mapping[i].repl) free(scheme->ending_mapping[i].repl);
+		i = (size_t)iuliiaIntAtomicAdd(&(job->next_chunk), 1) - 1;
+		if(i >= job->nof_chunks) break;
+
+		chunk = job->chunks + i;
+
+		if(job->result) {
+			memcpy(job->result + chunk->new_offset, chunk->new_s, chunk->new_len*sizeof(uint32_t));
+			free(chunk->new_s);
+			chunk->new_s = 0;
+
+			continue;
+		}
+
+		if(iuliiaIntAtomicLoad(&(job->failed))) continue;
+
+		// Translate functions need terminated string
+		s = malloc((chunk->len+1)*sizeof(uint32_t));
+		if(s) {
+			memcpy(s, chunk->s, chunk->len*sizeof(uint32_t));
+			s[chunk->len] = 0;
+			chunk->new_s = iuliiaTranslateExU32(s, job->scheme, job->flags);
+			free(s);
+		}
+		if(!chunk->new_s) {
+			iuliiaIntAtomicAdd(&(job->failed), 1);
+
+			continue;
+		}
+		chunk->new_len = iuliiaU32len(chunk->new_s);
+	}
+
+	return 0;
+}
+
+static void iuliiaIntRunParallel(iuliia_parallel_job_t *job, unsigned int nthreads)
+{
+	iuliia_thread_t *threads = 0;
+	unsigned int nof_started = 0, i;
+
+	job->next_chunk = 0;
+
+	// Calling thread works too
+	if(nthreads > 1) {
+		threads = malloc((nthreads-1)*sizeof(iuliia_thread_t));
+		if(threads) {
+			for(i = 0; i < nthreads-1; i++) {
+				if(!iuliiaIntThreadCreate(threads+i, iuliiaIntParallelThread, job)) break;
+				nof_started++;
+			}
+		}
+	}
+
+	iuliiaIntParallelThread(job);
+
+	for(i = 0; i < nof_started; i++) iuliiaIntThreadJoin(threads[i]);
+
+	free(threads);
+}
+
+uint32_t *iuliiaTranslateParallelU32(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags, unsigned int nthreads)
+{
+	iuliia_parallel_job_t job;
+	size_t len, chunk_len, max_chunks, offset, new_len, i;
+	uint32_t last_c = 0;
+
+	if(!scheme->mapping) return 0;
+
+	len = iuliiaU32len(s);
+	if(!nthreads) nthreads = iuliiaIntCpuCount();
+
+	// Few chunks for every thread, so threads, which got simpler text, take more of them
+	chunk_len = len / ((size_t)nthreads*4);
+	if(chunk_len < IULIIA_PARALLEL_MIN_CHUNK) chunk_len = IULIIA_PARALLEL_MIN_CHUNK;
+	if(nthreads < 2 || len < 2*chunk_len) return iuliiaTranslateExU32(s, scheme, flags);
+
+	memset(&job, 0, sizeof(iuliia_parallel_job_t));
+	job.scheme = scheme;
+	job.flags = flags;
+
+	max_chunks = len/chunk_len + 1;
+	job.chunks = malloc(max_chunks*sizeof(iuliia_parallel_chunk_t));
+	if(!job.chunks) return 0;
+	memset(job.chunks, 0, max_chunks*sizeof(iuliia_parallel_chunk_t));
+
+	// Chunks end at the first safe point after their length
+	offset = 0;
+	while(offset < len) {
+		size_t end;
+
+		end = offset + chunk_len;
+		while(end < len && !iuliiaIntIsSafeSplit(s[end-1], s[end], scheme, &last_c)) end++;
+		if(end > len) end = len;
+
+		job.chunks[job.nof_chunks].s = s + offset;
+		job.chunks[job.nof_chunks].len = end - offset;
+		job.nof_chunks++;
+		offset = end;
+	}
+
+	if(job.nof_chunks < nthreads) nthreads = (unsigned int)job.nof_chunks;
+	iuliiaIntRunParallel(&job, nthreads);
+	if(job.failed) goto IULIIA_ERROR;
+
+	new_len = 0;
+	for(i = 0; i < job.nof_chunks; i++) {
+		job.chunks[i].new_offset = new_len;
+		new_len += job.chunks[i].new_len;
+	}
+
+	job.result = malloc((new_len+1)*sizeof(uint32_t));
+	if(!job.result) goto IULIIA_ERROR;
+	job.result[new_len] = 0;
+
+	// Every chunk is copied to its place by thread, which takes it
+	iuliiaIntRunParallel(&job, nthreads);
+
+	free(job.chunks);
+
+	return job.result;
+
+IULIIA_ERROR:
+
+	for(i = 0; i < job.nof_chunks; i++) free(job.chunks[i].new_s);
+	free(job.chunks);
+
+	return 0;
+}
+
+// Writes UTF-8 bytes of character, returns their number
+static size_t iuliiaIntCharU32toU8(uint32_t c, uint8_t *u8)
+{
+	if(c < 0x80) {
+		u8[0] = (uint8_t)c;
+
+		return 1;
+	} else if(c < 0x800) {
+		u8[0] = (uint8_t)(0xc0 | (c >> 6));
+		u8[1] = (uint8_t)(0x80 | (c & 0x3f));
+
+		return 2;
+	} else if(c < 0x10000) {
+		u8[0] = (uint8_t)(0xe0 | (c >> 12));
+		u8[1] = (uint8_t)(0x80 | ((c >> 6) & 0x3f));
+		u8[2] = (uint8_t)(0x80 | (c & 0x3f));
+
+		return 3;
+	}
+
+	u8[0] = (uint8_t)(0xf0 | ((c >> 18) & 0x7));
+	u8[1] = (uint8_t)(0x80 | ((c >> 12) & 0x3f));
+	u8[2] = (uint8_t)(0x80 | ((c >> 6) & 0x3f));
+	u8[3] = (uint8_t)(0x80 | (c & 0x3f));
+
+	return 4;
+}
+
+// Makes room for n more bytes of column data
+static bool iuliiaIntColumnReserve(uint8_t **data, size_t *max_data, size_t data_len, size_t n)
+{
+	while(*max_data - data_len < n) {
+		if(!iuliiaIntGrowArray((void **)data, max_data, *max_data, 1)) return false;
+	}
+
+	return true;
+}
+
+static bool iuliiaIntColumnPut(uint8_t **data, size_t *max_data, size_t *data_len, uint32_t c)
+{
+	if(!iuliiaIntColumnReserve(data, max_data, *data_len, 4)) return false;
+
+	*data_len += iuliiaIntCharU32toU8(c, *data + *data_len);
+
+	return true;
+}
+
+// Translates string and appends it as UTF-8 to data. s is changed by composition of characters
+static bool iuliiaIntTranslateColumnString(uint32_t *s, const iuliia_scheme_t *scheme, const iuliia_scheme_features_t *features, unsigned int flags, uint8_t **data, size_t *max_data, size_t *data_len)
+{
+	iuliia_translate_state_t state;
+
+	if(flags & IULIIA_TRANSLATE_NFC) {
+		size_t i = 0, j = 0, used;
+
+		while((s[j] = iuliiaIntComposeChar(s+i, &used)) != 0) {
+			i += used;
+			j++;
+		}
+	}
+
+	iuliiaIntTranslateStart(&state, *s, scheme);
+
+	while(*s) {
+		const uint32_t *repl;
+		uint32_t case_s;
+		size_t used;
+
+		if(features->has_patterns)
+			repl = iuliiaIntTranslateStepPatterns(s, scheme, features, &state, &used, &case_s);
+		else {
+			repl = iuliiaIntTranslateStep(s, scheme, features, &state, &used);
+			case_s = s[used-1];
+		}
+
+		if(repl) {
+			if(*repl) {
+				if(!iuliiaIntColumnPut(data, max_data, data_len, iuliiaU32IsUpper(case_s) ? iuliiaU32ToUpper(*repl) : *repl)) return false;
+				repl++;
+			}
+			for(; *repl; repl++)
+				if(!iuliiaIntColumnPut(data, max_data, data_len, *repl)) return false;
+		} else if(!iuliiaIntColumnPut(data, max_data, data_len, *s))
+			return false;
+
+		s += used;
+	}
+
+	return true;
+}
+
+// FNV-1a hash of string of column
+static size_t iuliiaIntColumnHash(const uint8_t *data, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for(i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+int iuliiaTranslateColumnU8(const uint8_t *data, const size_t *offsets, size_t nof_strings, const iuliia_scheme_t *scheme, unsigned int flags, iuliia_column_t *new_column)
+{
+	iuliia_scheme_features_t features;
+	uint32_t *s = 0;
+	size_t *table = 0, max_data, max_s = 0, table_size = 0, i;
+
+	memset(new_column, 0, sizeof(iuliia_column_t));
+	if(!scheme->mapping) return 0;
+
+	iuliiaIntGetFeatures(scheme, &features);
+
+	if(SIZE_MAX/sizeof(size_t)-1 < nof_strings) return 0;
+	new_column->offsets = malloc((nof_strings+1)*sizeof(size_t));
+	if(!new_column->offsets) goto IULIIA_ERROR;
+	new_column->offsets[0] = 0;
+
+	// Cyrillic letters take two bytes and become one or two Latin ones, so text keeps its size mostly
+	max_data = offsets[nof_strings] - offsets[0] + 16;
+	new_column->data = malloc(max_data);
+	if(!new_column->data) goto IULIIA_ERROR;
+
+	// Table of indexes+1 of strings with different texts, it is at most half full
+	if(flags & IULIIA_TRANSLATE_DEDUP) {
+		table_size = 16;
+		while(table_size < 2*nof_strings) {
+			if(SIZE_MAX/sizeof(size_t)/2 < table_size) goto IULIIA_ERROR;
+			table_size *= 2;
+		}
+		table = malloc(table_size*sizeof(size_t));
+		if(!table) goto IULIIA_ERROR;
+		memset(table, 0, table_size*sizeof(size_t));
+	}
+
+	for(i = 0; i < nof_strings; i++) {
+		const uint8_t *u8;
+		size_t u8_len, len = 0, j;
+
+		u8 = data + offsets[i];
+		u8_len = offsets[i+1] - offsets[i];
+		new_column->offsets[i+1] = new_column->offsets[i];
+
+		if(table) {
+			size_t *entry;
+
+			entry = table + (iuliiaIntColumnHash(u8, u8_len) & (table_size-1));
+			while(*entry) {
+				size_t k = *entry-1;
+
+				if(offsets[k+1]-offsets[k] == u8_len && !memcmp(data+offsets[k], u8, u8_len)) break;
+
+				entry++;
+				if(entry == table + table_size) entry = table;
+			}
+
+			// Translation of the same string is copied
+			if(*entry) {
+				size_t k = *entry-1, new_len;
+
+				new_len = new_column->offsets[k+1] - new_column->offsets[k];
+				if(!iuliiaIntColumnReserve(&(new_column->data), &max_data, new_column->offsets[i], new_len)) goto IULIIA_ERROR;
+				memcpy(new_column->data + new_column->offsets[i], new_column->data + new_column->offsets[k], new_len);
+				new_column->offsets[i+1] += new_len;
+
+				continue;
+			}
+
+			*entry = i+1;
+		}
+
+		// Characters are never more than bytes
+		while(max_s <= u8_len) {
+			if(!iuliiaIntGrowArray((void **)&s, &max_s, max_s, sizeof(uint32_t))) goto IULIIA_ERROR;
+		}
+		for(j = 0; j < u8_len; ) {
+			j += iuliiaIntCharU8toU32N(u8+j, u8_len-j, s+len);
+			if(!s[len]) goto IULIIA_ERROR;
+			len++;
+		}
+		s[len] = 0;
+
+		if(!iuliiaIntTranslateColumnString(s, scheme, &features, flags, &(new_column->data), &max_data, new_column->offsets+i+1)) goto IULIIA_ERROR;
+	}
+	new_column->nof_strings = nof_strings;
+
+	free(s);
+	free(table);
+
+	return 1;
+
+IULIIA_ERROR:
+
+	free(s);
+	free(table);
+	iuliiaFreeColumn(new_column);
+
+	return 0;
+}
+
+void iuliiaFreeColumn(iuliia_column_t *column)
+{
+	free(column->data);
+	free(column->offsets);
+	memset(column, 0, sizeof(iuliia_column_t));
+}
+
+// Stream keeps characters, which aren't translated yet, because rules may look at characters after them
+struct iuliia_stream_s {
+	const iuliia_scheme_t *scheme;
+	iuliia_scheme_features_t features;
+	unsigned int flags;
+	iuliia_translate_state_t state;
+	bool is_started;
+	uint8_t partial[4]; // Start of UTF-8 character cut by end of data
+	size_t nof_partial;
+	uint32_t *s; // Terminated by 0
+	size_t len;
+	size_t max_s;
+	size_t composed; // Characters before it are composed with IULIIA_TRANSLATE_NFC
+	uint8_t *out;
+	size_t max_out;
+};
+
+// Returns length of UTF-8 character by its first byte or 0, if it can't start character
+static size_t iuliiaIntU8CharLength(uint8_t u8)
+{
+	if(u8 < 0x80) return 1;
+	if((u8 & 0xe0) == 0xc0) return 2;
+	if((u8 & 0xf0) == 0xe0) return 3;
+	if((u8 & 0xf8) == 0xf0) return 4;
+
+	return 0;
+}
+
+iuliia_stream_t *iuliiaCreateStream(const iuliia_scheme_t *scheme, unsigned int flags)
+{
+	iuliia_stream_t *stream;
+
+	if(!scheme->mapping) return 0;
+
+	stream = malloc(sizeof(iuliia_stream_t));
+	if(!stream) return 0;
+	memset(stream, 0, sizeof(iuliia_stream_t));
+
+	stream->scheme = scheme;
+	stream->flags = flags;
+	iuliiaIntGetFeatures(scheme, &(stream->features));
+
+	return stream;
+}
+
+// Replaces bytes, which aren't valid UTF-8 character
+#define IULIIA_REPLACEMENT_CHAR 0xfffd
+
+// Decodes character at start of bytes. Every byte, which doesn't start valid character, becomes U+FFFD.
+// Returns number of used bytes or 0, if character may be continued by bytes after them
+static size_t iuliiaIntStreamDecodeChar(const uint8_t *u8, size_t len, bool is_last, uint32_t *c)
+{
+	size_t char_len, i;
+
+	if(!u8[0]) {
+		*c = 0;
+
+		return 1;
+	}
+
+	char_len = iuliiaIntU8CharLength(u8[0]);
+	if(char_len && len < char_len && !is_last) {
+		for(i = 1; i < len && (u8[i] & 0xc0) == 0x80; i++);
+		if(i == len) return 0;
+	}
+
+	if(!char_len || len < char_len) {
+		*c = IULIIA_REPLACEMENT_CHAR;
+
+		return 1;
+	}
+
+	iuliiaIntCharU8toU32N(u8, char_len, c);
+	if(*c) return char_len;
+
+	*c = IULIIA_REPLACEMENT_CHAR;
+
+	return 1;
+}
+
+// Appends characters of data to stream. Character cut by end of data is kept in partial and decoded
+// with the next data as if they weren't split, so output doesn't depend on splits.
+// NUL is kept and ends text for rules like end of string
+static bool iuliiaIntStreamDecode(iuliia_stream_t *stream, const uint8_t *data, size_t len, bool is_last)
+{
+	size_t i = 0, need, used;
+
+	// Every byte gives at most one character
+	if(SIZE_MAX/sizeof(uint32_t)-4 < stream->len+len) return false;
+	need = stream->len+len+4;
+	if(stream->max_s < need) {
+		uint32_t *new_s;
+
+		new_s = realloc(stream->s, need*sizeof(uint32_t));
+		if(!new_s) return false;
+		stream->s = new_s;
+		stream->max_s = need;
+	}
+
+	if(stream->nof_partial) {
+		uint8_t bytes[8];
+		size_t nof_bytes, nof_copied;
+
+		// Character, which starts in partial, ends in the first 4 bytes of data
+		nof_copied = len < 4 ? len : 4;
+		memcpy(bytes, stream->partial, stream->nof_partial);
+		memcpy(bytes+stream->nof_partial, data, nof_copied);
+		nof_bytes = stream->nof_partial+nof_copied;
+
+		used = 0;
+		while(used < stream->nof_partial) {
+			size_t char_len;
+
+			char_len = iuliiaIntStreamDecodeChar(bytes+used, nof_bytes-used, is_last || nof_copied < len, stream->s+stream->len);
+			if(!char_len) break;
+			stream->len++;
+			used += char_len;
+		}
+
+		if(used < stream->nof_partial) {
+			// All data continues partial
+			memcpy(stream->partial, bytes+used, nof_bytes-used);
+			stream->nof_partial = nof_bytes-used;
+			i = len;
+		} else {
+			i = used-stream->nof_partial;
+			stream->nof_partial = 0;
+		}
+	}
+
+	while(i < len) {
+		used = iuliiaIntStreamDecodeChar(data+i, len-i, is_last, stream->s+stream->len);
+		if(!used) {
+			memcpy(stream->partial, data+i, len-i);
+			stream->nof_partial = len-i;
+			break;
 		}
+		stream->len++;
+		i += used;
+	}
+	stream->s[stream->len] = 0;
+
+	return true;
+}
+
+// Composes characters, which are followed by character, which isn't combining mark
+static void iuliiaIntStreamCompose(iuliia_stream_t *stream, bool is_last)
+{
+	size_t src, dst;
+
+	src = dst = stream->composed;
+	while(src < stream->len) {
+		size_t end, used;
+
+		end = src+1;
+		while(end < stream->len && iuliiaIntIsCombiningMark(stream->s[end])) end++;
+		if(end == stream->len && !is_last) break;
+
+		stream->s[dst++] = iuliiaIntComposeChar(stream->s+src, &used);
+		src += used;
+	}
+
+	memmove(stream->s+dst, stream->s+src, (stream->len-src+1)*sizeof(uint32_t));
+	stream->len -= src-dst;
+	stream->composed = dst;
+}
+
+int iuliiaStreamTranslateU8(iuliia_stream_t *stream, const uint8_t *data, size_t len, int is_last, const uint8_t **new_data, size_t *new_len)
+{
+	size_t pos = 0, limit, lookahead;
+
+	*new_data = 0;
+	*new_len = 0;
+
+	if(!iuliiaIntStreamDecode(stream, data, len, is_last != 0)) return 0;
+
+	if(stream->flags & IULIIA_TRANSLATE_NFC)
+		iuliiaIntStreamCompose(stream, is_last != 0);
+	else
+		stream->composed = stream->len;
+
+	// Step reads two characters after current one, pattern needs character after it to check word end
+	lookahead = stream->features.has_patterns ? IULIIA_MAX_PATTERN_LENGTH+1 : 2;
+	if(is_last)
+		limit = stream->composed;
+	else
+		limit = stream->composed > lookahead ? stream->composed-lookahead : 0;
+
+	if(!stream->out) {
+		stream->max_out = 16;
+		stream->out = malloc(stream->max_out);
+		if(!stream->out) return 0;
+	}
+
+	while(pos < limit) {
+		const uint32_t *s, *repl;
+		uint32_t case_s;
+		size_t used;
+
+		s = stream->s+pos;
+		// NUL is copied and next characters are translated as new text
+		if(!*s) {
+			if(!iuliiaIntColumnPut(&(stream->out), &(stream->max_out), new_len, 0)) return 0;
+			stream->is_started = false;
+			pos++;
+			continue;
+		}
+		if(!stream->is_started) {
+			iuliiaIntTranslateStart(&(stream->state), *s, stream->scheme);
+			stream->is_started = true;
+		}
+
+		if(stream->features.has_patterns)
+			repl = iuliiaIntTranslateStepPatterns(s, stream->scheme, &(stream->features), &(stream->state), &used, &case_s);
+		else {
+			repl = iuliiaIntTranslateStep(s, stream->scheme, &(stream->features), &(stream->state), &used);
+			case_s = s[used-1];
+		}
+
+		if(repl) {
+			if(*repl) {
+				if(!iuliiaIntColumnPut(&(stream->out), &(stream->max_out), new_len, iuliiaU32IsUpper(case_s) ? iuliiaU32ToUpper(*repl) : *repl)) return 0;
+				repl++;
+			}
+			for(; *repl; repl++)
+				if(!iuliiaIntColumnPut(&(stream->out), &(stream->max_out), new_len, *repl)) return 0;
+		} else if(!iuliiaIntColumnPut(&(stream->out), &(stream->max_out), new_len, *s))
+			return 0;
 
-		free(scheme->ending_mapping);
+		pos += used;
 	}
 
-	if(scheme->nof_samples) {
-		size_t i;
+	memmove(stream->s, stream->s+pos, (stream->len-pos+1)*sizeof(uint32_t));
+	stream->len -= pos;
+	stream->composed -= pos;
 
-		for(i = 0; i < scheme->nof_samples; i++) {
-			free(scheme->samples[i].in);
-			free(scheme->samples[i].out);
-		}
+	// Next text starts from scratch
+	if(is_last) stream->is_started = false;
 
-		free(scheme->samples);
-	}
+	*new_data = stream->out;
 
-	free(scheme);
+	return 1;
 }
 
-static int iuliiaCompare1char(const iuliia_mapping_1char_t *a, const iuliia_mapping_1char_t *b)
+void iuliiaFreeStream(iuliia_stream_t *stream)
 {
-	return a->c - b->c;
+	if(!stream) return;
+
+	free(stream->s);
+	free(stream->out);
+	free(stream);
 }
 
-static int iuliiaCompare2char(const iuliia_mapping_2char_t *a, const iuliia_mapping_2char_t *b)
+// Queue depth of pool, when it isn't given
+#define IULIIA_DEFAULT_MAX_QUEUE 1024
+
+typedef struct {
+	const uint32_t *s;
+	const iuliia_scheme_t *scheme;
+	unsigned int flags;
+	iuliia_translate_callback_t callback;
+	void *user_data;
+} iuliia_async_task_t;
+
+// Submitted translations wait in ring buffer. Workers wait for has_task, drain waits for is_idle
+struct iuliia_pool_s {
+	iuliia_mutex_t lock;
+	iuliia_cond_t has_task;
+	iuliia_cond_t is_idle;
+	iuliia_async_task_t *tasks;
+	size_t max_tasks;
+	size_t first_task;
+	size_t nof_tasks;
+	size_t nof_running;
+	bool is_stopping;
+	iuliia_thread_t *threads;
+	unsigned int nof_threads;
+};
+
+IULIIA_THREAD_PROC(iuliiaIntPoolThread)
 {
-	if(a->c != b->c)
-		return a->c - b->c;
-	else
-		return a->cor_c - b->cor_c;
-}
+	iuliia_pool_t *pool;
 
-typedef int (* iuliia_comparator_t)(const void*, const void*);
+	pool = (iuliia_pool_t *)arg;
 
-void iuliiaPrepareScheme(iuliia_scheme_t *scheme)
-{
-	if(scheme->mapping && scheme->nof_mapping) qsort(scheme->mapping, scheme->nof_mapping, sizeof(iuliia_mapping_1char_t), (iuliia_comparator_t)iuliiaCompare1char);
-	if(scheme->prev_mapping && scheme->nof_prev_mapping) qsort(scheme->prev_mapping, scheme->nof_prev_mapping, sizeof(iuliia_mapping_2char_t), (iuliia_comparator_t)iuliiaCompare2char);
-	if(scheme->next_mapping && scheme->nof_next_mapping) qsort(scheme->next_mapping, scheme->nof_next_mapping, sizeof(iuliia_mapping_2char_t), (iuliia_comparator_t)iuliiaCompare2char);
-	if(scheme->ending_mapping && scheme->nof_ending_mapping) qsort(scheme->ending_mapping, scheme->nof_ending_mapping, sizeof(iuliia_mapping_2char_t), (iuliia_comparator_t)iuliiaCompare2char);
+	iuliiaIntMutexLock(&(pool->lock));
+	while(1) {
+		iuliia_async_task_t task;
+		uint32_t *new_s;
+
+		// Queued translations are done before pool stops
+		while(!pool->nof_tasks && !pool->is_stopping) iuliiaIntCondWait(&(pool->has_task), &(pool->lock));
+		if(!pool->nof_tasks) break;
+
+		task = pool->tasks[pool->first_task];
+		pool->first_task = (pool->first_task+1) % pool->max_tasks;
+		pool->nof_tasks--;
+		pool->nof_running++;
+		iuliiaIntMutexUnlock(&(pool->lock));
+
+		new_s = iuliiaTranslateExU32(task.s, task.scheme, task.flags);
+		task.callback(task.user_data, new_s);
+
+		iuliiaIntMutexLock(&(pool->lock));
+		pool->nof_running--;
+		if(!pool->nof_tasks && !pool->nof_running) iuliiaIntCondBroadcast(&(pool->is_idle));
+	}
+	iuliiaIntMutexUnlock(&(pool->lock));
+
+	return 0;
 }
 
-iuliia_scheme_t *iuliiaLoadSchemeFromFile(FILE *f)
+iuliia_pool_t *iuliiaCreatePool(unsigned int nthreads, size_t max_queue)
 {
-	char *json;
-	size_t json_length;
-	long long f_size;
-	iuliia_scheme_t *scheme;
+	iuliia_pool_t *pool;
+	bool has_lock = false, has_task = false, is_idle = false;
 
-	if(!f) return 0;
+	if(!nthreads) nthreads = iuliiaIntCpuCount();
+	if(!max_queue) max_queue = IULIIA_DEFAULT_MAX_QUEUE;
+	if(SIZE_MAX/sizeof(iuliia_async_task_t) < max_queue) return 0;
 
-	if(fseek(f, 0, SEEK_END)) return 0;
+	pool = malloc(sizeof(iuliia_pool_t));
+	if(!pool) return 0;
+	memset(pool, 0, sizeof(iuliia_pool_t));
 
-#if defined(_WIN32)
-	f_size = _ftelli64(f);
-#else
-	f_size = ftello64(f);
-#endif
-	if(f_size >= SIZE_MAX) return 0;
+	pool->max_tasks = max_queue;
+	pool->tasks = malloc(max_queue*sizeof(iuliia_async_task_t));
+	pool->threads = malloc(nthreads*sizeof(iuliia_thread_t));
+	if(!pool->tasks || !pool->threads) goto IULIIA_ERROR;
 
-	json_length = (size_t)f_size;
+	has_lock = iuliiaIntMutexInit(&(pool->lock));
+	has_task = iuliiaIntCondInit(&(pool->has_task));
+	is_idle = iuliiaIntCondInit(&(pool->is_idle));
+	if(!has_lock || !has_task || !is_idle) goto IULIIA_ERROR;
 
-	if(fseek(f, 0, SEEK_SET)) return 0;
+	for(; pool->nof_threads < nthreads; pool->nof_threads++)
+		if(!iuliiaIntThreadCreate(pool->threads + pool->nof_threads, iuliiaIntPoolThread, pool)) break;
+	if(!pool->nof_threads) goto IULIIA_ERROR;
 
-	json = malloc(json_length+1);
-	if(!json) return 0;
-	json[json_length] = 0;
+	return pool;
 
-	if(fread(json, 1, json_length, f) != json_length) {
-		free(json);
+IULIIA_ERROR:
 
-		return 0;
-	}
+	if(has_lock) iuliiaIntMutexDestroy(&(pool->lock));
+	if(has_task) iuliiaIntCondDestroy(&(pool->has_task));
+	if(is_idle) iuliiaIntCondDestroy(&(pool->is_idle));
+	free(pool->tasks);
+	free(pool->threads);
+	free(pool);
 
-	scheme = iuliiaLoadSchemeFromMemory(json, json_length);
+	return 0;
+}
 
-	free(json);
+// Puts translations to queue, which has room for them. Called with locked pool
+static void iuliiaIntPoolPush(iuliia_pool_t *pool, const uint32_t *const *s, size_t nof_strings, const iuliia_scheme_t *scheme, unsigned int flags, iuliia_translate_callback_t callback, void *const *user_data)
+{
+	size_t i;
 
-	return scheme;
+	for(i = 0; i < nof_strings; i++) {
+		iuliia_async_task_t *task;
+
+		task = pool->tasks + (pool->first_task + pool->nof_tasks) % pool->max_tasks;
+		task->s = s[i];
+		task->scheme = scheme;
+		task->flags = flags;
+		task->callback = callback;
+		task->user_data = user_data ? user_data[i] : 0;
+		pool->nof_tasks++;
+	}
+
+	if(nof_strings == 1)
+		iuliiaIntCondSignal(&(pool->has_task));
+	else if(nof_strings)
+		iuliiaIntCondBroadcast(&(pool->has_task));
 }
 
-#if !defined(_WIN32)
-static FILE *_wfopen(const wchar_t *filename, const wchar_t *mode)
+int iuliiaTranslateAsyncBatch(iuliia_pool_t *pool, const uint32_t *const *s, size_t nof_strings, const iuliia_scheme_t *scheme, unsigned int flags, iuliia_translate_callback_t callback, void *const *user_data)
 {
-	size_t filename_len, mode_len;
-	char *cfilename = 0, *cmode = 0;
-	FILE *f = 0;
-
-	filename_len = wcslen(filename);
-	mode_len = wcslen(mode);
+	if(!scheme->mapping) {
+		errno = EINVAL;
 
-	if(SIZE_MAX/MB_CUR_MAX <= filename_len || SIZE_MAX/MB_CUR_MAX <= mode_len) {
-		errno = ENAMETOOLONG;
 		return 0;
 	}
 
-	cfilename = malloc(filename_len * MB_CUR_MAX + 1);
-	cmode = malloc(mode_len * MB_CUR_MAX + 1);
-	if(!cfilename || !cmode) {
-		errno = ENOMEM;
-		goto FINAL;
-	}
+	iuliiaIntMutexLock(&(pool->lock));
 
-	if(wcstombs(cfilename, filename, filename_len * MB_CUR_MAX + 1) == (size_t)(-1)) {
+	if(pool->is_stopping) {
+		iuliiaIntMutexUnlock(&(pool->lock));
 		errno = EINVAL;
-		goto FINAL;
+
+		return 0;
 	}
 
-	if(wcstombs(cmode, mode, mode_len * MB_CUR_MAX + 1) == (size_t)(-1)) {
-		errno = EINVAL;
-		goto FINAL;
+	// Batch larger than queue never has room
+	if(pool->max_tasks - pool->nof_tasks < nof_strings) {
+		iuliiaIntMutexUnlock(&(pool->lock));
+		errno = nof_strings > pool->max_tasks ? E2BIG : EAGAIN;
+
+		return 0;
 	}
 
-	f = fopen(cfilename, cmode);
+	iuliiaIntPoolPush(pool, s, nof_strings, scheme, flags, callback, user_data);
+	iuliiaIntMutexUnlock(&(pool->lock));
 
-FINAL:
-	if(cfilename) free(cfilename);
-	if(cmode) free(cmode);
+	return 1;
+}
 
-	return f;
+int iuliiaTranslateAsync(iuliia_pool_t *pool, const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags, iuliia_translate_callback_t callback, void *user_data)
+{
+	return iuliiaTranslateAsyncBatch(pool, &s, 1, scheme, flags, callback, &user_data);
 }
-#endif
 
-iuliia_scheme_t *iuliiaLoadSchemeW(const wchar_t *filename)
+void iuliiaDrainPool(iuliia_pool_t *pool)
 {
-	FILE *f;
-	iuliia_scheme_t *scheme;
+	iuliiaIntMutexLock(&(pool->lock));
+	while(pool->nof_tasks || pool->nof_running) iuliiaIntCondWait(&(pool->is_idle), &(pool->lock));
+	iuliiaIntMutexUnlock(&(pool->lock));
+}
 
-	f = _wfopen(filename, L"rb");
-	if(!f) return 0;
+void iuliiaFreePool(iuliia_pool_t *pool)
+{
+	unsigned int i;
 
-	scheme = iuliiaLoadSchemeFromFile(f);
+	if(!pool) return;
 
-	fclose(f);
+	iuliiaIntMutexLock(&(pool->lock));
+	pool->is_stopping = true;
+	iuliiaIntCondBroadcast(&(pool->has_task));
+	iuliiaIntMutexUnlock(&(pool->lock));
 
-	return scheme;
+	for(i = 0; i < pool->nof_threads; i++) iuliiaIntThreadJoin(pool->threads[i]);
+
+	iuliiaIntMutexDestroy(&(pool->lock));
+	iuliiaIntCondDestroy(&(pool->has_task));
+	iuliiaIntCondDestroy(&(pool->is_idle));
+	free(pool->tasks);
+	free(pool->threads);
+	free(pool);
 }
 
-iuliia_scheme_t *iuliiaLoadSchemeA(const char *filename)
+static bool iuliiaIntIsContextFree(const iuliia_scheme_t *scheme)
 {
-	FILE *f;
-	iuliia_scheme_t *scheme;
+	iuliia_scheme_features_t features;
 
-	f = fopen(filename, "rb");
-	if(!f) return 0;
-
-	scheme = iuliiaLoadSchemeFromFile(f);
-
-	fclose(f);
+	iuliiaIntGetFeatures(scheme, &features);
 
-	return scheme;
+	return !features.has_prev && !features.has_next && !features.has_ending;
 }
 
-size_t iuliiaU32len(const uint32_t *s)
+// Checks, if character is key or context of any rule of scheme
+static bool iuliiaIntSchemeUsesChar(const iuliia_scheme_t *scheme, uint32_t c)
 {
-	size_t size = 0;
-	
-	while(*(s++) != 0) size++;
-	
-	return size;
+	size_t i;
+
+	for(; scheme; scheme = scheme->base) {
+		if(iuliiaBsearch1char(c, scheme->mapping, scheme->nof_mapping)) return true;
+
+		for(i = 0; i < scheme->nof_prev_mapping; i++)
+			if(scheme->prev_mapping[i].c == c || scheme->prev_mapping[i].cor_c == c) return true;
+		for(i = 0; i < scheme->nof_next_mapping; i++)
+			if(scheme->next_mapping[i].c == c || scheme->next_mapping[i].cor_c == c) return true;
+		for(i = 0; i < scheme->nof_ending_mapping; i++)
+			if(scheme->ending_mapping[i].c == c || scheme->ending_mapping[i].cor_c == c) return true;
+	}
+
+	return false;
 }
 
-wchar_t *iuliiaU32toW(const uint32_t *s)
+// Applies context free scheme to replacement. Capitalized replacement should
+// become capitalized result, otherwise rules can't be composed
+static uint32_t *iuliiaIntComposeReplacement(const uint32_t *repl, uint32_t case_c, const iuliia_scheme_t *second)
 {
-	size_t s_len;
-	wchar_t *new_s;
+	uint32_t *new_repl, *upper_repl = 0, *new_upper_repl = 0;
+	size_t len;
 
-	s_len = iuliiaU32len(s);
-	new_s = malloc((s_len+1)*sizeof(uint32_t));
-	if(!new_s) return 0;
-	
-	if(sizeof(uint32_t) == sizeof(wchar_t)) {
-		memcpy(new_s, s, (s_len+1)*sizeof(wchar_t));
-	} else {
-		wchar_t *p;
-		
-		p = new_s;
-		while(1) {
-			if(*s < 65536)
-				*p = *s;
-			else {
-				*p = (*s-0x10000) >> 10 | 0xd800;
-				p++;
-				*p = ((*s-0x10000) & 0x3ff) | 0xdc00;
-			}
+	new_repl = iuliiaTranslateU32(repl, second);
+	if(!new_repl) return 0;
 
-			if(*s == 0) break;
+	if(!*repl || iuliiaU32ToUpper(case_c) == case_c) return new_repl;
 
+	len = iuliiaU32len(repl);
+	upper_repl = malloc((len+1)*sizeof(uint32_t));
+	if(!upper_repl) goto IULIIA_ERROR;
+	memcpy(upper_repl, repl, (len+1)*sizeof(uint32_t));
+	upper_repl[0] = iuliiaU32ToUpper(upper_repl[0]);
+
+	new_upper_repl = iuliiaTranslateU32(upper_repl, second);
+	if(!new_upper_repl) goto IULIIA_ERROR;
+
+	if(new_upper_repl[0] != (new_repl[0] ? iuliiaU32ToUpper(new_repl[0]) : 0)) goto IULIIA_ERROR;
+	if(new_repl[0]) {
+		const uint32_t *p, *q;
+
+		p = new_repl+1;
+		q = new_upper_repl+1;
+		while(*p && *p == *q) {
 			p++;
-			s++;
+			q++;
 		}
+		if(*p != *q) goto IULIIA_ERROR;
 	}
-	
-	return new_s;
+
+	free(upper_repl);
+	free(new_upper_repl);
+
+	return new_repl;
+
+IULIIA_ERROR:
+
+	free(new_repl);
+	free(upper_repl);
+	free(new_upper_repl);
+
+	return 0;
 }
 
-uint32_t *iuliiaWtoU32(const wchar_t *s)
+iuliia_compiled_scheme_t *iuliiaComposeSchemes(const iuliia_scheme_t *first, const iuliia_scheme_t *second)
 {
-	size_t s_len;
-	uint32_t *new_s;
+	iuliia_compiled_scheme_t *compiled = 0;
+	iuliia_scheme_t *composed = 0;
+	iuliia_builder_t flat, builder;
+	size_t i, j;
+
+	iuliiaIntBuilderInit(&flat);
+	iuliiaIntBuilderInit(&builder);
+
+	if(!first->mapping || !second->mapping) goto IULIIA_ERROR;
+	// Patterns aren't composed
+	if((iuliiaIntEngineOf(first) | iuliiaIntEngineOf(second)) & IULIIA_ENGINE_PATTERNS) goto IULIIA_ERROR;
+
+	// Rules of first scheme without repeats
+	if(!iuliiaBuilderAddScheme(&flat, first)) goto IULIIA_ERROR;
+	iuliiaIntBuilderSortRules(&flat);
+
+	// Characters without rules in first scheme are translated by second one
+	if(!iuliiaBuilderAddScheme(&builder, second)) goto IULIIA_ERROR;
+
+	if(iuliiaIntIsContextFree(second)) {
+		// Second scheme translates characters one by one, so it can be applied to replacements of first one
+		for(i = 0; i < IULIIA_NOF_TABLES; i++) {
+			const iuliia_builder_table_t *t;
+
+			t = flat.tables + i;
+			for(j = 0; j < t->nof_rules; j++) {
+				uint32_t *repl;
+				int is_added;
+
+				// Case of word ending is taken from its last character
+				repl = iuliiaIntComposeReplacement(flat.pool + t->rules[j].repl, i == IULIIA_TABLE_ENDING ? t->rules[j].cor_c : t->rules[j].c, second);
+				if(!repl) goto IULIIA_ERROR;
+
+				is_added = iuliiaBuilderAddRule(&builder, (int)i, t->rules[j].c, t->rules[j].cor_c, repl);
+				free(repl);
+				if(!is_added) goto IULIIA_ERROR;
+			}
+		}
+	} else if(iuliiaIntIsContextFree(first)) {
+		// Replacements of first scheme pass through second one unchanged, if they
+		// and replaced characters aren't letters and aren't used by rules of second scheme
+		const iuliia_builder_table_t *t;
+
+		t = flat.tables + IULIIA_TABLE_MAPPING;
+		for(j = 0; j < t->nof_rules; j++) {
+			const uint32_t *repl;
+
+			repl = flat.pool + t->rules[j].repl;
+			if(!*repl) goto IULIIA_ERROR;
+			if(iuliiaU32IsAlpha(t->rules[j].c) || iuliiaIntSchemeUsesChar(second, t->rules[j].c)) goto IULIIA_ERROR;
+			for(; *repl; repl++)
+				if(iuliiaU32IsAlpha(*repl) || iuliiaIntSchemeUsesChar(second, *repl)) goto IULIIA_ERROR;
+
+			if(!iuliiaBuilderAddRule(&builder, IULIIA_TABLE_MAPPING, t->rules[j].c, 0, flat.pool + t->rules[j].repl)) goto IULIIA_ERROR;
+		}
+	} else
+		goto IULIIA_ERROR;
 
-	s_len = wcslen(s);
-	if(SIZE_MAX/sizeof(uint32_t) <= s_len) return 0;
-	new_s = malloc((s_len+1)*sizeof(uint32_t));
-	if(!new_s) return 0;
+	composed = iuliiaBuilderMakeScheme(&builder);
+	if(!composed) goto IULIIA_ERROR;
 
-	if(sizeof(uint32_t) == sizeof(wchar_t)) {
-		memcpy(new_s, s, (s_len+1)*sizeof(wchar_t));
+	compiled = iuliiaIntWrapScheme(composed, 0);
+	if(!compiled) goto IULIIA_ERROR;
+
+	iuliiaIntBuilderDestroy(&flat);
+	iuliiaIntBuilderDestroy(&builder);
+
+	return compiled;
+
+IULIIA_ERROR:
+
+	iuliiaFreeScheme(composed);
+	iuliiaIntBuilderDestroy(&flat);
+	iuliiaIntBuilderDestroy(&builder);
+
+	return 0;
+}
+
+// Chain translates text by several schemes at once. Every stage keeps only
+// characters, which next stage hasn't used yet
+typedef struct {
+	const iuliia_scheme_t *scheme;
+	iuliia_scheme_features_t features;
+	iuliia_translate_state_t state;
+	bool is_started;
+	bool is_finished;
+	uint32_t *out;
+	size_t out_start;
+	size_t out_len;
+	size_t max_out;
+} iuliia_chain_stage_t;
+
+typedef struct {
+	const uint32_t *s;
+	size_t s_len; // Characters of s, which are known to be before end of text
+	iuliia_chain_stage_t *stages;
+	bool error;
+} iuliia_chain_t;
+
+static bool iuliiaIntChainStep(iuliia_chain_t *chain, size_t stage);
+
+// Returns i-th not used character of stage output. Stage 0 is input text
+static uint32_t iuliiaIntChainPeek(iuliia_chain_t *chain, size_t stage, size_t i)
+{
+	iuliia_chain_stage_t *st;
+
+	// Input is scanned once, end of text isn't looked for again at every peek
+	if(!stage) {
+		while(chain->s_len <= i && chain->s[chain->s_len]) chain->s_len++;
+
+		return i < chain->s_len ? chain->s[i] : 0;
+	}
+
+	st = chain->stages + stage-1;
+	while(st->out_len <= i && !st->is_finished) {
+		if(!iuliiaIntChainStep(chain, stage)) {
+			chain->error = true;
+
+			return 0;
+		}
+	}
+
+	return i < st->out_len ? st->out[st->out_start+i] : 0;
+}
+
+static void iuliiaIntChainTake(iuliia_chain_t *chain, size_t stage, size_t n)
+{
+	if(!stage) {
+		chain->s += n;
+		chain->s_len -= n;
 	} else {
-		uint32_t *p;
-		
-		p = new_s;
-		while(1) {
-			if(*s < 0xd800 || *s > 0xdfff)
-				*p = *s;
-			else {
-				if(*s >= 0xdc00) {
-					free(new_s);
-					
-					return 0;
-				}
-				
-				*p = ((*s) & 0x3ff) << 10;
-				s++;
-				
-				if(*s < 0xdc00 || *s > 0xdfff) {
-					free(new_s);
-					
-					return 0;
-				}
-				
-				*p = *p + ((*s) & 0x3ff) + 0x10000;
-			}
+		chain->stages[stage-1].out_start += n;
+		chain->stages[stage-1].out_len -= n;
+	}
+}
+
+static bool iuliiaIntChainPut(iuliia_chain_stage_t *st, uint32_t c)
+{
+	if(!iuliiaIntGrowArray((void **)&(st->out), &(st->max_out), st->out_start+st->out_len, sizeof(uint32_t))) return false;
+
+	st->out[st->out_start+st->out_len] = c;
+	st->out_len++;
+
+	return true;
+}
+
+// Translates next characters of previous stage
+static bool iuliiaIntChainStep(iuliia_chain_t *chain, size_t stage)
+{
+	iuliia_chain_stage_t *st;
+	const uint32_t *repl;
+	uint32_t s[IULIIA_MAX_PATTERN_LENGTH+2], case_s;
+	size_t used, len, i;
+
+	st = chain->stages + stage-1;
+
+	// Pattern needs character after it to check word end
+	len = st->features.has_patterns ? IULIIA_MAX_PATTERN_LENGTH+1 : 3;
+	s[0] = iuliiaIntChainPeek(chain, stage-1, 0);
+	for(i = 1; i < len; i++)
+		s[i] = s[i-1] ? iuliiaIntChainPeek(chain, stage-1, i) : 0;
+	s[len] = 0;
+	if(chain->error) return false;
+
+	if(!s[0]) {
+		st->is_finished = true;
+
+		return true;
+	}
+
+	if(!st->is_started) {
+		iuliiaIntTranslateStart(&(st->state), s[0], st->scheme);
+		st->is_started = true;
+	}
+
+	if(st->features.has_patterns)
+		repl = iuliiaIntTranslateStepPatterns(s, st->scheme, &(st->features), &(st->state), &used, &case_s);
+	else {
+		repl = iuliiaIntTranslateStep(s, st->scheme, &(st->features), &(st->state), &used);
+		case_s = s[used-1];
+	}
+	iuliiaIntChainTake(chain, stage-1, used);
+
+	if(st->out_start) {
+		memmove(st->out, st->out+st->out_start, st->out_len*sizeof(uint32_t));
+		st->out_start = 0;
+	}
+
+	if(!repl) return iuliiaIntChainPut(st, s[0]);
+
+	if(*repl) {
+		if(!iuliiaIntChainPut(st, iuliiaU32IsUpper(case_s) ? iuliiaU32ToUpper(*repl) : *repl)) return false;
+		repl++;
+	}
+	while(*repl) {
+		if(!iuliiaIntChainPut(st, *repl)) return false;
+		repl++;
+	}
+
+	return true;
+}
+
+uint32_t *iuliiaTranslateChainU32(const uint32_t *s, const iuliia_scheme_t *const *schemes, size_t nof_schemes)
+{
+	iuliia_chain_t chain;
+	uint32_t *new_s = 0, c;
+	size_t new_len = 0, max_new_len = 0, i;
+
+	if(!nof_schemes) return 0;
+	for(i = 0; i < nof_schemes; i++)
+		if(!schemes[i]->mapping) return 0;
+
+	if(SIZE_MAX/sizeof(iuliia_chain_stage_t) < nof_schemes) return 0;
+	chain.s = s;
+	chain.s_len = 0;
+	chain.error = false;
+	chain.stages = malloc(nof_schemes*sizeof(iuliia_chain_stage_t));
+	if(!chain.stages) return 0;
+	memset(chain.stages, 0, nof_schemes*sizeof(iuliia_chain_stage_t));
+
+	for(i = 0; i < nof_schemes; i++) {
+		chain.stages[i].scheme = schemes[i];
+		iuliiaIntGetFeatures(schemes[i], &(chain.stages[i].features));
+	}
+
+	while(1) {
+		c = iuliiaIntChainPeek(&chain, nof_schemes, 0);
+		if(chain.error) goto IULIIA_ERROR;
 
-			if(*s == 0) break;
+		if(!iuliiaIntGrowArray((void **)&new_s, &max_new_len, new_len, sizeof(uint32_t))) goto IULIIA_ERROR;
+		new_s[new_len++] = c;
+		if(!c) break;
 
-			p++;
-			s++;
-		}
+		iuliiaIntChainTake(&chain, nof_schemes, 1);
 	}
-	
+
+	for(i = 0; i < nof_schemes; i++) free(chain.stages[i].out);
+	free(chain.stages);
+
 	return new_s;
+
+IULIIA_ERROR:
+
+	free(new_s);
+	for(i = 0; i < nof_schemes; i++) free(chain.stages[i].out);
+	free(chain.stages);
+
+	return 0;
 }
 
-const uint8_t *iuliiaCharU8toU32(const uint8_t *u8, uint32_t *u32)
+// Adds pattern of inverse scheme, which is made of replacement of rule and replacements of
+// its context. Patterns, which are empty or too long, are skipped
+static bool iuliiaIntInverseAddPattern(iuliia_builder_t *builder, const uint32_t *prefix, const uint32_t *repl, const uint32_t *suffix, unsigned int flags, const uint32_t *source)
 {
-	uint32_t new_u32 = 0;
-	const uint8_t *pu8;
-	
-	pu8 = u8;
+	uint32_t pattern[IULIIA_MAX_PATTERN_LENGTH+1];
+	const uint32_t *parts[3];
+	size_t len = 0, i;
+
+	parts[0] = prefix;
+	parts[1] = repl;
+	parts[2] = suffix;
+	for(i = 0; i < 3; i++) {
+		const uint32_t *p;
+
+		if(!parts[i]) continue;
+		for(p = parts[i]; *p; p++) {
+			if(len == IULIIA_MAX_PATTERN_LENGTH) return true;
+			pattern[len++] = *p;
+		}
+	}
+	if(!len) return true;
+	pattern[len] = 0;
 
-	if(*pu8 < 0x80) {
-		new_u32 = *pu8;
-		pu8++;
-	} else {
-		if((*pu8 & 0xe0) == 0xc0) {
-			new_u32 = (*pu8 & 0x1f) << 6;
-			pu8++;
-			if(!(*pu8)) return 0;
-			if((*pu8 & 0xc0) == 0x80) {
-				new_u32 += *pu8 & 0x3f;
-				pu8++;
-			} else return 0;
-		} else if((*pu8 & 0xf0) == 0xe0) {
-			new_u32 = (*pu8 & 0xf) << 12;
-			pu8++;
+	return iuliiaBuilderAddPattern(builder, pattern, flags, source) != 0;
+}
 
-			if(!(*pu8)) return 0;
-			if((*pu8 & 0xc0) == 0x80) {
-				new_u32 += (*pu8 & 0x3f) << 6;
-				pu8++;
-			} else return 0;
+// Word endings like "ий" follow consonant. After vowel the same replacement is usually made by rule
+// of one character, like "ой" -> "oy", so ending isn't guessed there
+static bool iuliiaIntIsConsonant(uint32_t c)
+{
+	c = iuliiaU32ToLower(c);
+	if(c < 0x431 || c > 0x449) return false;
 
-			if (!(*pu8)) return 0;
-			if((*pu8 & 0xc0) == 0x80) {
-				new_u32 += *pu8 & 0x3f;
-				pu8++;
-			} else return 0;
-		} else if((*pu8 & 0xf8) == 0xf0) {
-			new_u32 = (*pu8 & 0xf) << 18;
-			pu8++;
+	return c != 0x435 && c != 0x438 && c != 0x439 && c != 0x43e && c != 0x443;
+}
 
-			if(!(*pu8)) return 0;
-			if((*pu8 & 0xc0) == 0x80) {
-				new_u32 += (*pu8 & 0x3f) << 12;
-				pu8++;
-			} else return 0;
+iuliia_scheme_t *iuliiaMakeInverseScheme(const iuliia_scheme_t *scheme)
+{
+	iuliia_scheme_t *flat = 0, *inverse = 0;
+	iuliia_builder_t flat_builder, builder;
+	size_t i;
 
-			if(!(*pu8)) return 0;
-			if((*pu8 & 0xc0) == 0x80) {
-				new_u32 += (*pu8 & 0x3f) << 6;
-				pu8++;
-			} else return 0;
+	iuliiaIntBuilderInit(&flat_builder);
+	iuliiaIntBuilderInit(&builder);
 
-			if (!(*pu8)) return 0;
-			if((*pu8 & 0xc0) == 0x80) {
-				new_u32 += *pu8 & 0x3f;
-				pu8++;
-			} else return 0;
-		} else // TODO: Fix this
-			return 0;
-	} 
+	if(!scheme->mapping) goto END;
 
-	*u32 = new_u32;
+	// Rules of scheme and schemes it overlays without repeats
+	if(!iuliiaBuilderAddScheme(&flat_builder, scheme)) goto END;
+	flat = iuliiaBuilderMakeScheme(&flat_builder);
+	if(!flat) goto END;
 
-	return pu8;
-}
+	// Trie finds the last added of repeated patterns, so less common sources are added first:
+	// rules with next and previous characters, word endings, direct mapping and patterns
+	for(i = flat->nof_next_mapping; i > 0; i--) {
+		const iuliia_mapping_2char_t *rule;
+		const uint32_t *cor_repl;
+		uint32_t source[3];
 
-uint32_t *iuliiaU8toU32(const uint8_t *u8)
-{
-	const uint8_t *pu8;
-	uint32_t *u32, *pu32;
-	size_t str_size;
+		rule = flat->next_mapping + i-1;
+		cor_repl = iuliiaIntFind1char(rule->cor_c, flat);
+		if(!cor_repl) continue;
 
-	str_size = strlen((const char *)u8);
+		source[0] = rule->c;
+		source[1] = rule->cor_c;
+		source[2] = 0;
+		if(!iuliiaIntInverseAddPattern(&builder, 0, rule->repl, cor_repl, 0, source)) goto END;
+	}
 
-	if(SIZE_MAX/sizeof(uint32_t) <= str_size) return 0;
+	for(i = flat->nof_prev_mapping; i > 0; i--) {
+		const iuliia_mapping_2char_t *rule;
+		uint32_t source[3];
 
-	u32 = malloc((str_size+1)*sizeof(uint32_t));
-	if(!u32) return 0;
+		rule = flat->prev_mapping + i-1;
+		if(!rule->cor_c) {
+			source[0] = rule->c;
+			source[1] = 0;
+			if(!iuliiaIntInverseAddPattern(&builder, 0, rule->repl, 0, IULIIA_PATTERN_WORD_START, source)) goto END;
+		} else {
+			const uint32_t *cor_repl;
 
-	pu8 = u8;
-	pu32 = u32;
-	while(1) {
-		bool need_break = false;
+			cor_repl = iuliiaIntFind1char(rule->cor_c, flat);
+			if(!cor_repl) continue;
 
-		if (*pu8 == 0) need_break = true;
+			source[0] = rule->cor_c;
+			source[1] = rule->c;
+			source[2] = 0;
+			if(!iuliiaIntInverseAddPattern(&builder, cor_repl, rule->repl, 0, 0, source)) goto END;
+		}
+	}
 
-		pu8 = iuliiaCharU8toU32(pu8, pu32);
-		if(!pu8) {
-			free(u32);
+	// Ending is preceded by replacement of consonant, which makes the same source character
+	for(i = flat->nof_ending_mapping; i > 0; i--) {
+		const iuliia_mapping_2char_t *rule;
+		size_t j;
 
-			return 0;
+		rule = flat->ending_mapping + i-1;
+		for(j = flat->nof_mapping; j > 0; j--) {
+			const iuliia_mapping_1char_t *prefix;
+			uint32_t source[4];
+
+			prefix = flat->mapping + j-1;
+			if(!iuliiaIntIsConsonant(prefix->c) || !prefix->repl[0]) continue;
+
+			source[0] = prefix->c;
+			source[1] = rule->c;
+			source[2] = rule->cor_c;
+			source[3] = 0;
+			if(!iuliiaIntInverseAddPattern(&builder, prefix->repl, rule->repl, 0, IULIIA_PATTERN_WORD_END, source)) goto END;
 		}
+	}
 
-		if(need_break) break;
+	for(i = flat->nof_mapping; i > 0; i--) {
+		uint32_t source[2];
 
-		pu32++;
+		source[0] = flat->mapping[i-1].c;
+		source[1] = 0;
+		if(!iuliiaIntInverseAddPattern(&builder, 0, flat->mapping[i-1].repl, 0, 0, source)) goto END;
 	}
 
-	return u32;
-}
+	for(i = flat->nof_pattern_mapping; i > 0; i--) {
+		const iuliia_mapping_pattern_t *pattern;
 
-uint32_t iuliiaU32ToLower(uint32_t c)
-{
-	if(c < 128) {
-		if(c >= 'A' && c <= 'Z')
-			return c + 32;
-		else
-			return c;
-	} else if(c == 0x401) return 0x451;
-	else if(c >= 0x410 && c <= 0x44F) {
-		if(c <= 0x42F)
-			return c + 32;
-		else
-			return c;
-	} if(c < 65536)
-		return towlower(c);
-	else
-		return c;
+		pattern = flat->pattern_mapping + i-1;
+		if(!iuliiaIntInverseAddPattern(&builder, 0, pattern->repl, 0, pattern->flags, pattern->pattern)) goto END;
+	}
+
+	inverse = iuliiaBuilderMakeScheme(&builder);
+
+END:
+	iuliiaFreeScheme(flat);
+	iuliiaIntBuilderDestroy(&flat_builder);
+	iuliiaIntBuilderDestroy(&builder);
+
+	return inverse;
 }
 
-uint32_t iuliiaU32ToUpper(uint32_t c)
+// Candidates are made by paths through positions of text. Every position keeps at most
+// max_candidates paths, which end there, so the number of paths grows linearly with text length
+typedef struct {
+	const uint32_t *repl; // 0 - character is kept
+	uint32_t case_s; // Character, which case is applied to replacement
+	size_t used;
+} iuliia_candidate_match_t;
+
+typedef struct {
+	size_t prev; // Path, which this one continues (SIZE_MAX - start of text)
+	size_t next; // Next path, which ends at the same position (SIZE_MAX - none)
+	size_t start; // Position of last match
+	iuliia_candidate_match_t match;
+} iuliia_candidate_path_t;
+
+static bool iuliiaIntSamePattern(const iuliia_mapping_pattern_t *a, const iuliia_mapping_pattern_t *b)
 {
-	if(c < 65536)
-		return towupper(c);
-	else
-		return c;
+	const uint32_t *s_a, *s_b;
+
+	if(a->flags != b->flags) return false;
+
+	for(s_a = a->pattern, s_b = b->pattern; *s_a && *s_a == *s_b; s_a++, s_b++);
+
+	return *s_a == *s_b;
 }
 
-int iuliiaU32IsUpper(uint32_t c)
+static bool iuliiaIntAddCandidateMatch(iuliia_candidate_match_t **matches, size_t *nof_matches, size_t *max_matches, const uint32_t *repl, uint32_t case_s, size_t used)
 {
-	if(c >= 'A' && c <= 'Z')
-		return 1;
-	else if(c >= 0x410 && c <= 0x42F)
-		return 1;
-	else if(c < 65536)
-		return iswupper(c);
-	else
-		return 0;
-}
+	if(!iuliiaIntGrowArray((void **)matches, max_matches, *nof_matches, sizeof(iuliia_candidate_match_t))) return false;
 
-int iuliiaU32IsAlpha(uint32_t c) {
-	if(c < 65536)
-		return iswalpha(c);
-	else
-		return 0;
+	(*matches)[*nof_matches].repl = repl;
+	(*matches)[*nof_matches].case_s = case_s;
+	(*matches)[*nof_matches].used = used;
+	(*nof_matches)++;
+
+	return true;
 }
 
-static uint32_t *iuliiaBsearch1char(uint32_t c, const iuliia_mapping_1char_t *mapping, size_t size)
+// Finds all patterns, which can be used at position of text, with all their repeats.
+// If there are no such patterns, finds rule, which translation uses there
+static bool iuliiaIntFindCandidateMatches(const uint32_t *s, size_t pos, const iuliia_scheme_t *scheme, const iuliia_scheme_features_t *features, iuliia_candidate_match_t **matches, size_t *nof_matches, size_t *max_matches)
 {
-	size_t start, end;
+	static const unsigned int pattern_flags[4] = { IULIIA_PATTERN_WORD_START | IULIIA_PATTERN_WORD_END, IULIIA_PATTERN_WORD_START, IULIIA_PATTERN_WORD_END, 0 };
+	const iuliia_scheme_t *current;
+	iuliia_translate_state_t state;
+	const uint32_t *repl;
+	bool word_start;
+	size_t used;
+
+	*nof_matches = 0;
+	word_start = !pos || !iuliiaU32IsAlpha(s[pos-1]);
+
+	for(current = scheme; current; current = current->base) {
+		const iuliia_pattern_node_t *trie, *node;
+		size_t depth = 0;
+
+		if(!current->pattern_trie || !current->nof_pattern_mapping) continue;
+
+		trie = current->pattern_trie;
+		node = trie;
+		while(s[pos+depth]) {
+			uint32_t c, start, end;
+			bool word_end;
+			size_t i;
+
+			c = iuliiaU32ToLower(s[pos+depth]);
+			start = node->first_child;
+			end = start + node->nof_children;
+			while(start < end) {
+				uint32_t mid;
+
+				mid = start + (end - start) / 2;
+				if(trie[mid].c < c)
+					start = mid + 1;
+				else
+					end = mid;
+			}
+			if(start == node->first_child + node->nof_children || trie[start].c != c) break;
 
-	if(!size) return 0;
-	if(SIZE_MAX/2 < size) return 0;
+			node = trie + start;
+			depth++;
 
-	start = 0;
-	end = size - 1;
+			word_end = !iuliiaU32IsAlpha(s[pos+depth]);
+			for(i = 0; i < 4; i++) {
+				const iuliia_mapping_pattern_t *last;
+				size_t j;
 
-	while(start <= end) {
-		size_t mid;
+				if((pattern_flags[i] & IULIIA_PATTERN_WORD_START) && !word_start) continue;
+				if((pattern_flags[i] & IULIIA_PATTERN_WORD_END) && !word_end) continue;
+				if(!node->patterns[pattern_flags[i]]) continue;
 
-		mid = (end + start) / 2;
-		if(mapping[mid].c == c)
-			return mapping[mid].repl;
-		else if(mapping[mid].c < c)
-			start = mid + 1;
-		else if(mid > 0) // mapping[mid].c > c
-			end = mid - 1;
-		else
-			break;
+				// Repeats of pattern precede the last added one
+				last = current->pattern_mapping + node->patterns[pattern_flags[i]]-1;
+				for(j = node->patterns[pattern_flags[i]]; j > 0 && iuliiaIntSamePattern(current->pattern_mapping + j-1, last); j--)
+					if(!iuliiaIntAddCandidateMatch(matches, nof_matches, max_matches, current->pattern_mapping[j-1].repl, s[pos], depth)) return false;
+			}
+		}
 	}
+	if(*nof_matches) return true;
 
-	return 0;
+	state.prev_s = pos && iuliiaU32IsAlpha(s[pos-1]) ? iuliiaU32ToLower(s[pos-1]) : 0;
+	state.cur_s = iuliiaU32ToLower(s[pos]);
+	repl = iuliiaIntTranslateStep(s+pos, scheme, features, &state, &used);
+
+	return iuliiaIntAddCandidateMatch(matches, nof_matches, max_matches, repl, s[pos+used-1], used);
 }
 
-static uint32_t *iuliiaBsearch2char(uint32_t c, uint32_t cor_c, const iuliia_mapping_2char_t *mapping, size_t size)
+// Makes string of matches of path
+static uint32_t *iuliiaIntCandidateString(const uint32_t *s, const iuliia_candidate_path_t *paths, size_t path)
 {
-	size_t start, end;
-	uint64_t searching_c;
+	uint32_t *new_s;
+	size_t len = 0, i;
 
-	if(!size) return 0;
-	if(SIZE_MAX/2 < size) return 0;
+	for(i = path; paths[i].prev != SIZE_MAX; i = paths[i].prev)
+		len += paths[i].match.repl ? iuliiaU32len(paths[i].match.repl) : 1;
 
-	start = 0;
-	end = size - 1;
+	if(SIZE_MAX/sizeof(uint32_t) <= len) return 0;
+	new_s = malloc((len+1)*sizeof(uint32_t));
+	if(!new_s) return 0;
+	new_s[len] = 0;
 
-	searching_c = ((uint64_t)c << 32) + cor_c;
+	for(i = path; paths[i].prev != SIZE_MAX; i = paths[i].prev) {
+		const iuliia_candidate_match_t *match;
 
-	while (start <= end) {
-		uint64_t founded_c;
-		size_t mid;
+		match = &(paths[i].match);
+		if(!match->repl) {
+			new_s[--len] = s[paths[i].start];
+		} else {
+			size_t repl_len;
 
-		mid = (end + start) / 2;
-		founded_c = ((uint64_t)mapping[mid].c << 32) + mapping[mid].cor_c;
-		if(founded_c == searching_c) {
-			return mapping[mid].repl;
-		} else if(founded_c < searching_c)
-			start = mid + 1; 
-		else if(mid > 0) // founded_c > searching_c
-			end = mid - 1;
-		else
-			break;
+			repl_len = iuliiaU32len(match->repl);
+			len -= repl_len;
+			memcpy(new_s+len, match->repl, repl_len*sizeof(uint32_t));
+			if(repl_len && iuliiaU32IsUpper(match->case_s)) new_s[len] = iuliiaU32ToUpper(new_s[len]);
+		}
 	}
 
-	return 0;
+	return new_s;
 }
 
-uint32_t *iuliiaTranslateU32(const uint32_t *s, const iuliia_scheme_t *scheme)
+uint32_t **iuliiaTranslateCandidatesU32(const uint32_t *s, const iuliia_scheme_t *scheme, size_t max_candidates)
 {
-	uint32_t *new_s, prev_s = 0, next_s = 0;
-	size_t new_len, new_offset = 0, chars_to_add = 5;
-
-	if(!scheme->mapping) return 0;
-
-	new_len = iuliiaU32len(s);
-	new_s = malloc((new_len+1)*sizeof(uint32_t));
-	if(!new_s) return 0;
-
-	if(*s) {
-		next_s = iuliiaU32ToLower(*s);
+	iuliia_scheme_features_t features;
+	iuliia_candidate_path_t *paths = 0;
+	iuliia_candidate_match_t *matches = 0;
+	uint32_t **candidates = 0;
+	size_t *first_paths = 0, *nof_paths_at = 0;
+	size_t len, nof_paths = 0, max_paths = 0, nof_matches, max_matches = 0, nof_candidates = 0, pos, path, i;
+
+	if(!scheme->mapping || !max_candidates) return 0;
+
+	len = iuliiaU32len(s);
+	if(SIZE_MAX/sizeof(uint32_t *) <= max_candidates || SIZE_MAX/sizeof(size_t) <= len) return 0;
+
+	candidates = malloc((max_candidates+1)*sizeof(uint32_t *));
+	if(!candidates) return 0;
+	candidates[0] = 0;
+
+	// The first candidate is translation
+	candidates[0] = iuliiaTranslateU32(s, scheme);
+	if(!candidates[0]) goto IULIIA_ERROR;
+	candidates[++nof_candidates] = 0;
+	if(max_candidates == 1) return candidates;
+
+	first_paths = malloc((len+1)*sizeof(size_t));
+	nof_paths_at = malloc((len+1)*sizeof(size_t));
+	if(!first_paths || !nof_paths_at) goto IULIIA_ERROR;
+	for(pos = 0; pos <= len; pos++) {
+		first_paths[pos] = SIZE_MAX;
+		nof_paths_at[pos] = 0;
 	}
-	
-	while(*s) {
-		uint32_t *repl = 0, cur_s;
-		if(new_offset == new_len) {
-			uint32_t *_new_s = 0;
-
-			if(SIZE_MAX/sizeof(uint32_t)-chars_to_add >= new_len) _new_s = realloc(new_s, (new_len+chars_to_add)*sizeof(uint32_t));
-			if(!_new_s) {
-				free(new_s);
-				return 0;
-			}
-			new_s = _new_s;
-			new_len += chars_to_add-1;
-			if((SIZE_MAX/sizeof(uint32_t)-1)/2 > chars_to_add) chars_to_add = (chars_to_add-1)*2+1;
-		}
-		
-		cur_s = next_s;
-		next_s = iuliiaU32ToLower(*(s+1));
-
-		// Check word ending
-		if(scheme->ending_mapping && next_s != 0
-			&& iuliiaU32IsAlpha(*s) && iuliiaU32IsAlpha(next_s)) {
-
-			if(*(s+2) == 0 || !iuliiaU32IsAlpha(*(s+2))) {
-				repl = iuliiaBsearch2char(cur_s, next_s, scheme->ending_mapping, scheme->nof_ending_mapping);
-				if(repl) {
-					next_s = iuliiaU32ToLower(*(s+2));
-					s++;
-				}
+
+	if(!iuliiaIntGrowArray((void **)&paths, &max_paths, nof_paths, sizeof(iuliia_candidate_path_t))) goto IULIIA_ERROR;
+	memset(paths, 0, sizeof(iuliia_candidate_path_t));
+	paths[0].prev = SIZE_MAX;
+	paths[0].next = SIZE_MAX;
+	first_paths[0] = 0;
+	nof_paths_at[0] = 1;
+	nof_paths = 1;
+
+	iuliiaIntGetFeatures(scheme, &features);
+
+	// Paths, which end at position, are complete, when all previous positions are passed
+	for(pos = 0; pos < len; pos++) {
+		if(!nof_paths_at[pos]) continue;
+
+		if(!iuliiaIntFindCandidateMatches(s, pos, scheme, &features, &matches, &nof_matches, &max_matches)) goto IULIIA_ERROR;
+
+		for(path = first_paths[pos]; path != SIZE_MAX; path = paths[path].next) {
+			for(i = 0; i < nof_matches; i++) {
+				size_t end;
+
+				end = pos + matches[i].used;
+				if(nof_paths_at[end] == max_candidates) continue;
+
+				if(!iuliiaIntGrowArray((void **)&paths, &max_paths, nof_paths, sizeof(iuliia_candidate_path_t))) goto IULIIA_ERROR;
+				paths[nof_paths].prev = path;
+				paths[nof_paths].next = first_paths[end];
+				paths[nof_paths].start = pos;
+				paths[nof_paths].match = matches[i];
+				first_paths[end] = nof_paths;
+				nof_paths_at[end]++;
+				nof_paths++;
 			}
 		}
+	}
 
-		// Check previous mapping
-		if(!repl && scheme->prev_mapping) {
-			repl = iuliiaBsearch2char(cur_s, prev_s, scheme->prev_mapping, scheme->nof_prev_mapping);
-		}
+	// Different paths can make the same string
+	for(path = first_paths[len]; path != SIZE_MAX && nof_candidates < max_candidates; path = paths[path].next) {
+		uint32_t *candidate;
 
-		// Check next mapping
-		if(!repl && scheme->next_mapping) {
-			repl = iuliiaBsearch2char(cur_s, next_s, scheme->next_mapping, scheme->nof_next_mapping);
-		}
+		candidate = iuliiaIntCandidateString(s, paths, path);
+		if(!candidate) goto IULIIA_ERROR;
 
-		// Check direct mapping
-		if(!repl) {
-			repl = iuliiaBsearch1char(cur_s, scheme->mapping, scheme->nof_mapping);
-		}
+		for(i = 0; i < nof_candidates; i++) {
+			const uint32_t *a, *b;
 
-		if(repl) {
-			bool first_char = true;
+			for(a = candidates[i], b = candidate; *a && *a == *b; a++, b++);
+			if(*a == *b) break;
+		}
+		if(i < nof_candidates) {
+			free(candidate);
 
-			while(*repl) {
-				if(new_offset == new_len) {
-					uint32_t* _new_s = 0;
-
-					if(SIZE_MAX/sizeof(uint32_t)-5 >= new_len) _new_s = realloc(new_s, (new_len+5)*sizeof(uint32_t));
-					if(!_new_s) {
-						free(new_s);
-						return 0;
-					}
-					new_s = _new_s;
-					new_len += 4;
-				}
-				if(first_char && iuliiaU32IsUpper(*s))
-					new_s[new_offset] = iuliiaU32ToUpper(*repl);
-				else
-					new_s[new_offset] = *repl;
-				new_offset++;
-				repl++;
-				first_char = false;
-			}
-		} else {
-			new_s[new_offset] = *s;
-			new_offset++;
+			continue;
 		}
 
-		prev_s = cur_s;
-		if(!iuliiaU32IsAlpha(prev_s)) prev_s = 0;
-		s++;
+		candidates[nof_candidates] = candidate;
+		candidates[++nof_candidates] = 0;
 	}
-	new_s[new_offset] = 0;
-	
-	return new_s;
+
+	free(paths);
+	free(matches);
+	free(first_paths);
+	free(nof_paths_at);
+
+	return candidates;
+
+IULIIA_ERROR:
+
+	iuliiaFreeCandidates(candidates);
+	free(paths);
+	free(matches);
+	free(first_paths);
+	free(nof_paths_at);
+
+	return 0;
 }
 
-uint32_t *iuliiaTranslateWtoU32(const wchar_t *s, const iuliia_scheme_t *scheme)
+void iuliiaFreeCandidates(uint32_t **candidates)
+{
+	uint32_t **p;
+
+	if(!candidates) return;
+
+	for(p = candidates; *p; p++) free(*p);
+
+	free(candidates);
+}
+
+uint32_t *iuliiaTranslateExWtoU32(const wchar_t *s, const iuliia_scheme_t *scheme, unsigned int flags)
 {
 	if(sizeof(uint32_t) == sizeof(wchar_t))
-		return iuliiaTranslateU32((const uint32_t *)s, scheme);
+		return iuliiaTranslateExU32((const uint32_t *)s, scheme, flags);
 	else {
 		uint32_t *su32, *new_su32;
 		
 		su32 = iuliiaWtoU32(s);
 		if(!su32) return 0;
 		
-		new_su32 = iuliiaTranslateU32(su32, scheme);
+		new_su32 = iuliiaTranslateExU32(su32, scheme, flags);
 		
 		iuliiaFreeString(su32);
 		
@@ -930,15 +7356,15 @@ uint32_t *iuliiaTranslateWtoU32(const wchar_t *s, const iuliia_scheme_t *scheme)
 	}
 }
 
-wchar_t *iuliiaTranslateW(const wchar_t *s, const iuliia_scheme_t *scheme)
+wchar_t *iuliiaTranslateExW(const wchar_t *s, const iuliia_scheme_t *scheme, unsigned int flags)
 {
 	if(sizeof(uint32_t) == sizeof(wchar_t))
-		return (wchar_t *)iuliiaTranslateU32((const uint32_t*)s, scheme);
+		return (wchar_t *)iuliiaTranslateExU32((const uint32_t*)s, scheme, flags);
 	else {
 		wchar_t *new_s;
 		uint32_t *new_su32;
 		
-		new_su32 = iuliiaTranslateWtoU32(s, scheme);
+		new_su32 = iuliiaTranslateExWtoU32(s, scheme, flags);
 		if(!new_su32) return 0;
 		
 		new_s = iuliiaU32toW(new_su32);
@@ -949,7 +7375,7 @@ wchar_t *iuliiaTranslateW(const wchar_t *s, const iuliia_scheme_t *scheme)
 	}
 }
 
-uint32_t *iuliiaTranslateAtoU32(const char *s, const iuliia_scheme_t *scheme)
+uint32_t *iuliiaTranslateExAtoU32(const char *s, const iuliia_scheme_t *scheme, unsigned int flags)
 {
 	wchar_t *sw;
 	uint32_t *new_su32;
@@ -963,13 +7389,13 @@ uint32_t *iuliiaTranslateAtoU32(const char *s, const iuliia_scheme_t *scheme)
 	mbstowcs(sw, s, s_len);
 	sw[s_len] = 0;
 
-	new_su32 = iuliiaTranslateWtoU32(sw, scheme);
+	new_su32 = iuliiaTranslateExWtoU32(sw, scheme, flags);
 	free(sw);
 
 	return new_su32;
 }
 
-wchar_t *iuliiaTranslateAtoW(const char *s, const iuliia_scheme_t *scheme)
+wchar_t *iuliiaTranslateExAtoW(const char *s, const iuliia_scheme_t *scheme, unsigned int flags)
 {
 	wchar_t *sw, *new_sw;
 	size_t s_len;
@@ -982,19 +7408,19 @@ wchar_t *iuliiaTranslateAtoW(const char *s, const iuliia_scheme_t *scheme)
 	mbstowcs(sw, s, s_len);
 	sw[s_len] = 0;
 
-	new_sw = iuliiaTranslateW(sw, scheme);
+	new_sw = iuliiaTranslateExW(sw, scheme, flags);
 	free(sw);
 	
 	return new_sw;
 }
 
-char *iuliiaTranslateA(const char *s, const iuliia_scheme_t *scheme)
+char *iuliiaTranslateExA(const char *s, const iuliia_scheme_t *scheme, unsigned int flags)
 {
 	char *new_s;
 	wchar_t *new_sw;
 	size_t new_sw_len, new_s_len;
 
-	new_sw = iuliiaTranslateAtoW(s, scheme);
+	new_sw = iuliiaTranslateExAtoW(s, scheme, flags);
 	if(!new_sw) return 0;
 
 	new_sw_len = wcslen(new_sw);
@@ -1018,6 +7444,31 @@ char *iuliiaTranslateA(const char *s, const iuliia_scheme_t *scheme)
 	return new_s;
 }
 
+uint32_t *iuliiaTranslateWtoU32(const wchar_t *s, const iuliia_scheme_t *scheme)
+{
+	return iuliiaTranslateExWtoU32(s, scheme, 0);
+}
+
+wchar_t *iuliiaTranslateW(const wchar_t *s, const iuliia_scheme_t *scheme)
+{
+	return iuliiaTranslateExW(s, scheme, 0);
+}
+
+uint32_t *iuliiaTranslateAtoU32(const char *s, const iuliia_scheme_t *scheme)
+{
+	return iuliiaTranslateExAtoU32(s, scheme, 0);
+}
+
+wchar_t *iuliiaTranslateAtoW(const char *s, const iuliia_scheme_t *scheme)
+{
+	return iuliiaTranslateExAtoW(s, scheme, 0);
+}
+
+char *iuliiaTranslateA(const char *s, const iuliia_scheme_t *scheme)
+{
+	return iuliiaTranslateExA(s, scheme, 0);
+}
+
 void iuliiaFreeString(void *s)
 {
 	if(s) free(s);
@@ -43,12 +43,32 @@ typedef struct {
 	uint32_t *repl;
 } iuliia_mapping_2char_t;
 
+// Flags of pattern. In json pattern key starts with ^ and ends with $ respectively
+#define IULIIA_PATTERN_WORD_START 0x1 // Pattern is matched only at word start
+#define IULIIA_PATTERN_WORD_END 0x2 // Pattern is matched only at word end
+
+#define IULIIA_MAX_PATTERN_LENGTH 64
+
+typedef struct {
+	uint32_t *pattern; // Lower case characters
+	uint32_t *repl;
+	unsigned int flags;
+} iuliia_mapping_pattern_t;
+
+// Node of trie of patterns. Children are sorted by character
+typedef struct {
+	uint32_t c;
+	uint32_t first_child;
+	uint32_t nof_children;
+	uint32_t patterns[4]; // Index+1 of pattern ending at this node for every combination of flags (0 - none)
+} iuliia_pattern_node_t;
+
 typedef struct {
 	wchar_t *in;
 	wchar_t *out;
 } iuliia_samples_t;
 
-typedef struct {
+typedef struct iuliia_scheme_s {
 	wchar_t *name;
 	wchar_t *description;
 	wchar_t *url;
@@ -62,15 +82,129 @@ typedef struct {
 	size_t nof_ending_mapping;
 	iuliia_samples_t *samples;
 	size_t nof_samples;
+	iuliia_mapping_pattern_t *pattern_mapping; // Longest pattern at position is used instead of rules of its characters
+	size_t nof_pattern_mapping;
+	iuliia_pattern_node_t *pattern_trie; // Root is node 0. Place for 1 + total length of patterns nodes, built by iuliiaPrepareScheme
+	// Fields below belong to library. Scheme filled by caller must be cleared by iuliiaInitScheme first
+	void *arena; // Memory block with whole scheme, if it was loaded by library (freed by iuliiaFreeScheme)
+	const struct iuliia_scheme_s *base; // Scheme, which rules are used if this scheme has no rule for character
+	unsigned int engine; // Translation loop for kinds of rules in scheme, chosen by iuliiaPrepareScheme (0 - choose on every call)
+	void *jit; // Native code, which finds rules of compiled scheme (freed by iuliiaFreeScheme)
+	void *fst; // Transducer over classes of characters of compiled scheme (freed by iuliiaFreeScheme)
+	uint32_t first_rule_c; // Range of characters, which lower case rules may use, found by iuliiaPrepareScheme.
+	uint32_t last_rule_c; // Other characters are copied without looking for rules
 } iuliia_scheme_t;
 
+// Flags for iuliiaLoadScheme*Ex functions. Skipped fields are neither decoded nor validated
+#define IULIIA_LOAD_SKIP_SAMPLES 0x1 // Don't load samples
+#define IULIIA_LOAD_SKIP_METADATA 0x2 // Don't load name, description and url
+#define IULIIA_LOAD_JSON_DOM 0x4 // Parse json with json.h instead of streaming scheme parser
+
 extern iuliia_scheme_t *iuliiaLoadSchemeFromMemory(char *json, size_t json_length);
+extern iuliia_scheme_t *iuliiaLoadSchemeFromMemoryEx(char *json, size_t json_length, unsigned int flags);
 extern void iuliiaFreeScheme(iuliia_scheme_t *scheme);
+// Clears scheme, which caller fills by itself. Tables and strings of such scheme are freed by iuliiaFreeScheme one by one
+extern void iuliiaInitScheme(iuliia_scheme_t *scheme);
+// Sorts rules and chooses translation loop. Engine isn't used, if rules are changed after it
 extern void iuliiaPrepareScheme(iuliia_scheme_t *scheme);
 
+// Tables of scheme rules. Rules should be added for lower case characters
+#define IULIIA_TABLE_MAPPING 0 // Character c, cor_c is ignored
+#define IULIIA_TABLE_PREV 1 // Character c after character cor_c (0 - at word start)
+#define IULIIA_TABLE_NEXT 2 // Character c before character cor_c
+#define IULIIA_TABLE_ENDING 3 // Characters c and cor_c at word end
+
+typedef struct iuliia_builder_s iuliia_builder_t;
+
+extern iuliia_builder_t *iuliiaCreateBuilder(void);
+extern void iuliiaFreeBuilder(iuliia_builder_t *builder);
+extern void iuliiaResetBuilder(iuliia_builder_t *builder);
+// Rule added later replaces rule with the same characters. Return 0 on error
+extern int iuliiaBuilderAddRule(iuliia_builder_t *builder, int table, uint32_t c, uint32_t cor_c, const uint32_t *repl);
+extern int iuliiaBuilderAddRuleU8(iuliia_builder_t *builder, int table, uint32_t c, uint32_t cor_c, const char *repl);
+// Pattern of several characters with IULIIA_PATTERN_* flags. Pattern added later replaces pattern with the same characters and flags
+extern int iuliiaBuilderAddPattern(iuliia_builder_t *builder, const uint32_t *pattern, unsigned int flags, const uint32_t *repl);
+extern int iuliiaBuilderAddPatternU8(iuliia_builder_t *builder, const char *pattern, unsigned int flags, const char *repl);
+extern int iuliiaBuilderAddScheme(iuliia_builder_t *builder, const iuliia_scheme_t *scheme);
+// Makes prepared scheme, builder can be used further
+extern iuliia_scheme_t *iuliiaBuilderMakeScheme(iuliia_builder_t *builder);
+// Makes scheme with only builder rules on top of base scheme. Base scheme should be freed after overlay
+extern iuliia_scheme_t *iuliiaBuilderMakeOverlay(iuliia_builder_t *builder, const iuliia_scheme_t *base);
+
+// Compiled scheme is immutable copy of scheme, which doesn't depend on source scheme.
+// Translate functions may use it from many threads at once. Retain and release are atomic
+typedef struct iuliia_compiled_scheme_s iuliia_compiled_scheme_t;
+
+// Flags for iuliiaCompileSchemeEx. Compiled scheme is translated by transducer, if scheme has not too many
+// classes of characters. Otherwise on x86-64 rules are found by native code, unless library is built with IULIIA_NO_JIT
+#define IULIIA_COMPILE_NO_JIT 0x1 // Don't make native code
+#define IULIIA_COMPILE_NO_FST 0x2 // Don't make transducer
+
+extern iuliia_compiled_scheme_t *iuliiaCompileScheme(const iuliia_scheme_t *scheme);
+extern iuliia_compiled_scheme_t *iuliiaCompileSchemeEx(const iuliia_scheme_t *scheme, unsigned int flags);
+extern iuliia_compiled_scheme_t *iuliiaRetainScheme(iuliia_compiled_scheme_t *compiled);
+// Frees compiled scheme, when last reference is released
+extern void iuliiaReleaseScheme(iuliia_compiled_scheme_t *compiled);
+// Returned scheme lives while compiled scheme is retained and must not be changed
+extern const iuliia_scheme_t *iuliiaCompiledSchemeGet(const iuliia_compiled_scheme_t *compiled);
+
+// Scheme file is mapped to memory while it is parsed, so it must not be truncated meanwhile (process would get
+// SIGBUS on POSIX). Write new scheme to other file and rename it over old one. Files of scheme slots are read
 extern iuliia_scheme_t *iuliiaLoadSchemeFromFile(FILE *f);
+extern iuliia_scheme_t *iuliiaLoadSchemeFromFileEx(FILE *f, unsigned int flags);
 extern iuliia_scheme_t *iuliiaLoadSchemeW(const wchar_t *filename);
+extern iuliia_scheme_t *iuliiaLoadSchemeExW(const wchar_t *filename, unsigned int flags);
 extern iuliia_scheme_t *iuliiaLoadSchemeA(const char *filename);
+extern iuliia_scheme_t *iuliiaLoadSchemeExA(const char *filename, unsigned int flags);
+
+typedef struct {
+	wchar_t *filename; // File name without path
+	iuliia_scheme_t *scheme; // 0 if scheme wasn't loaded
+	int error; // 0 or errno value, EINVAL if file isn't a valid scheme, ENOMEM or error of reading otherwise
+} iuliia_dir_entry_t;
+
+typedef struct {
+	iuliia_dir_entry_t *entries; // Sorted by file name
+	size_t nof_entries;
+} iuliia_scheme_dir_t;
+
+// Loads all *.json schemes in directory. Schemes are loaded by nthreads threads (0 - one per cpu)
+extern iuliia_scheme_dir_t *iuliiaLoadSchemeDirW(const wchar_t *path, unsigned int flags, unsigned int nthreads);
+extern iuliia_scheme_dir_t *iuliiaLoadSchemeDirA(const char *path, unsigned int flags, unsigned int nthreads);
+extern void iuliiaFreeSchemeDir(iuliia_scheme_dir_t *dir);
+
+// Slot holds current version of scheme, which can be replaced while other threads translate.
+// Readers don't take locks, replaced scheme is freed, when the last reader releases it
+typedef struct iuliia_scheme_slot_s iuliia_scheme_slot_t;
+
+extern iuliia_scheme_slot_t *iuliiaCreateSchemeSlot(iuliia_compiled_scheme_t *compiled);
+// Slot with scheme from file. File is checked every period_ms milliseconds (0 - never) and reloaded, if it was changed
+extern iuliia_scheme_slot_t *iuliiaCreateSchemeSlotW(const wchar_t *filename, unsigned int flags, unsigned int period_ms);
+extern iuliia_scheme_slot_t *iuliiaCreateSchemeSlotA(const char *filename, unsigned int flags, unsigned int period_ms);
+extern void iuliiaFreeSchemeSlot(iuliia_scheme_slot_t *slot);
+// Checks file of slot at once and reloads it, if it was changed. Returns 1, if new scheme was published
+extern int iuliiaSchemeSlotCheck(iuliia_scheme_slot_t *slot);
+// Returns current scheme, which should be released by iuliiaReleaseScheme
+extern iuliia_compiled_scheme_t *iuliiaSchemeSlotAcquire(iuliia_scheme_slot_t *slot);
+extern void iuliiaSchemeSlotPublish(iuliia_scheme_slot_t *slot, iuliia_compiled_scheme_t *compiled);
+
+// Schemes in named shared memory. Creator copies schemes there, other processes map the memory read-only.
+// Name is name of POSIX shared memory object ("/name") or of Windows file mapping.
+// Opener checks memory once and doesn't copy it, so every process, which can write memory, must be trusted
+typedef struct iuliia_shared_schemes_s iuliia_shared_schemes_t;
+
+// Returns 0 if memory with such name already exists (errno is EEXIST). Memory, which creator
+// hasn't filled, because it has crashed, is removed and made again
+extern iuliia_shared_schemes_t *iuliiaCreateSharedSchemes(const char *name, const iuliia_scheme_t *const *schemes, size_t nof_schemes);
+// Returns 0 if memory doesn't exist or creator hasn't filled it yet (errno is EAGAIN).
+// Memory left by crashed creator is treated as not existing (errno is ENOENT)
+extern iuliia_shared_schemes_t *iuliiaOpenSharedSchemes(const char *name);
+extern void iuliiaCloseSharedSchemes(iuliia_shared_schemes_t *shared);
+// Removes name, so new processes can't open memory. Mapped memory stays valid
+extern int iuliiaRemoveSharedSchemes(const char *name);
+extern size_t iuliiaSharedSchemesCount(const iuliia_shared_schemes_t *shared);
+// Returned schemes live while shared memory is open and must not be changed or freed
+extern const iuliia_scheme_t *iuliiaSharedSchemesGet(const iuliia_shared_schemes_t *shared, size_t i);
 
 extern size_t iuliiaU32len(const uint32_t *s);
 extern wchar_t *iuliiaU32toW(const uint32_t *s);
@@ -83,14 +217,83 @@ extern uint32_t iuliiaU32ToUpper(uint32_t c);
 extern int iuliiaU32IsUpper(uint32_t c);
 extern int iuliiaU32IsAlpha(uint32_t c);
 
+// Flags for iuliiaTranslate*Ex functions
+#define IULIIA_TRANSLATE_NFC 0x1 // Compose Latin and Cyrillic letters with following combining marks (e. g. U+0435 U+0308 as U+0451)
+#define IULIIA_TRANSLATE_DEDUP 0x2 // iuliiaTranslateColumnU8 translates equal strings once
+
 extern uint32_t *iuliiaTranslateU32(const uint32_t *s, const iuliia_scheme_t *scheme);
+extern uint32_t *iuliiaTranslateExU32(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags);
+// Translates large text by nthreads threads (0 - one per cpu). Text is split before characters, which rules
+// don't look at, so result is the same as of iuliiaTranslateExU32
+extern uint32_t *iuliiaTranslateParallelU32(const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags, unsigned int nthreads);
+// Returns the first offset in UTF-8 text at target_offset or after it, where text can be split into parts, which are
+// translated to the same text as whole one. Returns len, if there is no such offset
+extern size_t iuliiaFindSafeSplit(const uint8_t *buf, size_t len, size_t target_offset, const iuliia_scheme_t *scheme);
+
+// Column of UTF-8 strings in one buffer. String i takes bytes from offsets[i] to offsets[i+1], offsets has nof_strings+1 elements
+typedef struct {
+	uint8_t *data;
+	size_t *offsets;
+	size_t nof_strings;
+} iuliia_column_t;
+
+// Translates every string of column to new column, which starts from offset 0 and is freed by iuliiaFreeColumn
+extern int iuliiaTranslateColumnU8(const uint8_t *data, const size_t *offsets, size_t nof_strings, const iuliia_scheme_t *scheme, unsigned int flags, iuliia_column_t *new_column);
+extern void iuliiaFreeColumn(iuliia_column_t *column);
+
+// Stream translates UTF-8 text, which comes by parts, as whole text. It keeps only characters, which rules may look at
+typedef struct iuliia_stream_s iuliia_stream_t;
+
+extern iuliia_stream_t *iuliiaCreateStream(const iuliia_scheme_t *scheme, unsigned int flags);
+// Translates next part of text, characters at its end may wait for next part. Text is finished by is_last,
+// then stream can translate next text. Output belongs to stream and lives until next call.
+// Every byte, which doesn't start valid UTF-8 character, is translated to U+FFFD, NUL is copied and separates texts
+extern int iuliiaStreamTranslateU8(iuliia_stream_t *stream, const uint8_t *data, size_t len, int is_last, const uint8_t **new_data, size_t *new_len);
+extern void iuliiaFreeStream(iuliia_stream_t *stream);
+
+// Pool of threads, which translate strings and call back with result. Callback gets translated string or 0
+// on error and frees it by iuliiaFreeString. It is called by thread of pool
+typedef struct iuliia_pool_s iuliia_pool_t;
+typedef void (*iuliia_translate_callback_t)(void *user_data, uint32_t *new_s);
+
+// Pool of nthreads threads (0 - one per cpu), which keeps at most max_queue translations waiting (0 - 1024)
+extern iuliia_pool_t *iuliiaCreatePool(unsigned int nthreads, size_t max_queue);
+// Queues translation without waiting. s and scheme must live until callback is called. Returns 0,
+// if queue is full (errno is EAGAIN) or scheme isn't prepared or pool is being freed (errno is EINVAL)
+extern int iuliiaTranslateAsync(iuliia_pool_t *pool, const uint32_t *s, const iuliia_scheme_t *scheme, unsigned int flags, iuliia_translate_callback_t callback, void *user_data);
+// Queues all strings or none of them without waiting. user_data may be 0. Returns 0, if batch is larger
+// than max_queue (errno is E2BIG), otherwise like iuliiaTranslateAsync
+extern int iuliiaTranslateAsyncBatch(iuliia_pool_t *pool, const uint32_t *const *s, size_t nof_strings, const iuliia_scheme_t *scheme, unsigned int flags, iuliia_translate_callback_t callback, void *const *user_data);
+// Waits until all queued translations are done. Must not be called by callback
+extern void iuliiaDrainPool(iuliia_pool_t *pool);
+// Does queued translations and stops threads
+extern void iuliiaFreePool(iuliia_pool_t *pool);
+
+// Makes scheme, which translates as second scheme applied to result of first one.
+// Returns 0, if rules of schemes can't be composed, then iuliiaTranslateChainU32 can be used
+extern iuliia_compiled_scheme_t *iuliiaComposeSchemes(const iuliia_scheme_t *first, const iuliia_scheme_t *second);
+// Translates by schemes one after another in single pass without intermediate strings
+extern uint32_t *iuliiaTranslateChainU32(const uint32_t *s, const iuliia_scheme_t *const *schemes, size_t nof_schemes);
+
+// Makes scheme, which translates back text made by scheme. Replacements of rules become patterns, so the longest
+// of them is used. Replacement, which can be made by different characters, keeps all of them, the most common is used
+extern iuliia_scheme_t *iuliiaMakeInverseScheme(const iuliia_scheme_t *scheme);
+// Returns 0 terminated array of at most max_candidates different translations, the first one is made by iuliiaTranslateU32.
+// Others use other patterns at the same positions. Array is freed by iuliiaFreeCandidates
+extern uint32_t **iuliiaTranslateCandidatesU32(const uint32_t *s, const iuliia_scheme_t *scheme, size_t max_candidates);
+extern void iuliiaFreeCandidates(uint32_t **candidates);
 
 extern uint32_t *iuliiaTranslateWtoU32(const wchar_t *s, const iuliia_scheme_t *scheme);
+extern uint32_t *iuliiaTranslateExWtoU32(const wchar_t *s, const iuliia_scheme_t *scheme, unsigned int flags);
 extern wchar_t *iuliiaTranslateW(const wchar_t *s, const iuliia_scheme_t *scheme);
+extern wchar_t *iuliiaTranslateExW(const wchar_t *s, const iuliia_scheme_t *scheme, unsigned int flags);
 
 extern uint32_t *iuliiaTranslateAtoU32(const char *s, const iuliia_scheme_t *scheme);
+extern uint32_t *iuliiaTranslateExAtoU32(const char *s, const iuliia_scheme_t *scheme, unsigned int flags);
 extern wchar_t *iuliiaTranslateAtoW(const char *s, const iuliia_scheme_t *scheme);
+extern wchar_t *iuliiaTranslateExAtoW(const char *s, const iuliia_scheme_t *scheme, unsigned int flags);
 extern char *iuliiaTranslateA(const char *s, const iuliia_scheme_t *scheme);
+extern char *iuliiaTranslateExA(const char *s, const iuliia_scheme_t *scheme, unsigned int flags);
 
 extern void iuliiaFreeString(void *s);
 